@@ -0,0 +1,173 @@
+/*
+	FILE: clearanceMonitor.cpp
+	------------------------
+	clearance monitor implementation
+*/
+#include <autonomous_flight/px4/clearanceMonitor.h>
+
+namespace AutoFlight{
+	clearanceMonitor::clearanceMonitor(const ros::NodeHandle& nh) : nh_(nh){
+		this->initParam();
+		this->registerPub();
+
+		// unit directions to the 26 neighbors
+		for (int x=-1; x<=1; ++x){
+			for (int y=-1; y<=1; ++y){
+				for (int z=-1; z<=1; ++z){
+					if (x == 0 and y == 0 and z == 0){
+						continue;
+					}
+					this->directions_.push_back(Eigen::Vector3d (x, y, z).normalized());
+				}
+			}
+		}
+	}
+
+	void clearanceMonitor::initParam(){
+		// clearances are searched up to this distance
+		if (not this->nh_.getParam("clearance_monitor/max_clearance", this->maxClearance_)){
+			this->maxClearance_ = 2.0;
+			cout << "[ClearanceMonitor]: No max clearance param found. Use default: 2.0 m." << endl;
+		}
+		else{
+			cout << "[ClearanceMonitor]: Max clearance is set to: " << this->maxClearance_ << "m." << endl;
+		}
+
+		// no replan is needed for dynamic obstacles above this clearance
+		if (not this->nh_.getParam("clearance_monitor/safe_clearance", this->safeClearance_)){
+			this->safeClearance_ = 0.5;
+			cout << "[ClearanceMonitor]: No safe clearance param found. Use default: 0.5 m." << endl;
+		}
+		else{
+			cout << "[ClearanceMonitor]: Safe clearance is set to: " << this->safeClearance_ << "m." << endl;
+		}
+
+		// conflicts within this time need a replan
+		if (not this->nh_.getParam("clearance_monitor/replan_time", this->replanTime_)){
+			this->replanTime_ = 3.0;
+			cout << "[ClearanceMonitor]: No replan time param found. Use default: 3.0 s." << endl;
+		}
+		else{
+			cout << "[ClearanceMonitor]: Replan time is set to: " << this->replanTime_ << "s." << endl;
+		}
+
+		// conflicts within this time need an immediate replan
+		if (not this->nh_.getParam("clearance_monitor/urgent_time", this->urgentTime_)){
+			this->urgentTime_ = 1.0;
+			cout << "[ClearanceMonitor]: No urgent time param found. Use default: 1.0 s." << endl;
+		}
+		else{
+			cout << "[ClearanceMonitor]: Urgent time is set to: " << this->urgentTime_ << "s." << endl;
+		}
+
+		// the state is published (and the static clearance searched) every period
+		if (not this->nh_.getParam("clearance_monitor/publish_period", this->publishPeriod_)){
+			this->publishPeriod_ = 0.1;
+			cout << "[ClearanceMonitor]: No publish period param found. Use default: 0.1 s." << endl;
+		}
+		else{
+			cout << "[ClearanceMonitor]: Publish period is set to: " << this->publishPeriod_ << "s." << endl;
+		}
+	}
+
+	void clearanceMonitor::registerPub(){
+		this->clearancePub_ = this->nh_.advertise<std_msgs::Float64MultiArray>("autonomous_flight/clearance", 10);
+	}
+
+	void clearanceMonitor::setMap(const std::shared_ptr<mapManager::occMap>& map){
+		this->map_ = map;
+	}
+
+	void clearanceMonitor::setPredictor(const std::shared_ptr<AutoFlight::obstaclePredictor>& obstaclePredictor){
+		this->obstaclePredictor_ = obstaclePredictor;
+	}
+
+	const clearanceState& clearanceMonitor::update(const std::vector<Eigen::Vector3d>& points, const std::vector<double>& times){
+		ros::Time currTime = ros::Time::now();
+		bool publishState = this->lastPubTime_.isZero() or (currTime - this->lastPubTime_).toSec() >= this->publishPeriod_;
+		this->updateStatic(points, times, publishState);
+
+		double conflictTime, minClearance;
+		if (this->obstaclePredictor_->getClearance(points, times, this->maxClearance_, conflictTime, minClearance)){
+			this->state_.dynamicTtc = std::max(conflictTime, 0.0);
+		}
+		else{
+			this->state_.dynamicTtc = -1.0;
+		}
+		this->state_.dynamicClearance = minClearance;
+
+		// the earlier conflict and the smaller clearance of both
+		if (this->state_.staticTtc < 0.0 or (this->state_.dynamicTtc >= 0.0 and this->state_.dynamicTtc < this->state_.staticTtc)){
+			this->state_.ttc = this->state_.dynamicTtc;
+		}
+		else{
+			this->state_.ttc = this->state_.staticTtc;
+		}
+		this->state_.clearance = std::min(this->state_.staticClearance, this->state_.dynamicClearance);
+		this->updateLevel();
+		if (publishState){
+			this->lastPubTime_ = currTime;
+			this->publish();
+		}
+		return this->state_;
+	}
+
+	double clearanceMonitor::getStaticTtc(const std::vector<Eigen::Vector3d>& points, const std::vector<double>& times){
+		for (size_t i=0; i<points.size(); ++i){
+			if (this->map_->isInflatedOccupied(points[i])){
+				return std::max(times[i], 0.0);
+			}
+		}
+		return -1.0;
+	}
+
+	const clearanceState& clearanceMonitor::getState(){
+		return this->state_;
+	}
+
+	void clearanceMonitor::publish(){
+		this->clearanceMsg_.data = {this->state_.ttc, this->state_.clearance, this->state_.staticTtc, this->state_.staticClearance,
+		                            this->state_.dynamicTtc, this->state_.dynamicClearance, double(this->state_.level)};
+		this->clearancePub_.publish(this->clearanceMsg_);
+	}
+
+	void clearanceMonitor::updateStatic(const std::vector<Eigen::Vector3d>& points, const std::vector<double>& times, bool searchClearance){
+		this->state_.staticTtc = this->getStaticTtc(points, times);
+		if (this->state_.staticTtc >= 0.0){
+			this->state_.staticClearance = 0.0;
+			return;
+		}
+		if (not searchClearance){ // the last clearance is kept
+			return;
+		}
+
+		// distance to the first inflated occupied voxel in each direction. Only distances below the current minimum can change the result
+		this->state_.staticClearance = this->maxClearance_;
+		double res = this->map_->getRes();
+		for (size_t i=0; i<points.size(); ++i){
+			for (const Eigen::Vector3d& direction : this->directions_){
+				for (double d=res; d<this->state_.staticClearance; d+=res){
+					if (this->map_->isInflatedOccupied(points[i] + direction * d)){
+						this->state_.staticClearance = d;
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	void clearanceMonitor::updateLevel(){
+		if (this->state_.ttc >= 0.0 and this->state_.ttc <= this->urgentTime_){
+			this->state_.level = CLEARANCE_LEVEL::URGENT;
+		}
+		else if (this->state_.ttc >= 0.0 and this->state_.ttc <= this->replanTime_){
+			this->state_.level = CLEARANCE_LEVEL::CONFLICT;
+		}
+		else if (this->state_.dynamicClearance < this->safeClearance_){ // static obstacles do not move closer
+			this->state_.level = CLEARANCE_LEVEL::NEAR;
+		}
+		else{
+			this->state_.level = CLEARANCE_LEVEL::AMPLE;
+		}
+	}
+}
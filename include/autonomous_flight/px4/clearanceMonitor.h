@@ -0,0 +1,87 @@
+/*
+	FILE: clearanceMonitor.h
+	------------------------
+	time to collision and clearance of the remaining trajectory
+*/
+
+#ifndef AUTOFLIGHT_CLEARANCE_MONITOR_H
+#define AUTOFLIGHT_CLEARANCE_MONITOR_H
+#include <ros/ros.h>
+#include <std_msgs/Float64MultiArray.h>
+#include <map_manager/occupancyMap.h>
+#include <autonomous_flight/px4/obstaclePredictor.h>
+#include <Eigen/Dense>
+#include <vector>
+#include <memory>
+
+using std::cout; using std::endl;
+namespace AutoFlight{
+	// how urgent a replan is
+	enum CLEARANCE_LEVEL{
+		AMPLE = 0, // no conflict and the clearance is above the safe clearance. No replan is needed
+		NEAR = 1, // no conflict but the trajectory passes close to dynamic obstacles
+		CONFLICT = 2, // conflict within the replan time
+		URGENT = 3, // conflict within the urgent time
+	};
+
+	/*
+		Times are in seconds from now and -1 if there is no conflict.
+		Clearances are capped at the max clearance.
+	*/
+	struct clearanceState{
+		double ttc = -1.0;
+		double clearance = 0.0;
+		double staticTtc = -1.0;
+		double staticClearance = 0.0;
+		double dynamicTtc = -1.0;
+		double dynamicClearance = 0.0;
+		CLEARANCE_LEVEL level = CLEARANCE_LEVEL::AMPLE;
+	};
+
+	/*
+		Static clearance is searched along 26 directions from each trajectory sample
+		(a search stops at the smallest clearance found so far). It drives no replan, so it is
+		only searched at the publish period; the static time to collision is checked every update.
+		Dynamic clearance is the swept box separation to the predicted obstacles. The state is published as
+		[ttc, clearance, static ttc, static clearance, dynamic ttc, dynamic clearance, level].
+	*/
+	class clearanceMonitor{
+	private:
+		ros::NodeHandle nh_;
+		ros::Publisher clearancePub_;
+		std::shared_ptr<mapManager::occMap> map_;
+		std::shared_ptr<AutoFlight::obstaclePredictor> obstaclePredictor_;
+
+		// parameters
+		double maxClearance_;
+		double safeClearance_;
+		double replanTime_;
+		double urgentTime_;
+		double publishPeriod_;
+
+		std::vector<Eigen::Vector3d> directions_;
+		clearanceState state_;
+		ros::Time lastPubTime_;
+		std_msgs::Float64MultiArray clearanceMsg_;
+
+	public:
+		clearanceMonitor(const ros::NodeHandle& nh);
+		void initParam();
+		void registerPub();
+		void setMap(const std::shared_ptr<mapManager::occMap>& map);
+		void setPredictor(const std::shared_ptr<AutoFlight::obstaclePredictor>& obstaclePredictor);
+
+		// samples of the remaining trajectory reached at times (seconds from now). The predictor has to be updated before
+		const clearanceState& update(const std::vector<Eigen::Vector3d>& points, const std::vector<double>& times);
+		// time of the first sample in an inflated occupied voxel (-1 if none). Cheap enough for every check
+		double getStaticTtc(const std::vector<Eigen::Vector3d>& points, const std::vector<double>& times);
+		const clearanceState& getState();
+		void publish();
+
+	private:
+		void updateStatic(const std::vector<Eigen::Vector3d>& points, const std::vector<double>& times, bool searchClearance);
+		void updateLevel();
+	};
+}
+
+#endif
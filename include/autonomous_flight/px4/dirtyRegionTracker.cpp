@@ -0,0 +1,135 @@
+/*
+	FILE: dirtyRegionTracker.cpp
+	------------------------
+	dirty region tracker implementation
+*/
+#include <autonomous_flight/px4/dirtyRegionTracker.h>
+
+namespace AutoFlight{
+	dirtyRegionTracker::dirtyRegionTracker(const ros::NodeHandle& nh) : nh_(nh){
+		this->initParam();
+	}
+
+	void dirtyRegionTracker::initParam(){
+		// global region of the exploration planner
+		std::vector<double> regionMinTemp, regionMaxTemp;
+		if (not this->nh_.getParam("DEP/global_region_min", regionMinTemp) or not this->nh_.getParam("DEP/global_region_max", regionMaxTemp)){
+			this->regionMin_ = Eigen::Vector3d (-20, -20, 0.7);
+			this->regionMax_ = Eigen::Vector3d (20, 20, 1.2);
+			cout << "[DirtyRegionTracker]: No global region param found. Use default: [-20, -20, 0.7] to [20, 20, 1.2]m." << endl;
+		}
+		else{
+			this->regionMin_ = Eigen::Vector3d (regionMinTemp[0], regionMinTemp[1], regionMinTemp[2]);
+			this->regionMax_ = Eigen::Vector3d (regionMaxTemp[0], regionMaxTemp[1], regionMaxTemp[2]);
+			cout << "[DirtyRegionTracker]: Global region is set to: " << this->regionMin_.transpose() << " to " << this->regionMax_.transpose() << "m." << endl;
+		}
+
+		// raycast range of the map
+		double raycastRange;
+		if (not this->nh_.getParam("dynamic_map/raycast_max_length", raycastRange)){
+			raycastRange = 5.0;
+			cout << "[DirtyRegionTracker]: No raycast max length param found. Use default: 5.0m." << endl;
+		}
+		else{
+			cout << "[DirtyRegionTracker]: Raycast max length is set to: " << raycastRange << "m." << endl;
+		}
+		this->updateRange_ = raycastRange + 0.5;
+	}
+
+	void dirtyRegionTracker::setResolution(double res){
+		this->res_ = res;
+		for (int i=0; i<3; ++i){
+			this->size_(i) = std::max(int(ceil((this->regionMax_(i) - this->regionMin_(i)) / this->res_)), 1);
+		}
+		this->init_ = false;
+		this->hasBox_ = false;
+	}
+
+	void dirtyRegionTracker::addPosition(const Eigen::Vector3d& pos){
+		if (not this->hasBox_){
+			this->boxMin_ = pos;
+			this->boxMax_ = pos;
+			this->hasBox_ = true;
+		}
+		else{
+			this->boxMin_ = this->boxMin_.cwiseMin(pos);
+			this->boxMax_ = this->boxMax_.cwiseMax(pos);
+		}
+	}
+
+	void dirtyRegionTracker::clear(){
+		this->hasBox_ = false;
+	}
+
+	bool dirtyRegionTracker::getDirtyBox(Eigen::Vector3d& boxMin, Eigen::Vector3d& boxMax, double margin){
+		if (not this->hasBox_){
+			return false;
+		}
+		Eigen::Vector3d range = Eigen::Vector3d::Constant(this->updateRange_ + margin);
+		boxMin = this->boxMin_ - range;
+		boxMax = this->boxMax_ + range;
+		this->hasBox_ = false;
+		return true;
+	}
+
+	bool dirtyRegionTracker::getDirtyRange(Eigen::Vector3i& idxMin, Eigen::Vector3i& idxMax, double margin){
+		if (not this->init_){
+			idxMin = Eigen::Vector3i::Zero();
+			idxMax = this->size_ - Eigen::Vector3i::Ones();
+			this->init_ = true;
+			this->hasBox_ = false;
+			return true;
+		}
+
+		Eigen::Vector3d boxMin, boxMax;
+		if (not this->getDirtyBox(boxMin, boxMax, margin)){
+			return false;
+		}
+		for (int i=0; i<3; ++i){
+			idxMin(i) = std::max(int(floor((boxMin(i) - this->regionMin_(i)) / this->res_)), 0);
+			idxMax(i) = std::min(int(floor((boxMax(i) - this->regionMin_(i)) / this->res_)), this->size_(i) - 1);
+		}
+		return (idxMin.array() <= idxMax.array()).all();
+	}
+
+	const Eigen::Vector3d& dirtyRegionTracker::getRegionMin(){
+		return this->regionMin_;
+	}
+
+	const Eigen::Vector3d& dirtyRegionTracker::getRegionMax(){
+		return this->regionMax_;
+	}
+
+	const Eigen::Vector3i& dirtyRegionTracker::getSize(){
+		return this->size_;
+	}
+
+	double dirtyRegionTracker::getRes(){
+		return this->res_;
+	}
+
+	int dirtyRegionTracker::getNumVoxels(){
+		return this->size_(0) * this->size_(1) * this->size_(2);
+	}
+
+	bool dirtyRegionTracker::isInRegion(const Eigen::Vector3i& idx){
+		return (idx.array() >= 0).all() and (idx.array() < this->size_.array()).all();
+	}
+
+	int dirtyRegionTracker::toIndex(const Eigen::Vector3i& idx){
+		return (idx(0) * this->size_(1) + idx(1)) * this->size_(2) + idx(2);
+	}
+
+	Eigen::Vector3i dirtyRegionTracker::toVoxel(int index){
+		Eigen::Vector3i idx;
+		idx(2) = index % this->size_(2);
+		index /= this->size_(2);
+		idx(1) = index % this->size_(1);
+		idx(0) = index / this->size_(1);
+		return idx;
+	}
+
+	Eigen::Vector3d dirtyRegionTracker::toPos(const Eigen::Vector3i& idx){
+		return this->regionMin_ + (idx.cast<double>() + Eigen::Vector3d::Constant(0.5)) * this->res_;
+	}
+}
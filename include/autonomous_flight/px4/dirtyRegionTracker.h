@@ -0,0 +1,64 @@
+/*
+	FILE: dirtyRegionTracker.h
+	------------------------
+	part of the exploration region changed since the last check
+*/
+
+#ifndef AUTOFLIGHT_DIRTY_REGION_TRACKER_H
+#define AUTOFLIGHT_DIRTY_REGION_TRACKER_H
+#include <ros/ros.h>
+#include <Eigen/Dense>
+#include <vector>
+
+using std::cout; using std::endl;
+namespace AutoFlight{
+	/*
+		The map only changes within the sensor range of the robot (the raycast range and a margin for
+		the freed obstacle regions). The tracker keeps the box of the robot positions since the last
+		check, so a module caching map data of the global region of the exploration planner only
+		rechecks that box expanded by the range. The first range of a tracker is the whole region.
+	*/
+	class dirtyRegionTracker{
+	private:
+		ros::NodeHandle nh_;
+
+		// parameters
+		Eigen::Vector3d regionMin_;
+		Eigen::Vector3d regionMax_;
+		double updateRange_;
+
+		// voxels of the region
+		double res_ = 0.1;
+		Eigen::Vector3i size_ {1, 1, 1};
+		bool init_ = false; // the whole region was returned
+		bool hasBox_ = false;
+		Eigen::Vector3d boxMin_;
+		Eigen::Vector3d boxMax_;
+
+	public:
+		dirtyRegionTracker(const ros::NodeHandle& nh);
+		void initParam();
+		void setResolution(double res);
+
+		// robot position at the rate of the caller
+		void addPosition(const Eigen::Vector3d& pos);
+		void clear(); // drops the positions since the last check
+
+		// box of the positions expanded by the update range and the margin. Returns false without new positions. Resets the box
+		bool getDirtyBox(Eigen::Vector3d& boxMin, Eigen::Vector3d& boxMax, double margin=0.0);
+		// voxel range of the dirty box in the region (the whole region on the first call). Returns false if nothing changed. Resets the box
+		bool getDirtyRange(Eigen::Vector3i& idxMin, Eigen::Vector3i& idxMax, double margin=0.0);
+
+		const Eigen::Vector3d& getRegionMin();
+		const Eigen::Vector3d& getRegionMax();
+		const Eigen::Vector3i& getSize();
+		double getRes();
+		int getNumVoxels();
+		bool isInRegion(const Eigen::Vector3i& idx);
+		int toIndex(const Eigen::Vector3i& idx);
+		Eigen::Vector3i toVoxel(int index);
+		Eigen::Vector3d toPos(const Eigen::Vector3i& idx);
+	};
+}
+
+#endif
@@ -11,8 +11,8 @@ namespace AutoFlight{
 		this->initParam();
 		this->initModules();
 		this->registerPub();
-		if (this->useFakeDetector_){
-			// free map callback
+		if (this->useFakeDetector_ and not this->useObstacleScenario_){
+			// free map callback (the scripted obstacles are not in the sensor data)
 			this->freeMapTimer_ = this->nh_.createTimer(ros::Duration(0.01), &dynamicExploration::freeMapCB, this);
 		}
 	}
@@ -26,6 +26,15 @@ namespace AutoFlight{
 		else{
 			cout << "[AutoFlight]: Use fake detector is set to: " << this->useFakeDetector_ << "." << endl;
 		}
+
+		// scripted obstacles in place of the fake detector
+		if (not this->nh_.getParam("autonomous_flight/use_obstacle_scenario", this->useObstacleScenario_)){
+			this->useObstacleScenario_ = false;
+			cout << "[AutoFlight]: No use obstacle scenario param found. Use default: false." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Use obstacle scenario is set to: " << this->useObstacleScenario_ << "." << endl;
+		}
 		
 		// desired velocity
 		if (not this->nh_.getParam("autonomous_flight/desired_velocity", this->desiredVel_)){
@@ -72,13 +81,88 @@ namespace AutoFlight{
 			cout << "[AutoFlight]: Initial scan is set to: " << this->initialScan_ << endl;
 		}	
 
-    	// replan time for dynamic obstacle
+		// yaw rate of the initial scan
+		if (not this->nh_.getParam("autonomous_flight/initial_scan_rate", this->initialScanRate_)){
+			this->initialScanRate_ = 0.8;
+			cout << "[AutoFlight]: No initial scan rate param found. Use default: 0.8rad/s." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Initial scan rate is set to: " << this->initialScanRate_ << "rad/s." << endl;
+		}
+
+		// the initial scan watches the unknown volume within this radius of the start
+		if (not this->nh_.getParam("autonomous_flight/initial_scan_radius", this->initialScanRadius_)){
+			this->initialScanRadius_ = 3.0;
+			cout << "[AutoFlight]: No initial scan radius param found. Use default: 3.0m." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Initial scan radius is set to: " << this->initialScanRadius_ << "m." << endl;
+		}
+
+		// the initial scan stops when the unknown volume shrinks by less than this ratio in a check (0.5s)
+		if (not this->nh_.getParam("autonomous_flight/initial_scan_min_shrink", this->initialScanMinShrink_)){
+			this->initialScanMinShrink_ = 0.02;
+			cout << "[AutoFlight]: No initial scan min shrink param found. Use default: 0.02." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Initial scan min shrink is set to: " << this->initialScanMinShrink_ << endl;
+		}
+
+		// minimum time between replans for the dynamic obstacles in the trajectory corridor
 		if (not this->nh_.getParam("autonomous_flight/replan_time_for_dynamic_obstacles", this->replanTimeForDynamicObstacle_)){
 			this->replanTimeForDynamicObstacle_ = 0.3;
 			cout << "[AutoFlight]: No dynamic obstacle replan time param found. Use default: 0.3s." << endl;
 		}
 		else{
 			cout << "[AutoFlight]: Dynamic obstacle replan time is set to: " << this->replanTimeForDynamicObstacle_ << "s." << endl;
+		}
+
+		// yaw planned along the trajectory: velocity, goal, waypoint or unknown
+		if (not this->nh_.getParam("autonomous_flight/yaw_mode", this->yawMode_)){
+			this->yawMode_ = "unknown";
+			cout << "[AutoFlight]: No yaw mode param found. Use default: unknown." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Yaw mode is set to: " << this->yawMode_ << "." << endl;
+		}
+		AutoFlight::YAW_MODE yawMode;
+		if (not AutoFlight::yawPlanner::getMode(this->yawMode_, yawMode)){
+			yawMode = AutoFlight::YAW_MODE::FACE_UNKNOWN;
+			cout << "[AutoFlight]: Invalid yaw mode " << this->yawMode_ << ". Use unknown." << endl;
+		}
+		this->yawPlanner_.setMode(yawMode);
+		this->yawPlanner_.setMaxAngularVel(this->desiredAngularVel_);
+
+		// camera frustum of the exploration planner
+		if (not this->nh_.getParam("DEP/horizontal_FOV", this->cameraHFov_)){
+			this->cameraHFov_ = 1.57;
+			cout << "[AutoFlight]: No camera horizontal FOV param found. Use default: 1.57." << endl;
+		}
+		if (not this->nh_.getParam("DEP/vertical_FOV", this->cameraVFov_)){
+			this->cameraVFov_ = 1.57;
+			cout << "[AutoFlight]: No camera vertical FOV param found. Use default: 1.57." << endl;
+		}
+		if (not this->nh_.getParam("DEP/dmax", this->cameraRange_)){
+			this->cameraRange_ = 2.0;
+			cout << "[AutoFlight]: No camera range param found. Use default: 2.0m." << endl;
+		}
+
+		// replan when the predicted clearance to the dynamic obstacles dropped by this distance
+		if (not this->nh_.getParam("autonomous_flight/dynamic_clearance_drop", this->dynamicClearanceDrop_)){
+			this->dynamicClearanceDrop_ = 0.1;
+			cout << "[AutoFlight]: No dynamic clearance drop param found. Use default: 0.1 m." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Dynamic clearance drop is set to: " << this->dynamicClearanceDrop_ << "m." << endl;
+		}
+
+		// delay from the obstacle measurement to its arrival
+		if (not this->nh_.getParam("autonomous_flight/obstacle_measurement_delay", this->obstacleDelay_)){
+			this->obstacleDelay_ = 0.05;
+			cout << "[AutoFlight]: No obstacle measurement delay param found. Use default: 0.05s." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Obstacle measurement delay is set to: " << this->obstacleDelay_ << "s." << endl;
 		}	
 
     	// free range 
@@ -102,19 +186,136 @@ namespace AutoFlight{
 		else{
 			cout << "[AutoFlight]: Reach goal distance is set to: " << this->reachGoalDistance_ << "m." << endl;
 		}	
+
+		// fly the entire exploration path as one trajectory instead of stopping at each waypoint
+		if (not this->nh_.getParam("autonomous_flight/continuous_path", this->continuousPath_)){
+			this->continuousPath_ = false;
+			cout << "[AutoFlight]: No continuous path param found. Use default: false." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Continuous path is set to: " << this->continuousPath_ << endl;
+		}
+
+		// wait for ENTER before takeoff, planning and each exploration replan
+		if (not this->nh_.getParam("autonomous_flight/manual_confirm", this->manualConfirm_)){
+			this->manualConfirm_ = false;
+			cout << "[AutoFlight]: No manual confirm param found. Use default: false." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Manual confirm is set to: " << this->manualConfirm_ << endl;
+		}
+
+		// replan the exploration path when the rest of the path is shorter than this
+		if (not this->nh_.getParam("autonomous_flight/exploration_replan_distance", this->explorationReplanDistance_)){
+			this->explorationReplanDistance_ = 1.0;
+			cout << "[AutoFlight]: No exploration replan distance param found. Use default: 1.0m." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Exploration replan distance is set to: " << this->explorationReplanDistance_ << "m." << endl;
+		}
+
+		// the unknown volume within this radius of the path end is the gain of the path
+		if (not this->nh_.getParam("autonomous_flight/exploration_gain_radius", this->explorationGainRadius_)){
+			this->explorationGainRadius_ = 2.0;
+			cout << "[AutoFlight]: No exploration gain radius param found. Use default: 2.0m." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Exploration gain radius is set to: " << this->explorationGainRadius_ << "m." << endl;
+		}
+
+		// replan the exploration path when its gain dropped below this ratio of the gain at planning
+		if (not this->nh_.getParam("autonomous_flight/exploration_gain_drop", this->explorationGainDrop_)){
+			this->explorationGainDrop_ = 0.3;
+			cout << "[AutoFlight]: No exploration gain drop param found. Use default: 0.3." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Exploration gain drop is set to: " << this->explorationGainDrop_ << endl;
+		}
+
+		// fly to the nearest reachable frontier while the exploration planner fails
+		if (not this->nh_.getParam("autonomous_flight/use_frontier_fallback", this->useFrontierFallback_)){
+			this->useFrontierFallback_ = true;
+			cout << "[AutoFlight]: No use frontier fallback param found. Use default: true." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Use frontier fallback is set to: " << this->useFrontierFallback_ << endl;
+		}
+
+		// time between the retries of a failed exploration plan (and between the frontier fallback goals)
+		if (not this->nh_.getParam("autonomous_flight/exploration_retry_time", this->explorationRetryTime_)){
+			this->explorationRetryTime_ = 1.0;
+			cout << "[AutoFlight]: No exploration retry time param found. Use default: 1.0s." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Exploration retry time is set to: " << this->explorationRetryTime_ << "s." << endl;
+		}
 	}
 
 	void dynamicExploration::initModules(){
 		// initialize map
 		if (this->useFakeDetector_){
-			// initialize fake detector
-			this->detector_.reset(new onboardDetector::fakeDetector (this->nh_));	
+			// initialize fake detector (or the scripted obstacles in place of it)
+			if (this->useObstacleScenario_){
+				this->obstacleScenario_.reset(new AutoFlight::obstacleScenario (this->nh_));
+			}
+			else{
+				this->detector_.reset(new onboardDetector::fakeDetector (this->nh_));
+			}
 			this->map_.reset(new mapManager::dynamicMap (this->nh_, false));
 		}
 		else{
 			this->map_.reset(new mapManager::dynamicMap (this->nh_));
 		}
 
+		// frustum stencil of the yaw planner
+		this->yawPlanner_.setMap(this->map_);
+		this->yawPlanner_.setFrustum(this->cameraHFov_, this->cameraVFov_, this->cameraRange_);
+
+		// map changes for the gain of the rest waypoints
+		this->gainRegion_.reset(new AutoFlight::dirtyRegionTracker (this->nh_));
+
+		// initialize exploration telemetry
+		this->telemetry_.reset(new AutoFlight::explorationTelemetry (this->nh_));
+		this->telemetry_->setMap(this->map_);
+
+		// load the checkpoint of the previous flight. The rest of its exploration path is flown first
+		this->checkpoint_.reset(new AutoFlight::explorationCheckpoint (this->nh_));
+		this->checkpoint_->setMap(this->map_);
+		nav_msgs::Path checkpointPath;
+		int checkpointWaypointIdx;
+		double checkpointPathTime;
+		if (this->checkpoint_->load(checkpointPath, checkpointWaypointIdx, checkpointPathTime)){
+			// the last reached waypoint becomes the start of the path
+			checkpointPath.poses.erase(checkpointPath.poses.begin(), checkpointPath.poses.begin() + (checkpointWaypointIdx - 1));
+			if (this->setPendingPath(checkpointPath, false, checkpointPathTime)){
+				this->explorationReplan_ = false;
+				cout << "[AutoFlight]: Resume the checkpoint path from waypoint " << checkpointWaypointIdx << " (" << checkpointPath.poses.size() - 1 << " waypoints left)." << endl;
+			}
+		}
+
+		// initialize frontier fallback
+		if (this->useFrontierFallback_){
+			this->frontierFinder_.reset(new AutoFlight::frontierFinder (this->nh_));
+			this->frontierFinder_->setMap(this->map_);
+			this->gridPlanner_.reset(new AutoFlight::gridPlanner (this->nh_));
+		}
+
+		// initialize obstacle predictor
+		this->obstaclePredictor_.reset(new AutoFlight::obstaclePredictor (this->nh_));
+		this->obstaclePredictor_->setRobotSize(this->map_->getRobotSize());
+
+		// initialize clearance monitor
+		this->clearanceMonitor_.reset(new AutoFlight::clearanceMonitor (this->nh_));
+		this->clearanceMonitor_->setMap(this->map_);
+		this->clearanceMonitor_->setPredictor(this->obstaclePredictor_);
+
+		// initialize replan engine
+		this->replanEngine_.reset(new AutoFlight::replanEngine (this->nh_));
+		this->registerReplanTriggers();
+
+		// initialize free region updater
+		this->freeRegionUpdater_.setMap(this->map_);
+
 		// initialize exploration planner
 		this->expPlanner_.reset(new globalPlanner::DEP (this->nh_));
 		this->expPlanner_->setMap(this->map_);
@@ -141,8 +342,8 @@ namespace AutoFlight{
 		this->exploreReplanWorker_ = std::thread(&dynamicExploration::exploreReplan, this);
 		this->exploreReplanWorker_.detach();
 
-		// exploration callback
-		// this->explorationTimer_ = this->nh_.createTimer(ros::Duration(0.1), &dynamicExploration::explorationCB, this);
+		// exploration scheduler callback (also takes the map snapshots for the exploration planner)
+		this->explorationTimer_ = this->nh_.createTimer(ros::Duration(0.1), &dynamicExploration::explorationCB, this);
 
 		// planner callback
 		this->plannerTimer_ = this->nh_.createTimer(ros::Duration(0.02), &dynamicExploration::plannerCB, this);
@@ -165,32 +366,286 @@ namespace AutoFlight{
 	}
 
 	void dynamicExploration::explorationCB(const ros::TimerEvent&){
-		if (this->explorationReplan_){
-			this->expPlanner_->setMap(this->map_);
-			ros::Time startTime = ros::Time::now();
-			bool replanSuccess = this->expPlanner_->makePlan();
-			if (replanSuccess){
-				this->waypoints_ = this->expPlanner_->getBestPath();
-				this->newWaypoints_ = true;
-				this->waypointIdx_ = 1;
-				this->explorationReplan_ = false;
+		/*
+			Request an exploration replan if
+			1. there is no exploration path
+			2. the rest of the path is nearly consumed
+			3. the unknown volume around the rest waypoints dropped (the path has little to explore) or a rest waypoint became invalid
+			Reached waypoints and invalid goals are requested by the replan triggers.
+			The requests are served by the exploration replan thread
+		*/
+		this->updateMapSnapshot();
+		Eigen::Vector3d currPos (this->odom_.pose.pose.position.x, this->odom_.pose.pose.position.y, this->odom_.pose.pose.position.z);
+		this->telemetry_->updateMotion(currPos, this->currVel_);
+		this->telemetry_->publish();
+		this->checkpoint_->update(currPos);
+		int nextWaypointIdx = this->continuousPath_ ? this->globalPathTracker_.getNextIdx() : this->waypointIdx_ - 1;
+		double pathTime = this->waypoints_.poses.size() != 0 ? (ros::Time::now() - this->pathStartTime_).toSec() : 0.0;
+		this->checkpoint_->save(this->waypoints_, nextWaypointIdx, pathTime);
+		this->gainRegion_->addPosition(currPos);
+		if (this->useFrontierFallback_){
+			this->frontierFinder_->update(currPos);
+		}
+		if (this->explorationReplan_ or this->explorationPlanning_ or this->newWaypoints_){ // wait for the pending plan to be served or taken
+			return;
+		}
+		if (this->initialScanning_ and not this->scanPlanRequested_){ // the initial scan requests the first plan
+			return;
+		}
+
+		if (this->waypoints_.poses.size() == 0){
+			this->requestExplorationReplan("no_path");
+			return;
+		}
+
+		if (this->trajectoryReady_ or this->replan_){
+			const nav_msgs::Path& restPath = this->getRestGlobalPath();
+			double restDistance = 0.0;
+			for (size_t i=1; i<restPath.poses.size(); ++i){
+				restDistance += AutoFlight::getPoseDistance(restPath.poses[i-1].pose, restPath.poses[i].pose);
 			}
-			ros::Time endTime = ros::Time::now();
-			cout << "[AutoFlight]: DEP planning time: " << (endTime - startTime).toSec() << "s." << endl;			
+			if (restDistance < this->explorationReplanDistance_){
+				this->requestExplorationReplan("path_end");
+				return;
+			}
+		}
+
+		ros::Time currTime = ros::Time::now();
+		if ((currTime - this->lastGainCheckTime_).toSec() >= 0.5){
+			this->lastGainCheckTime_ = currTime;
+			std::string reason;
+			if (this->checkWaypointGain(reason)){
+				this->requestExplorationReplan(reason);
+			}
+		}
+	}
+
+	void dynamicExploration::updateMapSnapshot(){
+		/*
+			The map is only updated in the ROS callbacks, so a copy taken in a callback is
+			consistent. The exploration planner plans on the copy while the mapping goes on.
+			The copy is requested only while the planner waits for it, so the snapshot is
+			overwritten in place and its buffers are allocated once. The copied ROS handles
+			are shared with the live map and bound to it, so the snapshot gets no callbacks
+		*/
+		if (not this->mapSnapshotRequest_ or this->mapSnapshotReady_){
+			return;
+		}
+
+		// a failed plan is retried on the same snapshot while the robot holds its pose (the sensors see the same space).
+		// The map still changes slowly while hovering (freed obstacle boxes, noise), so the snapshot is renewed after a few retries
+		ros::Time currTime = ros::Time::now();
+		if (this->mapSnapshot_ != NULL and this->mapSnapshotRetry_){
+			double moved = AutoFlight::getPoseDistance(this->odom_.pose.pose, this->mapSnapshotPose_);
+			double yawDiff = AutoFlight::rpy_from_quaternion(this->odom_.pose.pose.orientation) - AutoFlight::rpy_from_quaternion(this->mapSnapshotPose_.orientation);
+			double turned = std::abs(atan2(sin(yawDiff), cos(yawDiff)));
+			if (moved < this->map_->getRes() and turned < 0.1 and (currTime - this->mapSnapshotStamp_).toSec() < 10 * this->explorationRetryTime_){
+				this->mapSnapshotReused_ = true;
+				this->mapSnapshotRequest_ = false;
+				this->mapSnapshotReady_ = true;
+				return;
+			}
+		}
+		ros::WallTime startTime = ros::WallTime::now();
+		if (this->mapSnapshot_ == NULL){
+			this->mapSnapshot_.reset(new mapManager::dynamicMap (*this->map_));
+		}
+		else{
+			*this->mapSnapshot_ = *this->map_;
+		}
+		this->mapSnapshotPose_ = this->odom_.pose.pose;
+		this->mapSnapshotStamp_ = currTime;
+		this->mapSnapshotReused_ = false;
+		this->mapSnapshotTime_ = (ros::WallTime::now() - startTime).toSec();
+		this->telemetry_->addSnapshotTime(this->mapSnapshotTime_);
+		this->mapSnapshotRequest_ = false;
+		this->mapSnapshotReady_ = true;
+	}
+
+	void dynamicExploration::requestExplorationReplan(const std::string& reason){
+		if (not this->explorationReplan_){
+			this->telemetry_->addReplanRequest(reason);
+			cout << "[AutoFlight]: Request exploration replan (" << reason << ")." << endl;
+		}
+		this->explorationReplan_ = true;
+	}
+
+	bool dynamicExploration::setPendingPath(const nav_msgs::Path& path, bool fallback, double pathTime){
+		// a path needs a waypoint after the start to be flown
+		if (path.poses.size() < 2){
+			return false;
+		}
+		std::lock_guard<std::mutex> lock (this->pathMutex_);
+		if (fallback and this->newWaypoints_ and not this->pendingFallback_){ // an exploration path is waiting
+			return false;
+		}
+		this->pendingPath_ = path;
+		this->pendingFallback_ = fallback;
+		this->pendingPathTime_ = pathTime;
+		this->newWaypoints_ = true;
+		return true;
+	}
+
+	void dynamicExploration::takePendingPath(){
+		std::lock_guard<std::mutex> lock (this->pathMutex_);
+		this->waypoints_ = this->pendingPath_;
+		this->waypointIdx_ = 1;
+		this->pathStartTime_ = ros::Time::now() - ros::Duration (this->pendingPathTime_);
+		this->pendingFallback_ = false;
+		this->newWaypoints_ = false;
+	}
+
+	bool dynamicExploration::dropPendingFallback(){
+		std::lock_guard<std::mutex> lock (this->pathMutex_);
+		if (not this->newWaypoints_ or not this->pendingFallback_){
+			return false;
+		}
+		this->pendingFallback_ = false;
+		this->newWaypoints_ = false;
+		return true;
+	}
+
+	bool dynamicExploration::frontierFallback(const std::shared_ptr<mapManager::occMap>& map){
+		/*
+			Called by the replan thread when DEP fails. The path to the nearest reachable frontier is
+			planned on the map snapshot from the robot pose of the snapshot. The waypoint trigger only
+			takes it when the robot has nothing to fly
+		*/
+		if (not this->gridPlannerMapSet_){ // the snapshot is allocated once
+			this->gridPlanner_->setMap(map);
+			this->gridPlannerMapSet_ = true;
+		}
+		ros::Time currTime = ros::Time::now();
+		Eigen::Vector3d currPos (this->mapSnapshotPose_.position.x, this->mapSnapshotPose_.position.y, this->mapSnapshotPose_.position.z);
+		std::vector<AutoFlight::frontierCluster> clusters;
+		this->frontierFinder_->getClusters(currPos, map, clusters);
+		int numAttempts = 0;
+		for (const AutoFlight::frontierCluster& cluster : clusters){
+			if ((cluster.goal - currPos).norm() < this->explorationReplanDistance_){ // the robot is already there
+				continue;
+			}
+			if (numAttempts >= 3){ // bound the delay of the DEP retry
+				break;
+			}
+			++numAttempts;
+
+			geometry_msgs::Pose start, goal;
+			start = this->mapSnapshotPose_;
+			goal.position.x = cluster.goal(0);
+			goal.position.y = cluster.goal(1);
+			goal.position.z = cluster.goal(2);
+			std::vector<Eigen::Vector3d> path;
+			this->gridPlanner_->updateStart(start);
+			this->gridPlanner_->updateGoal(goal);
+			if (not this->gridPlanner_->makePlan(path)){
+				continue;
+			}
+
+			// each waypoint faces along the path, the last one toward the frontier
+			nav_msgs::Path waypoints;
+			waypoints.header.frame_id = "map";
+			waypoints.header.stamp = currTime;
+			for (size_t i=0; i<path.size(); ++i){
+				Eigen::Vector3d direction = (i + 1 < path.size()) ? path[i+1] - path[i] : cluster.centroid - path[i];
+				if (direction.head<2>().norm() < 1e-3 and i > 0){
+					direction = path[i] - path[i-1];
+				}
+				geometry_msgs::PoseStamped ps;
+				ps.header = waypoints.header;
+				ps.pose.position.x = path[i](0);
+				ps.pose.position.y = path[i](1);
+				ps.pose.position.z = path[i](2);
+				ps.pose.orientation = AutoFlight::quaternion_from_rpy(0, 0, atan2(direction(1), direction(0)));
+				waypoints.poses.push_back(ps);
+			}
+			if (not this->setPendingPath(waypoints, true)){
+				return false;
+			}
+			cout << "[AutoFlight]: Exploration plan fails. Fly to the frontier at " << cluster.goal.transpose() << " (" << cluster.size << " voxels)." << endl;
+			return true;
+		}
+		cout << "[AutoFlight]: Exploration plan fails. No reachable frontier (" << clusters.size() << " clusters)." << endl;
+		return false;
+	}
+
+	void dynamicExploration::resetWaypointGain(){
+		// called when a new path is taken
+		this->waypointGain_.clear();
+		for (const geometry_msgs::PoseStamped& ps : this->waypoints_.poses){
+			Eigen::Vector3d p (ps.pose.position.x, ps.pose.position.y, ps.pose.position.z);
+			this->waypointGain_.push_back(this->computeUnknownVolume(p, this->explorationGainRadius_, this->map_));
+		}
+		this->waypointGainAtPlan_ = this->waypointGain_;
+		this->gainRegion_->clear();
+	}
+
+	bool dynamicExploration::checkWaypointGain(std::string& reason){
+		// only for the path in flight
+		if (this->waypointGain_.size() != this->waypoints_.poses.size() or not (this->trajectoryReady_ or this->replan_)){
+			return false;
+		}
+		Eigen::Vector3d currPos (this->odom_.pose.pose.position.x, this->odom_.pose.pose.position.y, this->odom_.pose.pose.position.z);
+		this->globalPathTracker_.update(currPos);
+		int nextIdx = this->globalPathTracker_.getNextIdx();
+
+		// only the waypoints whose gain sphere meets the dirty region are evaluated again
+		Eigen::Vector3d boxMin, boxMax;
+		if (this->gainRegion_->getDirtyBox(boxMin, boxMax, this->explorationGainRadius_)){
+			for (size_t i=nextIdx; i<this->waypoints_.poses.size(); ++i){
+				Eigen::Vector3d p (this->waypoints_.poses[i].pose.position.x, this->waypoints_.poses[i].pose.position.y, this->waypoints_.poses[i].pose.position.z);
+				if ((p.array() >= boxMin.array()).all() and (p.array() <= boxMax.array()).all()){
+					this->waypointGain_[i] = this->computeUnknownVolume(p, this->explorationGainRadius_, this->map_);
+				}
+			}
+		}
+
+		// the rest waypoints have to stay valid in the current map (the exploration planner only has its snapshot)
+		double gain = 0.0;
+		double gainAtPlan = 0.0;
+		for (size_t i=nextIdx; i<this->waypoints_.poses.size(); ++i){
+			Eigen::Vector3d p (this->waypoints_.poses[i].pose.position.x, this->waypoints_.poses[i].pose.position.y, this->waypoints_.poses[i].pose.position.z);
+			if (not this->map_->isInMap(p) or this->map_->isInflatedOccupied(p)){
+				reason = "waypoint_invalid";
+				return true;
+			}
+			gain += this->waypointGain_[i];
+			gainAtPlan += this->waypointGainAtPlan_[i];
+		}
+
+		if (gainAtPlan > 0.0 and gain < this->explorationGainDrop_ * gainAtPlan){
+			reason = "gain_drop";
+			return true;
 		}
+		return false;
+	}
+
+	double dynamicExploration::computeUnknownVolume(const Eigen::Vector3d& center, double radius, const std::shared_ptr<mapManager::occMap>& map){
+		// coarse samples are enough to see the volume change
+		double step = 2 * map->getRes();
+		double r = radius;
+		int numUnknown = 0;
+		for (double x=-r; x<=r; x+=step){
+			for (double y=-r; y<=r; y+=step){
+				for (double z=-r; z<=r; z+=step){
+					if (x*x + y*y + z*z > r*r){
+						continue;
+					}
+					Eigen::Vector3d p = center + Eigen::Vector3d (x, y, z);
+					if (map->isInMap(p) and map->isUnknown(p)){
+						++numUnknown;
+					}
+				}
+			}
+		}
+		return numUnknown * pow(step, 3);
 	}
 
 	void dynamicExploration::plannerCB(const ros::TimerEvent&){
 		// cout << "in planner callback" << endl;
 
 		if (this->replan_){
-			std::vector<Eigen::Vector3d> obstaclesPos, obstaclesVel, obstaclesSize;
-			if (this->useFakeDetector_){
-				this->getDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
-			}
-			else{ 
-				this->map_->getDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
-			}			
+			AutoFlight::obstacleSnapshotPtr obstacles = this->getObstacleSnapshot();
+			const std::vector<Eigen::Vector3d>& obstaclesPos = obstacles->pos;
 			nav_msgs::Path inputTraj;
 			std::vector<Eigen::Vector3d> startEndConditions;
 			this->getStartEndConditions(startEndConditions); 
@@ -198,10 +653,15 @@ namespace AutoFlight{
 
 			// generate new trajectory
 			nav_msgs::Path simplePath;
-			geometry_msgs::PoseStamped pStart, pGoal;
-			pStart.pose = this->odom_.pose.pose;
-			pGoal = this->goal_;
-			simplePath.poses = {pStart, pGoal};
+			if (this->continuousPath_){ // through all the rest waypoints
+				simplePath = this->getRestGlobalPath();
+			}
+			else{
+				geometry_msgs::PoseStamped pStart, pGoal;
+				pStart.pose = this->odom_.pose.pose;
+				pGoal = this->goal_;
+				simplePath.poses = {pStart, pGoal};
+			}
 			this->pwlTraj_->updatePath(simplePath, false);
 			this->pwlTraj_->makePlan(inputTraj, this->bsplineTraj_->getControlPointDist());
 			// if (not this->trajectoryReady_){
@@ -284,7 +744,11 @@ namespace AutoFlight{
 			this->inputTrajMsg_ = inputTraj;
 			bool updateSuccess = this->bsplineTraj_->updatePath(inputTraj, startEndConditions);
 			if (obstaclesPos.size() != 0 and updateSuccess){
-				this->bsplineTraj_->updateDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
+				// only the obstacles near the input trajectory can affect the optimization
+				std::vector<Eigen::Vector3d> nearObstaclesPos, nearObstaclesVel, nearObstaclesSize;
+				this->obstaclePredictor_->update(obstacles);
+				this->obstaclePredictor_->getObstaclesNearPath(inputTraj, nearObstaclesPos, nearObstaclesVel, nearObstaclesSize);
+				this->bsplineTraj_->updateDynamicObstacles(nearObstaclesPos, nearObstaclesVel, nearObstaclesSize);
 			}
 			if (updateSuccess){
 				nav_msgs::Path bsplineTrajMsgTemp;
@@ -301,6 +765,13 @@ namespace AutoFlight{
 					// ros::Time timeOptEndTime = ros::Time::now();
 					// cout << "[AutoFlight]: Time optimizatoin spends: " << (timeOptEndTime - timeOptStartTime).toSec() << "s." << endl;
 
+					this->planYaw();
+
+					if (this->dwelling_){
+						this->telemetry_->addDwellTime((ros::Time::now() - this->dwellStartTime_).toSec());
+						this->dwelling_ = false;
+					}
+
 					this->trajectoryReady_ = true;
 					this->replan_ = false;
 					cout << "\033[1;32m[AutoFlight]: Trajectory generated successfully.\033[0m " << endl;
@@ -327,7 +798,7 @@ namespace AutoFlight{
 						}
 						else{
 							cout << "[AutoFlight]: Unable to generate a feasible trajectory." << endl;
-							cout << "\033[1;32m[AutoFlight]: Wait for new path. Press ENTER to Replan.\033[0m" << endl;
+							cout << "\033[1;32m[AutoFlight]: Wait for new path.\033[0m" << endl;
 							this->replan_ = false;
 						}
 					}
@@ -347,14 +818,55 @@ namespace AutoFlight{
 	void dynamicExploration::replanCheckCB(const ros::TimerEvent&){
 		/*
 			Replan if
-			1. collision detected
-			2. new goal point assigned
+			1. new waypoints assigned or the current waypoint reached
+			2. collision detected (static or predicted dynamic)
 			3. fixed distance
+			4. dynamic obstacles near the trajectory
+			The triggers are run by priority within the time budget of the replan engine
 		*/
+		this->updateObstacleSnapshot(); // obstacles shared by all checks of this cycle
+		this->executionDistanceReady_ = false;
+		this->replanEngine_->run();
+	}
+
+	void dynamicExploration::registerReplanTriggers(){
+		// name, priority, estimated cost (s), minimum period (s), urgent (ignores the budget and the hold time)
+		this->replanEngine_->addTrigger("waypoint", 0, 1e-5, 0.0, true, [this](){return this->waypointTrigger();});
+		this->replanEngine_->addTrigger("goal_valid", 1, 2e-4, 0.05, false, [this](){return this->goalValidTrigger();});
+		this->replanEngine_->addTrigger("collision", 2, 5e-5, 0.0, true, [this](){return this->collisionTrigger();});
+		this->replanEngine_->addTrigger("clearance", 3, 5e-4, 0.1, false, [this](){return this->clearanceTrigger();});
+		this->replanEngine_->addTrigger("regular", 4, 5e-5, 0.05, false, [this](){return this->regularReplanTrigger();});
+		this->replanEngine_->addTrigger("dynamic_obstacle", 5, 5e-5, 0.05, false, [this](){return this->dynamicObstacleTrigger();});
+	}
+
+	bool dynamicExploration::waypointTrigger(){
+		// a frontier path is only for a robot with nothing to fly
+		if (this->initialScanning_ or this->replan_ or this->trajectoryReady_){
+			this->dropPendingFallback();
+		}
+
+		if (this->newWaypoints_ and (this->continuousPath_ or this->trajectoryReady_)){
+			// keep flying the current trajectory until the one through the new path is ready
+			this->takePendingPath();
+			this->globalPathTracker_.setPath(this->waypoints_);
+			if (this->continuousPath_){
+				this->goal_ = this->waypoints_.poses.back();
+				this->waypointIdx_ = this->waypoints_.poses.size() + 1; // no stop at the intermediate waypoints
+			}
+			else{
+				this->goal_ = this->waypoints_.poses[this->waypointIdx_];
+				++this->waypointIdx_;
+			}
+			this->resetWaypointGain();
+			this->replan_ = true;
+			cout << "[AutoFlight]: Replan for new waypoints." << endl;
+			return true;
+		}
 
 		if (this->newWaypoints_){
 			this->replan_ = false;
 			this->trajectoryReady_ = false;
+			this->takePendingPath();
 			double yaw = atan2(this->waypoints_.poses[1].pose.position.y - this->odom_.pose.pose.position.y, this->waypoints_.poses[1].pose.position.x - this->odom_.pose.pose.position.x);
 			// cout << "[AutoFlight]: Go to next waypoint. Press ENTER to continue rotation." << endl;
 			// std::cin.clear();
@@ -366,14 +878,15 @@ namespace AutoFlight{
 			// fflush(stdin);
 			// std::cin.get();		
 			this->replan_ = true;
-			this->newWaypoints_ = false;
+			this->globalPathTracker_.setPath(this->waypoints_);
+			this->resetWaypointGain();
 			if (this->waypointIdx_ < int(this->waypoints_.poses.size())){
 				this->goal_ = this->waypoints_.poses[this->waypointIdx_];
 			}
 			++this->waypointIdx_;
 			cout << "[AutoFlight]: Replan for new waypoints." << endl; 
 
-			return;
+			return true;
 		}
 
 		// if (this->isReach(this->goal_, 0.1, false) and this->waypointIdx_ <= int(this->waypoints_.poses.size())){
@@ -385,6 +898,9 @@ namespace AutoFlight{
 			// when reach current goal point, reset replan and trajectory ready
 			this->replan_ = false;
 			this->trajectoryReady_ = false;
+			this->dwelling_ = true;
+			this->dwellStartTime_ = ros::Time::now();
+			this->checkpoint_->addWaypoint(Eigen::Vector3d (this->goal_.pose.position.x, this->goal_.pose.position.y, this->goal_.pose.position.z));
 			// cout << "[AutoFlight]: Go to next waypoint. Press ENTER to continue rotation." << endl;
 			// std::cin.clear();
 			// fflush(stdin);
@@ -405,83 +921,123 @@ namespace AutoFlight{
 				this->goal_ = this->waypoints_.poses[this->waypointIdx_];
 			}
 			if (this->waypointIdx_ + 1 > int(this->waypoints_.poses.size())){
-				cout << "\033[1;32m[AutoFlight]: Finishing entire path. Wait for new path. Press ENTER to Replan.\033[0m" << endl;
+				cout << "\033[1;32m[AutoFlight]: Finishing entire path. Wait for new path.\033[0m" << endl;
 				this->replan_ = false;
-				// this->explorationReplan_ = true;
+				this->requestExplorationReplan("path_end");
 			}
 			else{
 				cout << "[AutoFlight]: Start planning for next waypoint." << endl;
 				this->replan_ = true;
+				this->requestExplorationReplan("waypoint");
 			}
 			++this->waypointIdx_;
 			this->trajectoryReady_ = false;
 	
-			return;		
+			return true;		
 		}
 		else if (this->waypoints_.poses.size() != 0 and this->isReach(this->goal_, this->reachGoalDistance_, true) and (this->replan_ or this->trajectoryReady_)){
-			cout << "\033[[AutoFlight]: Finishing entire path. Wait for new path. Press ENTER to Replan.\033[0m" << endl;
+			cout << "\033[1;32m[AutoFlight]: Finishing entire path. Wait for new path.\033[0m" << endl;
 			this->replan_ = false;
 			this->trajectoryReady_ = false;
-			return;		
+			this->dwelling_ = true;
+			this->dwellStartTime_ = ros::Time::now();
+			this->checkpoint_->addWaypoint(Eigen::Vector3d (this->goal_.pose.position.x, this->goal_.pose.position.y, this->goal_.pose.position.z));
+			this->requestExplorationReplan("path_end");
+			return true;		
 		}
+		return false;
+	}
 
+	bool dynamicExploration::goalValidTrigger(){
 		if (this->waypoints_.poses.size() != 0){
 			if (not this->isGoalValid() and (this->replan_ or this->trajectoryReady_)){
 				this->replan_ = false;
 				this->trajectoryReady_ = false;
-				cout << "\033[1;32m[AutoFlight]: Current goal is invalid. Need new path. Press ENTER to Replan.\033[0m" << endl;
-				// this->explorationReplan_ = true;
-				return;
+				cout << "\033[1;32m[AutoFlight]: Current goal is invalid. Need new path.\033[0m" << endl;
+				this->requestExplorationReplan("goal_invalid");
+				return true;
 			}
 		}
+		return false;
+	}
 
-		// if (this->reachExplorationGoal()){
-		// 	this->replan_ = false;
-		// 	this->trajectoryReady_ = false;
-		// 	geometry_msgs::Quaternion quat = this->waypoints_.poses.back().pose.orientation;
-		// 	double yaw = AutoFlight::rpy_from_quaternion(quat);
-		// 	cout << "[AutoFlight]: Reach exploration goal. Rotate and replan..." << endl;
-		// 	this->moveToOrientation(yaw, this->desiredAngularVel_);
-		// 	cout << "[AutoFlight]: Finish rotation. Start to replan." << endl;
-		// 	this->replan_ = true;
-		// 	return;
-		// }
+	bool dynamicExploration::collisionTrigger(){
+		if (not this->trajectoryReady_){
+			return false;
+		}
 
-		if (this->trajectoryReady_){
-			if (not this->expPlanner_->isPosValid(this->trajectory_.at(this->trajectory_.getDuration()))){
-				this->trajectoryReady_ = false;
-				this->replan_ = false;
-				this->stop();
-				cout << "\033[1;32m[AutoFlight]: the goal of current local trajectory is not safe. Press ENTER to Replan.\033[0m" << endl;
-				return;
-			}
+		// the live map (the exploration planner holds the snapshot of the replan thread)
+		Eigen::Vector3d pEnd = this->trajectory_.at(this->trajectory_.getDuration());
+		if (not this->map_->isInMap(pEnd) or this->map_->isInflatedOccupied(pEnd)){
+			this->trajectoryReady_ = false;
+			this->replan_ = false;
+			this->stop();
+			cout << "\033[1;32m[AutoFlight]: the goal of current local trajectory is not safe. Need new path.\033[0m" << endl;
+			this->requestExplorationReplan("goal_invalid");
+			return true;
+		}
 
-			if (this->hasCollision()){ // if trajectory not ready, do not replan
-				this->replan_ = true;
-				cout << "[AutoFlight]: Replan for collision." << endl;
-				return;
-			}
+		// the rest of the trajectory hits an inflated occupied voxel. The clearance metrics are left to the clearance trigger
+		std::vector<Eigen::Vector3d> points;
+		std::vector<double> times;
+		this->getRestTrajectorySamples(points, times);
+		if (this->clearanceMonitor_->getStaticTtc(points, times) >= 0.0){
+			this->replan_ = true;
+			cout << "[AutoFlight]: Replan for collision." << endl;
+			return true;
+		}
+		return false;
+	}
 
-			// replan for dynamic obstacles
-			if (this->computeExecutionDistance() >= 0.3 and this->hasDynamicCollision()){
-			// if (this->hasDynamicObstacle()){
-				this->replan_ = true;
-				cout << "[AutoFlight]: Replan for dynamic obstacles." << endl;
-				return;
-			}
+	bool dynamicExploration::clearanceTrigger(){
+		if (not this->trajectoryReady_){
+			return false;
+		}
 
-			if (this->computeExecutionDistance() >= 1.5 and AutoFlight::getPoseDistance(this->odom_.pose.pose, this->goal_.pose) >= 3){
-				this->replan_ = true;
-				cout << "[AutoFlight]: Regular replan." << endl;
-				return;
-			}
+		// time to collision and clearance of the rest of the trajectory
+		const AutoFlight::clearanceState& clearance = this->updateClearance();
+		if (clearance.staticTtc >= 0.0){
+			this->replan_ = true;
+			cout << "[AutoFlight]: Replan for collision." << endl;
+			return true;
+		}
 
-			if (this->computeExecutionDistance() >= 0.3 and this->replanForDynamicObstacle()){
-				this->replan_ = true;
-				cout << "[AutoFlight]: Regular replan for dynamic obstacles." << endl;
-				return;
-			}
-		}	
+		// replan for dynamic obstacles. Conflicts close in time do not wait for the execution distance
+		if (clearance.level == AutoFlight::CLEARANCE_LEVEL::URGENT or (clearance.level == AutoFlight::CLEARANCE_LEVEL::CONFLICT and this->getExecutionDistance() >= 0.3)){
+			this->replan_ = true;
+			cout << "[AutoFlight]: Replan for dynamic obstacles. Time to collision: " << clearance.dynamicTtc << "s." << endl;
+			return true;
+		}
+		return false;
+	}
+
+	bool dynamicExploration::regularReplanTrigger(){
+		// the continuous path is only replanned for collisions and new exploration paths
+		if (not this->trajectoryReady_ or this->continuousPath_){
+			return false;
+		}
+
+		if (this->getExecutionDistance() >= 1.5 and AutoFlight::getPoseDistance(this->odom_.pose.pose, this->goal_.pose) >= 3){
+			this->replan_ = true;
+			cout << "[AutoFlight]: Regular replan." << endl;
+			return true;
+		}
+		return false;
+	}
+
+	bool dynamicExploration::dynamicObstacleTrigger(){
+		if (not this->trajectoryReady_){
+			return false;
+		}
+
+		// only the obstacles predicted to enter the trajectory corridor cause a replan
+		const AutoFlight::clearanceState& clearance = this->clearanceMonitor_->getState();
+		if (this->getExecutionDistance() >= 0.3 and this->replanForDynamicObstacle(clearance)){
+			this->replan_ = true;
+			cout << "[AutoFlight]: Replan for dynamic obstacles in the trajectory corridor." << endl;
+			return true;
+		}
+		return false;
 	}
 
 	void dynamicExploration::trajExeCB(const ros::TimerEvent&){
@@ -511,7 +1067,8 @@ namespace AutoFlight{
 				this->updateTargetWithState(target);						
 			}
 			else{
-				target.yaw = AutoFlight::rpy_from_quaternion(this->odom_.pose.pose.orientation);
+				target.yaw = this->yawPlanner_.at(this->trajTime_);
+				this->targetYaw_ = target.yaw;
 				target.position.x = pos(0);
 				target.position.y = pos(1);
 				target.position.z = pos(2);
@@ -524,6 +1081,15 @@ namespace AutoFlight{
 				this->updateTargetWithState(target);						
 			}
 		}
+		else if (this->initialScanning_){
+			this->initialScan();
+		}
+	}
+
+	void dynamicExploration::planYaw(){
+		// continue from the commanded yaw in flight
+		double startYaw = this->trajectoryReady_ ? this->targetYaw_ : AutoFlight::rpy_from_quaternion(this->odom_.pose.pose.orientation);
+		this->yawPlanner_.plan(this->trajectory_, this->bsplineTraj_->getLinearFactor(), startYaw, this->getRestGlobalPath());
 	}
 
 	void dynamicExploration::visCB(const ros::TimerEvent&){
@@ -553,21 +1119,14 @@ namespace AutoFlight{
 				freeRegions.push_back(std::make_pair(lowerBound, upperBound));
 			}
 		}
-		this->map_->updateFreeRegions(freeRegions);
-		this->map_->freeRegions(freeRegions);
+		this->freeRegionUpdater_.update(freeRegions);
 	}
 
 	void dynamicExploration::run(){
-		cout << "\033[1;32m[AutoFlight]: Please double check all parameters. Then PRESS ENTER to continue or PRESS CTRL+C to stop.\033[0m" << endl;
-		std::cin.clear();
-		fflush(stdin);
-		std::cin.get();
+		this->waitConfirm("Please double check all parameters. Then PRESS ENTER to continue or PRESS CTRL+C to stop.");
 		this->takeoff();
 
-		cout << "\033[1;32m[AutoFlight]: Takeoff succeed. Then PRESS ENTER to continue or PRESS CTRL+C to land.\033[0m" << endl;
-		std::cin.clear();
-		fflush(stdin);
-		std::cin.get();
+		this->waitConfirm("Takeoff succeed. Then PRESS ENTER to continue or PRESS CTRL+C to land.");
 
 		int temp1 = system("mkdir ~/rosbag_exploration_info &");
 		int temp2 = system("mv ~/rosbag_exploration_info/exploration_info.bag ~/rosbag_exploration_info/previous.bag &");
@@ -578,10 +1137,7 @@ namespace AutoFlight{
 
 		this->initExplore();
 
-		cout << "\033[1;32m[AutoFlight]: PRESS ENTER to Start Planning.\033[0m" << endl;
-		std::cin.clear();
-		fflush(stdin);
-		std::cin.get();
+		this->waitConfirm("PRESS ENTER to Start Planning.");
 
 		this->registerCallback();
 	}
@@ -595,29 +1151,89 @@ namespace AutoFlight{
 		this->map_->freeRegion(c1, c2);
 		cout << "[AutoFlight]: Robot nearby region is set to free. Range: " << this->freeRange_.transpose() << endl;
 
+		// the yaw sweep runs in the trajectory execution callback. The first exploration plan is requested during the sweep
 		if (this->initialScan_){
+			this->initialScanning_ = true;
+			this->scanPos_ = startPos;
+			this->scanStartYaw_ = AutoFlight::rpy_from_quaternion(this->odom_.pose.pose.orientation);
+			this->scanPlanRequested_ = this->newWaypoints_; // a resumed path is flown right away
+			this->explorationReplan_ = false;
 			cout << "[AutoFlight]: Start initial scan..." << endl;
-			this->moveToOrientation(-PI_const/2, this->desiredAngularVel_);
-			cout << "\033[1;32m[AutoFlight]: Press ENTER to continue next 90 degree.\033[0m" << endl;
-			std::cin.clear();
-			fflush(stdin);
-			std::cin.get();
-						
-			this->moveToOrientation(-PI_const, this->desiredAngularVel_);
-			cout << "\033[1;32m[AutoFlight]: Press ENTER to continue next 90 degree.\033[0m" << endl;
-			std::cin.clear();
-			fflush(stdin);
-			std::cin.get();
-
-			this->moveToOrientation(PI_const/2, this->desiredAngularVel_);
-			cout << "\033[1;32m[AutoFlight]: Press ENTER to continue next 90 degree.\033[0m" << endl;
-			std::cin.clear();
-			fflush(stdin);
-			std::cin.get();
-			
-			this->moveToOrientation(0, this->desiredAngularVel_);
-			cout << "[AutoFlight]: End initial scan." << endl; 
-		}		
+		}
+	}
+
+	void dynamicExploration::initialScan(){
+		ros::Time currTime = ros::Time::now();
+		if (this->scanStartTime_.isZero()){
+			this->scanStartTime_ = currTime;
+			this->lastScanCheckTime_ = currTime;
+			this->scanUnknownVolume_ = this->computeUnknownVolume(this->scanPos_, this->initialScanRadius_, this->map_);
+		}
+
+		// the sweep gives way to the first trajectory (a frontier path is dropped)
+		if ((this->newWaypoints_ and not this->dropPendingFallback()) or this->replan_ or this->trajectoryReady_){
+			this->stopInitialScan("exploration path received");
+			return;
+		}
+
+		double sweptAngle = this->initialScanRate_ * (currTime - this->scanStartTime_).toSec();
+		if (sweptAngle >= 2 * PI_const){
+			this->stopInitialScan("full turn");
+			return;
+		}
+
+		// plan as soon as the first camera view is in the map
+		if (not this->scanPlanRequested_ and sweptAngle >= this->cameraHFov_){
+			this->scanPlanRequested_ = true;
+			this->requestExplorationReplan("initial_scan");
+		}
+
+		// stop when the sweep does not reveal the start region any more
+		if ((currTime - this->lastScanCheckTime_).toSec() >= 0.5){
+			this->lastScanCheckTime_ = currTime;
+			double unknownVolume = this->computeUnknownVolume(this->scanPos_, this->initialScanRadius_, this->map_);
+			bool noShrink = this->scanUnknownVolume_ - unknownVolume <= this->initialScanMinShrink_ * this->scanUnknownVolume_;
+			this->scanUnknownVolume_ = unknownVolume;
+			if (sweptAngle >= this->cameraHFov_ and noShrink){
+				this->stopInitialScan("unknown volume does not shrink");
+				return;
+			}
+		}
+
+		tracking_controller::Target target;
+		target.position.x = this->scanPos_(0);
+		target.position.y = this->scanPos_(1);
+		target.position.z = this->scanPos_(2);
+		double yaw = this->scanStartYaw_ + sweptAngle;
+		target.yaw = atan2(sin(yaw), cos(yaw));
+		this->targetYaw_ = target.yaw;
+		this->updateTargetWithState(target);
+	}
+
+	void dynamicExploration::stopInitialScan(const std::string& reason){
+		if (not this->initialScanning_){
+			return;
+		}
+		this->initialScanning_ = false;
+		if (not this->scanPlanRequested_){
+			this->scanPlanRequested_ = true;
+			this->requestExplorationReplan("initial_scan");
+		}
+		if (not this->newWaypoints_ and not this->replan_ and not this->trajectoryReady_){
+			this->stop();
+		}
+		cout << "[AutoFlight]: End initial scan (" << reason << "). Time: " << (ros::Time::now() - this->scanStartTime_).toSec() << "s." << endl;
+	}
+
+	void dynamicExploration::waitConfirm(const std::string& message){
+		// the exploration only waits for the operator in the manual confirm mode
+		if (not this->manualConfirm_){
+			return;
+		}
+		cout << "\033[1;32m[AutoFlight]: " << message << "\033[0m" << endl;
+		std::cin.clear();
+		fflush(stdin);
+		std::cin.get();
 	}
 
 	void dynamicExploration::getStartEndConditions(std::vector<Eigen::Vector3d>& startEndConditions){
@@ -660,33 +1276,35 @@ namespace AutoFlight{
 
 	bool dynamicExploration::hasDynamicCollision(){
 		if (this->trajectoryReady_){
-			std::vector<Eigen::Vector3d> obstaclesPos, obstaclesVel, obstaclesSize;
-			if (this->useFakeDetector_){
-				this->getDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
-			}
-			else{ 
-				this->map_->getDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
-			}
-
-			for (double t=this->trajTime_; t<=this->trajectory_.getDuration(); t+=0.1){
-				Eigen::Vector3d p = this->trajectory_.at(t);
-				
-				for (size_t i=0; i<obstaclesPos.size(); ++i){
-					Eigen::Vector3d ob = obstaclesPos[i];
-					Eigen::Vector3d size = obstaclesSize[i];
-					Eigen::Vector3d lowerBound = ob - size/2;
-					Eigen::Vector3d upperBound = ob + size/2;
-					if (p(0) >= lowerBound(0) and p(0) <= upperBound(0) and
-						p(1) >= lowerBound(1) and p(1) <= upperBound(1) and
-						p(2) >= lowerBound(2) and p(2) <= upperBound(2)){
-						return true;
-					}					
-				}
-			}
+			AutoFlight::obstacleSnapshotPtr obstacles = this->getObstacleSnapshot();
+			this->obstaclePredictor_->update(obstacles);
+			std::vector<Eigen::Vector3d> points;
+			std::vector<double> times;
+			this->getRestTrajectorySamples(points, times);
+			double conflictTime;
+			return this->obstaclePredictor_->getEarliestConflict(points, times, conflictTime);
 		}
 		return false;
 	}
 
+	void dynamicExploration::getRestTrajectorySamples(std::vector<Eigen::Vector3d>& points, std::vector<double>& times){
+		// the sample at trajectory time t is reached (t - trajTime_)/linearReparamFactor seconds later
+		double linearReparamFactor = this->bsplineTraj_->getLinearFactor();
+		for (double t=this->trajTime_; t<=this->trajectory_.getDuration(); t+=0.1){
+			points.push_back(this->trajectory_.at(t));
+			times.push_back((t - this->trajTime_)/linearReparamFactor);
+		}
+	}
+
+	const AutoFlight::clearanceState& dynamicExploration::updateClearance(){
+		AutoFlight::obstacleSnapshotPtr obstacles = this->getObstacleSnapshot();
+		this->obstaclePredictor_->update(obstacles);
+		std::vector<Eigen::Vector3d> points;
+		std::vector<double> times;
+		this->getRestTrajectorySamples(points, times);
+		return this->clearanceMonitor_->update(points, times);
+	}
+
 	void dynamicExploration::exploreReplan(){
 		// set start region to be free
 		// Eigen::Vector3d range (2.0, 2.0, 1.0);
@@ -720,20 +1338,52 @@ namespace AutoFlight{
 		// 	cout << "[AutoFlight]: End initial scan." << endl; 
 		// }
 		while (ros::ok()){
-			this->expPlanner_->setMap(this->map_);
+			// the scheduler requests replans. In the manual confirm mode the operator does
+			if (not this->manualConfirm_ and not this->explorationReplan_){
+				ros::Duration (0.01).sleep();
+				continue;
+			}
+
+			// requests from now on need another plan (the map of this plan may miss their cause)
+			this->explorationReplan_ = false;
+			this->explorationPlanning_ = true;
+
+			// wait for a consistent copy of the map from the exploration callback
+			this->mapSnapshotRetry_ = this->depFailed_;
+			this->mapSnapshotRequest_ = true;
+			while (ros::ok() and not this->mapSnapshotReady_){
+				ros::Duration (0.001).sleep();
+			}
+			std::shared_ptr<mapManager::occMap> mapSnapshot = this->mapSnapshot_;
+
+			this->expPlanner_->setMap(mapSnapshot);
 			ros::Time startTime = ros::Time::now();
 			bool replanSuccess = this->expPlanner_->makePlan();
-			if (replanSuccess){
-				this->waypoints_ = this->expPlanner_->getBestPath();
-				this->newWaypoints_ = true;
-				this->waypointIdx_ = 1;
+			if (replanSuccess){ // the path is taken by the waypoint trigger
+				replanSuccess = this->setPendingPath(this->expPlanner_->getBestPath());
 			}
 			ros::Time endTime = ros::Time::now();
-			std::cin.clear();
-			fflush(stdin);
-			std::cin.get();		
-			cout << "[AutoFlight]: DEP planning time: " << (endTime - startTime).toSec() << "s." << endl;
-
+			this->telemetry_->addPlanTime((endTime - startTime).toSec());
+			this->depFailed_ = not replanSuccess;
+			if (not replanSuccess){ // a failed plan is retried. Meanwhile the robot flies to the nearest frontier
+				this->explorationReplan_ = true;
+				if (this->useFrontierFallback_){
+					this->frontierFallback(mapSnapshot);
+				}
+			}
+			this->mapSnapshotReady_ = false;
+			this->explorationPlanning_ = false;
+			if (this->mapSnapshotReused_){
+				cout << "[AutoFlight]: DEP planning time: " << (endTime - startTime).toSec() << "s (map snapshot of the last plan)." << endl;
+			}
+			else{
+				cout << "[AutoFlight]: DEP planning time: " << (endTime - startTime).toSec() << "s (map snapshot: " << 1000.0 * this->mapSnapshotTime_ << "ms)." << endl;
+			}
+			if (not replanSuccess){
+				cout << "[AutoFlight]: DEP fails. Retry in " << this->explorationRetryTime_ << "s." << endl;
+				ros::Duration (this->explorationRetryTime_).sleep();
+			}
+			this->waitConfirm("Press ENTER to Replan.");
 		}
 	}
 
@@ -766,25 +1416,47 @@ namespace AutoFlight{
 		return -1.0;
 	}
 
-	bool dynamicExploration::replanForDynamicObstacle(){
-		ros::Time currTime = ros::Time::now();
-		std::vector<Eigen::Vector3d> obstaclesPos, obstaclesVel, obstaclesSize;
-		if (this->useFakeDetector_){
-			this->getDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
+	double dynamicExploration::getExecutionDistance(){
+		// computed once per replan check
+		if (not this->executionDistanceReady_){
+			this->executionDistance_ = this->computeExecutionDistance();
+			this->executionDistanceReady_ = true;
 		}
-		else{ 
-			this->map_->getDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
+		return this->executionDistance_;
+	}
+
+	bool dynamicExploration::replanForDynamicObstacle(const AutoFlight::clearanceState& clearance){
+		// no obstacle enters the trajectory corridor within the prediction horizon
+		if (clearance.level == AutoFlight::CLEARANCE_LEVEL::AMPLE){
+			this->lastDynamicObstacle_ = false;
+			return false;
 		}
 
+		ros::Time currTime = ros::Time::now();
+		double timePassed = (currTime - this->lastDynamicObstacleTime_).toSec();
 		bool replan = false;
-		bool hasDynamicObstacle = (obstaclesPos.size() != 0);
-		if (hasDynamicObstacle){
-			double timePassed = (currTime - this->lastDynamicObstacleTime_).toSec();
-			if (timePassed >= this->replanTimeForDynamicObstacle_){
+		if (not this->lastDynamicObstacle_){ // an obstacle starts to enter the corridor
+			replan = true;
+		}
+		else if (timePassed >= this->replanTimeForDynamicObstacle_){
+			// replan more often as the conflict gets closer or while the predicted clearance keeps dropping
+			if (clearance.dynamicTtc >= 0.0 and timePassed >= 0.5 * clearance.dynamicTtc){
+				replan = true;
+			}
+			else if (clearance.dynamicClearance < this->dynamicClearanceRef_ - this->dynamicClearanceDrop_){
 				replan = true;
-				this->lastDynamicObstacleTime_ = currTime;
 			}
 		}
+		this->lastDynamicObstacle_ = true;
+
+		if (replan){
+			this->lastDynamicObstacleTime_ = currTime;
+			this->dynamicClearanceRef_ = clearance.dynamicClearance;
+		}
+		else{
+			// the replanned trajectory can keep a larger clearance
+			this->dynamicClearanceRef_ = std::max(this->dynamicClearanceRef_, clearance.dynamicClearance);
+		}
 		return replan;
 	}
 
@@ -834,108 +1506,22 @@ namespace AutoFlight{
 		return currentTraj;
 	}
 
-	nav_msgs::Path dynamicExploration::getRestGlobalPath(){
-		nav_msgs::Path currPath;
-
-		int nextIdx = this->waypoints_.poses.size()-1;
+	const nav_msgs::Path& dynamicExploration::getRestGlobalPath(){
 		Eigen::Vector3d pCurr (this->odom_.pose.pose.position.x, this->odom_.pose.pose.position.y, this->odom_.pose.pose.position.z);
-		double minDist = std::numeric_limits<double>::infinity();
-		for (size_t i=0; i<this->waypoints_.poses.size()-1; ++i){
-			geometry_msgs::PoseStamped ps = this->waypoints_.poses[i];
-			Eigen::Vector3d pEig (ps.pose.position.x, ps.pose.position.y, ps.pose.position.z);
-			Eigen::Vector3d pDiff = pCurr - pEig;
-
-			geometry_msgs::PoseStamped psNext = this->waypoints_.poses[i+1];
-			Eigen::Vector3d pEigNext (psNext.pose.position.x, psNext.pose.position.y, psNext.pose.position.z);
-			Eigen::Vector3d diffToNext = pEigNext - pEig;
-			double dist = (pEig - pCurr).norm();
-			if (trajPlanner::angleBetweenVectors(diffToNext, pDiff) > PI_const*3.0/4.0){
-				if (dist < minDist){
-					nextIdx = i;
-					minDist = dist;
-				}
-			}
-		}
-
-
-		geometry_msgs::PoseStamped psCurr;
-		psCurr.pose = this->odom_.pose.pose;
-		currPath.poses.push_back(psCurr);
-		for (size_t i=nextIdx; i<this->waypoints_.poses.size(); ++i){
-			currPath.poses.push_back(this->waypoints_.poses[i]);
-		}
-		return currPath;		
-	}
-
-	nav_msgs::Path dynamicExploration::getRestGlobalPath(const Eigen::Vector3d& pos){
-		nav_msgs::Path currPath;
-
-		int nextIdx = this->waypoints_.poses.size()-1;
-		Eigen::Vector3d pCurr = pos;
-		double minDist = std::numeric_limits<double>::infinity();
-		for (size_t i=0; i<this->waypoints_.poses.size()-1; ++i){
-			geometry_msgs::PoseStamped ps = this->waypoints_.poses[i];
-			Eigen::Vector3d pEig (ps.pose.position.x, ps.pose.position.y, ps.pose.position.z);
-			Eigen::Vector3d pDiff = pCurr - pEig;
-
-			geometry_msgs::PoseStamped psNext = this->waypoints_.poses[i+1];
-			Eigen::Vector3d pEigNext (psNext.pose.position.x, psNext.pose.position.y, psNext.pose.position.z);
-			Eigen::Vector3d diffToNext = pEigNext - pEig;
-			double dist = (pEig - pCurr).norm();
-			if (trajPlanner::angleBetweenVectors(diffToNext, pDiff) > PI_const*3.0/4.0){
-				if (dist < minDist){
-					nextIdx = i;
-					minDist = dist;
-				}
-			}
-		}
-
-
-		geometry_msgs::PoseStamped psCurr;
-		psCurr.pose = this->odom_.pose.pose;
-		currPath.poses.push_back(psCurr);
-		for (size_t i=nextIdx; i<this->waypoints_.poses.size(); ++i){
-			currPath.poses.push_back(this->waypoints_.poses[i]);
-		}
-		return currPath;		
-	}
-
-	nav_msgs::Path dynamicExploration::getRestGlobalPath(const Eigen::Vector3d& pos, double yaw){
-		nav_msgs::Path currPath;
-
-		int nextIdx = this->waypoints_.poses.size()-1;
-		Eigen::Vector3d pCurr = pos;
-		Eigen::Vector3d direction (cos(yaw), sin(yaw), 0);
-		double minDist = std::numeric_limits<double>::infinity();
-		for (size_t i=0; i<this->waypoints_.poses.size()-1; ++i){
-			geometry_msgs::PoseStamped ps = this->waypoints_.poses[i];
-			Eigen::Vector3d pEig (ps.pose.position.x, ps.pose.position.y, ps.pose.position.z);
-
-			geometry_msgs::PoseStamped psNext = this->waypoints_.poses[i+1];
-			Eigen::Vector3d pEigNext (psNext.pose.position.x, psNext.pose.position.y, psNext.pose.position.z);
-			Eigen::Vector3d diffToNext = pEigNext - pEig;
-			double dist = (pEig - pCurr).norm();
-			if (trajPlanner::angleBetweenVectors(diffToNext, direction) > PI_const*3.0/4.0){
-				if (dist < minDist){
-					nextIdx = i;
-					minDist = dist;
-				}
-			}
-		}
+		this->globalPathTracker_.update(pCurr);
+		return this->globalPathTracker_.getRestPath(this->odom_.pose.pose);
+	}
 
 
-		geometry_msgs::PoseStamped psCurr;
-		psCurr.pose = this->odom_.pose.pose;
-		currPath.poses.push_back(psCurr);
-		for (size_t i=nextIdx; i<this->waypoints_.poses.size(); ++i){
-			currPath.poses.push_back(this->waypoints_.poses[i]);
-		}
-		return currPath;		
-	}
 
 	void dynamicExploration::getDynamicObstacles(std::vector<Eigen::Vector3d>& obstaclesPos, std::vector<Eigen::Vector3d>& obstaclesVel, std::vector<Eigen::Vector3d>& obstaclesSize){
 		std::vector<onboardDetector::box3D> obstacles;
-		this->detector_->getObstaclesInSensorRange(PI_const, obstacles);
+		if (this->useObstacleScenario_){
+			this->obstacleScenario_->getObstaclesInSensorRange(PI_const, obstacles);
+		}
+		else{
+			this->detector_->getObstaclesInSensorRange(PI_const, obstacles);
+		}
 		for (onboardDetector::box3D ob : obstacles){
 			Eigen::Vector3d pos (ob.x, ob.y, ob.z);
 			Eigen::Vector3d vel (ob.Vx, ob.Vy, 0.0);
@@ -946,6 +1532,44 @@ namespace AutoFlight{
 		}
 	}
 
+	void dynamicExploration::updateObstacleSnapshot(){
+		std::shared_ptr<AutoFlight::obstacleSnapshot> snapshot (new AutoFlight::obstacleSnapshot);
+		if (this->useFakeDetector_){
+			this->getDynamicObstacles(snapshot->pos, snapshot->vel, snapshot->size);
+		}
+		else{
+			this->map_->getDynamicObstacles(snapshot->pos, snapshot->vel, snapshot->size);
+		}
+		snapshot->stamp = ros::Time::now() - ros::Duration (this->obstacleDelay_); // measurement time
+		++this->numObstacleConversions_;
+
+		// the previous snapshot (and its measurement time) is kept if the obstacles do not change
+		if (this->obstacleSnapshot_ == NULL or not this->obstacleSnapshot_->hasSameObstacles(*snapshot)){
+			snapshot->seq = (this->obstacleSnapshot_ == NULL) ? 0 : this->obstacleSnapshot_->seq + 1;
+			this->obstacleSnapshot_ = snapshot;
+		}
+
+		// each request used to be one conversion
+		ros::Time currTime = ros::Time::now();
+		double statTime = (currTime - this->obstacleStatTime_).toSec();
+		if (statTime >= 10.0){
+			if (not this->obstacleStatTime_.isZero()){
+				cout << "[AutoFlight]: Dynamic obstacle conversions: " << this->numObstacleConversions_/statTime << "/s for " << this->numObstacleRequests_/statTime << " requests/s." << endl;
+			}
+			this->numObstacleConversions_ = 0;
+			this->numObstacleRequests_ = 0;
+			this->obstacleStatTime_ = currTime;
+		}
+	}
+
+	AutoFlight::obstacleSnapshotPtr dynamicExploration::getObstacleSnapshot(){
+		if (this->obstacleSnapshot_ == NULL){
+			this->updateObstacleSnapshot();
+		}
+		++this->numObstacleRequests_;
+		return this->obstacleSnapshot_;
+	}
+
 
 	void dynamicExploration::waitTime(double time){
 		ros::Rate r (30);
@@ -6,12 +6,29 @@
 #ifndef DYNAMIC_EXPLORATION
 #define DYNAMIC_EXPLORATION
 #include <autonomous_flight/px4/flightBase.h>
+#include <autonomous_flight/px4/pathTracker.h>
+#include <autonomous_flight/px4/obstacleSnapshot.h>
+#include <autonomous_flight/px4/obstaclePredictor.h>
+#include <autonomous_flight/px4/freeRegionUpdater.h>
 #include <global_planner/dep.h>
 #include <trajectory_planner/polyTrajOccMap.h>
 #include <trajectory_planner/piecewiseLinearTraj.h>
 #include <trajectory_planner/bsplineTraj.h>
 #include <map_manager/dynamicMap.h>
 #include <onboard_detector/fakeDetector.h>
+#include <autonomous_flight/px4/obstacleScenario.h>
+#include <autonomous_flight/px4/clearanceMonitor.h>
+#include <autonomous_flight/px4/replanEngine.h>
+#include <autonomous_flight/px4/yawPlanner.h>
+#include <autonomous_flight/px4/explorationTelemetry.h>
+#include <autonomous_flight/px4/frontierFinder.h>
+#include <autonomous_flight/px4/explorationCheckpoint.h>
+#include <autonomous_flight/px4/gridPlanner.h>
+#include <autonomous_flight/px4/dirtyRegionTracker.h>
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <limits>
 
 
 namespace AutoFlight{
@@ -19,6 +36,10 @@ namespace AutoFlight{
 	private:
 		std::shared_ptr<mapManager::dynamicMap> map_;
 		std::shared_ptr<onboardDetector::fakeDetector> detector_;
+		std::shared_ptr<AutoFlight::obstacleScenario> obstacleScenario_;
+		std::shared_ptr<AutoFlight::obstaclePredictor> obstaclePredictor_;
+		std::shared_ptr<AutoFlight::clearanceMonitor> clearanceMonitor_;
+		std::shared_ptr<AutoFlight::replanEngine> replanEngine_;
 		std::shared_ptr<globalPlanner::DEP> expPlanner_;
 		std::shared_ptr<trajPlanner::polyTrajOccMap> polyTraj_;
 		std::shared_ptr<trajPlanner::pwlTraj> pwlTraj_;
@@ -38,21 +59,72 @@ namespace AutoFlight{
 		
 		// parameters
 		bool useFakeDetector_;
+		bool useObstacleScenario_;
 		double desiredVel_;
 		double desiredAcc_;
 		double desiredAngularVel_;
 		double wpStablizeTime_;
 		bool initialScan_;
+		double initialScanRate_;
+		double initialScanRadius_;
+		double initialScanMinShrink_;
 		double replanTimeForDynamicObstacle_;
+		double dynamicClearanceDrop_;
+		double obstacleDelay_;
 		Eigen::Vector3d freeRange_;
 		double reachGoalDistance_;
+		bool continuousPath_;
+		std::string yawMode_;
+		double cameraHFov_;
+		double cameraVFov_;
+		double cameraRange_;
+		bool manualConfirm_;
+		double explorationReplanDistance_;
+		double explorationGainRadius_;
+		double explorationGainDrop_;
+		bool useFrontierFallback_;
+		double explorationRetryTime_;
 
 		// exploration data
-		bool explorationReplan_ = true;
+		std::atomic<bool> explorationReplan_ {true}; // requested by the scheduler and served by the replan thread
+		std::atomic<bool> explorationPlanning_ {false}; // the replan thread is planning. Only events request another plan meanwhile
+		std::vector<double> waypointGain_; // unknown volume around each waypoint, kept current near the map updates
+		std::vector<double> waypointGainAtPlan_; // ... when the path was taken
+		std::shared_ptr<AutoFlight::dirtyRegionTracker> gainRegion_; // map changes since the last gain check
+		ros::Time lastGainCheckTime_;
+		bool initialScanning_ = false; // yaw sweep at the start position until the first plan
+		Eigen::Vector3d scanPos_;
+		double scanStartYaw_ = 0.0;
+		ros::Time scanStartTime_;
+		ros::Time lastScanCheckTime_;
+		double scanUnknownVolume_ = 0.0; // unknown volume around the start at the last check
+		bool scanPlanRequested_ = false;
+		bool depFailed_ = false; // the last exploration plan failed and is retried (replan thread)
+		std::shared_ptr<AutoFlight::frontierFinder> frontierFinder_; // fallback goals while DEP fails
+		std::shared_ptr<AutoFlight::gridPlanner> gridPlanner_; // path to the frontier goals on the map snapshot (replan thread)
+		bool gridPlannerMapSet_ = false;
+		std::shared_ptr<AutoFlight::explorationCheckpoint> checkpoint_; // map and mission state for the resume after a landing
+		std::shared_ptr<AutoFlight::explorationTelemetry> telemetry_; // exploration metrics at 1 Hz
+		bool dwelling_ = false; // stopped at a waypoint until the next trajectory
+		ros::Time dwellStartTime_;
+		std::shared_ptr<mapManager::dynamicMap> mapSnapshot_; // map copy for the exploration planner
+		std::atomic<bool> mapSnapshotRequest_ {false};
+		std::atomic<bool> mapSnapshotReady_ {false};
+		double mapSnapshotTime_ = 0.0;
+		geometry_msgs::Pose mapSnapshotPose_; // robot pose when the snapshot was taken
+		ros::Time mapSnapshotStamp_;
+		std::atomic<bool> mapSnapshotRetry_ {false}; // the request retries a failed plan. The snapshot is kept if the robot held its pose
+		bool mapSnapshotReused_ = false;
 		bool replan_ = false;
-		bool newWaypoints_ = false;
+		std::mutex pathMutex_;
+		nav_msgs::Path pendingPath_; // latest path from the replan thread (or the checkpoint), not yet taken
+		bool pendingFallback_ = false; // pendingPath_ goes to a frontier. It is only taken by an idle robot
+		double pendingPathTime_ = 0.0; // time already flown along pendingPath_ (path resumed from the checkpoint)
+		std::atomic<bool> newWaypoints_ {false}; // pendingPath_ is set
 		int waypointIdx_ = 1;
-		nav_msgs::Path waypoints_; // latest waypoints from exploration planner
+		nav_msgs::Path waypoints_; // path in flight. Only used by the ROS callbacks
+		ros::Time pathStartTime_; // waypoints_ taken (earlier by the time flown before a resume)
+		AutoFlight::pathTracker globalPathTracker_; // progress along the global path
 		nav_msgs::Path inputTrajMsg_;
 		nav_msgs::Path polyTrajMsg_;
 		nav_msgs::Path pwlTrajMsg_;
@@ -61,7 +133,18 @@ namespace AutoFlight{
 		ros::Time trajStartTime_;
 		double trajTime_; // current trajectory time
 		trajPlanner::bspline trajectory_;
+		bool lastDynamicObstacle_ = false;
 		ros::Time lastDynamicObstacleTime_;
+		double dynamicClearanceRef_ = 0.0; // predicted clearance at the last dynamic obstacle replan
+		AutoFlight::obstacleSnapshotPtr obstacleSnapshot_; // obstacles of the current cycle
+		int numObstacleConversions_ = 0;
+		int numObstacleRequests_ = 0;
+		ros::Time obstacleStatTime_;
+		AutoFlight::freeRegionUpdater freeRegionUpdater_; // clears only the changed part of the obstacle boxes
+		AutoFlight::yawPlanner yawPlanner_; // yaw along the trajectory
+		double targetYaw_ = 0.0; // last commanded yaw
+		double executionDistance_ = 0.0;
+		bool executionDistanceReady_ = false;
 	
 	public:
 		std::thread exploreReplanWorker_;
@@ -79,22 +162,46 @@ namespace AutoFlight{
 		void trajExeCB(const ros::TimerEvent&);
 		void visCB(const ros::TimerEvent&);
 		void freeMapCB(const ros::TimerEvent&); // using fake detector
+		void planYaw();
+
+		void updateMapSnapshot();
+		void requestExplorationReplan(const std::string& reason);
+		bool setPendingPath(const nav_msgs::Path& path, bool fallback=false, double pathTime=0.0);
+		void takePendingPath();
+		bool dropPendingFallback();
+		bool frontierFallback(const std::shared_ptr<mapManager::occMap>& map);
+		void resetWaypointGain();
+		bool checkWaypointGain(std::string& reason);
+		double computeUnknownVolume(const Eigen::Vector3d& center, double radius, const std::shared_ptr<mapManager::occMap>& map);
 
 		void run();
 		void initExplore();
+		void initialScan();
+		void stopInitialScan(const std::string& reason);
+		void waitConfirm(const std::string& message);
 		void getStartEndConditions(std::vector<Eigen::Vector3d>& startEndConditions);
 		bool hasCollision();
 		bool hasDynamicCollision();
+		void getRestTrajectorySamples(std::vector<Eigen::Vector3d>& points, std::vector<double>& times);
+		const AutoFlight::clearanceState& updateClearance();
+		void registerReplanTriggers();
+		bool waypointTrigger();
+		bool goalValidTrigger();
+		bool collisionTrigger();
+		bool clearanceTrigger();
+		bool regularReplanTrigger();
+		bool dynamicObstacleTrigger();
 		void exploreReplan();
 		double computeExecutionDistance();
-		bool replanForDynamicObstacle();
+		double getExecutionDistance();
+		bool replanForDynamicObstacle(const AutoFlight::clearanceState& clearance);
 		bool reachExplorationGoal();
 		bool isGoalValid();
 		nav_msgs::Path getCurrentTraj(double dt);
-		nav_msgs::Path getRestGlobalPath();
-		nav_msgs::Path getRestGlobalPath(const Eigen::Vector3d& pos);
-		nav_msgs::Path getRestGlobalPath(const Eigen::Vector3d& pos, double yaw);
+		const nav_msgs::Path& getRestGlobalPath();
 		void getDynamicObstacles(std::vector<Eigen::Vector3d>& obstaclesPos, std::vector<Eigen::Vector3d>& obstaclesVel, std::vector<Eigen::Vector3d>& obstaclesSize);
+		void updateObstacleSnapshot();
+		AutoFlight::obstacleSnapshotPtr getObstacleSnapshot();
 		void waitTime(double time);
 	};
 }
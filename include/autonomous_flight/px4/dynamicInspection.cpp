@@ -11,8 +11,8 @@ namespace AutoFlight{
 		this->initParam();
 		this->initModules();
 		this->registerPub();
-		if (this->useFakeDetector_){
-			// free map callback
+		if (this->useFakeDetector_ and not this->useObstacleScenario_){
+			// free map callback (the scripted obstacles are not in the sensor data)
 			this->freeMapTimer_ = this->nh_.createTimer(ros::Duration(0.01), &dynamicInspection::freeMapCB, this);
 		}
 	}
@@ -27,6 +27,15 @@ namespace AutoFlight{
 			cout << "[AutoFlight]: Use fake detector is set to: " << this->useFakeDetector_ << "." << endl;
 		}
 
+		// scripted obstacles in place of the fake detector
+		if (not this->nh_.getParam("autonomous_flight/use_obstacle_scenario", this->useObstacleScenario_)){
+			this->useObstacleScenario_ = false;
+			cout << "[AutoFlight]: No use obstacle scenario param found. Use default: false." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Use obstacle scenario is set to: " << this->useObstacleScenario_ << "." << endl;
+		}
+
 
 		// desired velocity
 		if (not this->nh_.getParam("autonomous_flight/desired_velocity", this->desiredVel_)){
@@ -275,34 +284,87 @@ namespace AutoFlight{
 			cout << "[AutoFlight]: Backward turn is set to: " << this->backwardNoTurn_ << endl;
 		}	
 
-    	// replan time for dynamic obstacle
+		// minimum time between replans for the dynamic obstacles in the trajectory corridor
 		if (not this->nh_.getParam("autonomous_flight/replan_time_for_dynamic_obstacles", this->replanTimeForDynamicObstacle_)){
 			this->replanTimeForDynamicObstacle_ = 0.3;
 			cout << "[AutoFlight]: No dynamic obstacle replan time param found. Use default: 0.3s." << endl;
 		}
 		else{
 			cout << "[AutoFlight]: Dynamic obstacle replan time is set to: " << this->replanTimeForDynamicObstacle_ << "s." << endl;
+		}
+
+		// replan when the predicted clearance to the dynamic obstacles dropped by this distance
+		if (not this->nh_.getParam("autonomous_flight/dynamic_clearance_drop", this->dynamicClearanceDrop_)){
+			this->dynamicClearanceDrop_ = 0.1;
+			cout << "[AutoFlight]: No dynamic clearance drop param found. Use default: 0.1 m." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Dynamic clearance drop is set to: " << this->dynamicClearanceDrop_ << "m." << endl;
+		}
+
+		// delay from the obstacle measurement to its arrival
+		if (not this->nh_.getParam("autonomous_flight/obstacle_measurement_delay", this->obstacleDelay_)){
+			this->obstacleDelay_ = 0.05;
+			cout << "[AutoFlight]: No obstacle measurement delay param found. Use default: 0.05s." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Obstacle measurement delay is set to: " << this->obstacleDelay_ << "s." << endl;
 		}	
 
+		// global planner type
+		if (not this->nh_.getParam("grid_planner/use_grid_planner", this->useGridPlanner_)){
+			this->useGridPlanner_ = false;
+			cout << "[AutoFlight]: No use grid planner param found. Use default: false (RRT)." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Use grid planner is set to: " << this->useGridPlanner_ << "." << endl;
+		}
 	}
 
 	void dynamicInspection::initModules(){
 		// initialize map
 		if (this->useFakeDetector_){
-			// initialize fake detector
-			this->detector_.reset(new onboardDetector::fakeDetector (this->nh_));	
+			// initialize fake detector (or the scripted obstacles in place of it)
+			if (this->useObstacleScenario_){
+				this->obstacleScenario_.reset(new AutoFlight::obstacleScenario (this->nh_));
+			}
+			else{
+				this->detector_.reset(new onboardDetector::fakeDetector (this->nh_));
+			}
 			this->map_.reset(new mapManager::dynamicMap (this->nh_, false));
 		}
 		else{
 			this->map_.reset(new mapManager::dynamicMap (this->nh_));
 		}
 
+		// initialize obstacle predictor
+		this->obstaclePredictor_.reset(new AutoFlight::obstaclePredictor (this->nh_));
+		this->obstaclePredictor_->setRobotSize(this->map_->getRobotSize());
+
+		// initialize clearance monitor
+		this->clearanceMonitor_.reset(new AutoFlight::clearanceMonitor (this->nh_));
+		this->clearanceMonitor_->setMap(this->map_);
+		this->clearanceMonitor_->setPredictor(this->obstaclePredictor_);
+
+		// initialize replan engine
+		this->replanEngine_.reset(new AutoFlight::replanEngine (this->nh_));
+		this->registerReplanTriggers();
+
+		// initialize free region updater
+		this->freeRegionUpdater_.setMap(this->map_);
+
 		// initialize fake detector
 		// this->detector_.reset(new onboardVision::fakeDetector (this->nh_));
 
-		// initialize rrt planner
-		this->rrtPlanner_.reset(new globalPlanner::rrtOccMap<3> (this->nh_));
-		this->rrtPlanner_->setMap(this->map_);
+		// initialize global planner
+		if (this->useGridPlanner_){
+			this->gridPlanner_.reset(new AutoFlight::gridPlanner (this->nh_));
+			this->gridPlanner_->setMap(this->map_);
+		}
+		else{
+			this->rrtPlanner_.reset(new globalPlanner::rrtOccMap<3> (this->nh_));
+			this->rrtPlanner_->setMap(this->map_);
+		}
 
 		// initialize polynomial trajectory planner
 		this->polyTraj_.reset(new trajPlanner::polyTrajOccMap (this->nh_));
@@ -388,13 +450,8 @@ namespace AutoFlight{
 		if (this->flightState_ == FLIGHT_STATE::FORWARD){
 			// navigate to the goal position
 			if (this->replan_){
-				std::vector<Eigen::Vector3d> obstaclesPos, obstaclesVel, obstaclesSize;
-				if (this->useFakeDetector_){
-					this->getDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
-				}
-				else{ 
-					this->map_->getDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
-				}				
+				AutoFlight::obstacleSnapshotPtr obstacles = this->getObstacleSnapshot();
+				const std::vector<Eigen::Vector3d>& obstaclesPos = obstacles->pos;
 				std::vector<Eigen::Vector3d> startEndConditions;
 				this->getStartEndConditions(startEndConditions); 
 
@@ -524,7 +581,11 @@ namespace AutoFlight{
 
 				bool updateSuccess = this->bsplineTraj_->updatePath(inputTraj, startEndConditions);
 				if (obstaclesPos.size() != 0 and updateSuccess){
-					this->bsplineTraj_->updateDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
+					// only the obstacles near the input trajectory can affect the optimization
+					std::vector<Eigen::Vector3d> nearObstaclesPos, nearObstaclesVel, nearObstaclesSize;
+					this->obstaclePredictor_->update(obstacles);
+					this->obstaclePredictor_->getObstaclesNearPath(inputTraj, nearObstaclesPos, nearObstaclesVel, nearObstaclesSize);
+					this->bsplineTraj_->updateDynamicObstacles(nearObstaclesPos, nearObstaclesVel, nearObstaclesSize);
 				}
 				if (updateSuccess){
 					nav_msgs::Path bsplineTrajMsgTemp;
@@ -624,9 +685,8 @@ namespace AutoFlight{
 				bool bestViewPointSuccess = this->getBestViewPoint(pGoalExplore);
 				if (bestViewPointSuccess){
 					geometry_msgs::PoseStamped psGoalExplore = this->eigen2ps(pGoalExplore);
-					this->rrtPlanner_->updateStart(this->odom_.pose.pose);
-					this->rrtPlanner_->updateGoal(psGoalExplore.pose);
-					this->rrtPlanner_->makePlan(this->rrtPathMsg_);	
+					this->makeGlobalPlan(this->odom_.pose.pose, psGoalExplore.pose, this->rrtPathMsg_);	
+					this->globalPathTracker_.setPath(this->rrtPathMsg_);
 					this->prevState_ = this->flightState_;
 				}
 				else{
@@ -644,17 +704,12 @@ namespace AutoFlight{
 					// bspline trajectory generation
 					double finalTime; // final time for bspline trajectory
 					double initTs = this->bsplineTraj_->getInitTs();
-					std::vector<Eigen::Vector3d> obstaclesPos, obstaclesVel, obstaclesSize;
-					if (this->useFakeDetector_){
-						this->getDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
-					}
-					else{ 
-						this->map_->getDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
-					}					
+					AutoFlight::obstacleSnapshotPtr obstacles = this->getObstacleSnapshot();
+					const std::vector<Eigen::Vector3d>& obstaclesPos = obstacles->pos;
 					std::vector<Eigen::Vector3d> startEndConditions;
 					this->getStartEndConditions(startEndConditions); 
 					// get the latest global waypoint path
-					nav_msgs::Path latestGLobalPath = this->getRestGlobalPath();
+					const nav_msgs::Path& latestGLobalPath = this->getRestGlobalPath();
 
 					this->polyTraj_->updatePath(latestGLobalPath, startEndConditions);
 					geometry_msgs::Twist vel;
@@ -687,7 +742,11 @@ namespace AutoFlight{
 
 					bool updateSuccess = this->bsplineTraj_->updatePath(inputTraj, startEndConditions);
 					if (obstaclesPos.size() != 0 and updateSuccess){
-						this->bsplineTraj_->updateDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
+						// only the obstacles near the input trajectory can affect the optimization
+						std::vector<Eigen::Vector3d> nearObstaclesPos, nearObstaclesVel, nearObstaclesSize;
+						this->obstaclePredictor_->update(obstacles);
+						this->obstaclePredictor_->getObstaclesNearPath(inputTraj, nearObstaclesPos, nearObstaclesVel, nearObstaclesSize);
+						this->bsplineTraj_->updateDynamicObstacles(nearObstaclesPos, nearObstaclesVel, nearObstaclesSize);
 					}
 					if (updateSuccess){
 						nav_msgs::Path bsplineTrajMsgTemp;
@@ -845,9 +904,8 @@ namespace AutoFlight{
 					this->moveToOrientationStep(-PI_const);
 				}
 				cout << "[AutoFlight]: Start generating global plan..." << endl;
-				this->rrtPlanner_->updateStart(this->odom_.pose.pose);
-				this->rrtPlanner_->updateGoal(psBack.pose);
-				this->rrtPlanner_->makePlan(this->rrtPathMsg_);
+				this->makeGlobalPlan(this->odom_.pose.pose, psBack.pose, this->rrtPathMsg_);
+				this->globalPathTracker_.setPath(this->rrtPathMsg_);
 				cout << "[AutoFlight]: Global planning finished." << endl;
 			}
 
@@ -857,17 +915,12 @@ namespace AutoFlight{
 					// bspline trajectory generation
 					double finalTime; // final time for bspline trajectory
 					double initTs = this->bsplineTraj_->getInitTs();
-					std::vector<Eigen::Vector3d> obstaclesPos, obstaclesVel, obstaclesSize;
-					if (this->useFakeDetector_){
-						this->getDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
-					}
-					else{ 
-						this->map_->getDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
-					}					
+					AutoFlight::obstacleSnapshotPtr obstacles = this->getObstacleSnapshot();
+					const std::vector<Eigen::Vector3d>& obstaclesPos = obstacles->pos;
 					std::vector<Eigen::Vector3d> startEndConditions;
 					this->getStartEndConditions(startEndConditions); 
 					// get the latest global waypoint path
-					nav_msgs::Path latestGLobalPath = this->getRestGlobalPath();
+					const nav_msgs::Path& latestGLobalPath = this->getRestGlobalPath();
 
 					this->polyTraj_->updatePath(latestGLobalPath, startEndConditions);
 					geometry_msgs::Twist vel;
@@ -901,7 +954,11 @@ namespace AutoFlight{
 
 					bool updateSuccess = this->bsplineTraj_->updatePath(inputTraj, startEndConditions);
 					if (obstaclesPos.size() != 0 and updateSuccess){
-						this->bsplineTraj_->updateDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
+						// only the obstacles near the input trajectory can affect the optimization
+						std::vector<Eigen::Vector3d> nearObstaclesPos, nearObstaclesVel, nearObstaclesSize;
+						this->obstaclePredictor_->update(obstacles);
+						this->obstaclePredictor_->getObstaclesNearPath(inputTraj, nearObstaclesPos, nearObstaclesVel, nearObstaclesSize);
+						this->bsplineTraj_->updateDynamicObstacles(nearObstaclesPos, nearObstaclesVel, nearObstaclesSize);
 					}
 					if (updateSuccess){
 						nav_msgs::Path bsplineTrajMsgTemp;
@@ -1116,47 +1173,105 @@ namespace AutoFlight{
 	void dynamicInspection::replanCB(const ros::TimerEvent&){
 		/*
 			Replan if
-			1. collision detected
-			2. new goal point assigned
+			1. wall detected
+			2. collision detected (static or predicted dynamic)
 			3. fixed distance
+			4. dynamic obstacles near the trajectory
+			The triggers are run by priority within the time budget of the replan engine
 		*/
+		this->updateObstacleSnapshot(); // obstacles shared by all checks of this cycle
+		this->executionDistanceReady_ = false;
+		this->replanEngine_->run();
+	}
 
-		if (this->trajectoryReady_ and this->flightState_ != FLIGHT_STATE::INSPECT){
-			if (not this->wallDetected_){
-				if (this->isWallDetected()){
-					this->replan_ = true;
-					this->wallDetected_ = true;
-					cout << "[AutoFlight]: Replan for wall detection." << endl;
-					return;
-				}
-			}
+	void dynamicInspection::registerReplanTriggers(){
+		// name, priority, estimated cost (s), minimum period (s), urgent (ignores the budget and the hold time)
+		this->replanEngine_->addTrigger("wall", 0, 2e-4, 0.05, false, [this](){return this->wallTrigger();});
+		this->replanEngine_->addTrigger("collision", 1, 5e-5, 0.0, true, [this](){return this->collisionTrigger();});
+		this->replanEngine_->addTrigger("clearance", 2, 5e-4, 0.1, false, [this](){return this->clearanceTrigger();});
+		this->replanEngine_->addTrigger("regular", 3, 5e-5, 0.05, false, [this](){return this->regularReplanTrigger();});
+		this->replanEngine_->addTrigger("dynamic_obstacle", 4, 5e-5, 0.05, false, [this](){return this->dynamicObstacleTrigger();});
+	}
 
-			if (this->hasCollision()){ // if trajectory not ready, do not replan
-				this->replan_ = true;
-				cout << "[AutoFlight]: Replan for collision." << endl;
-				return;
-			}
+	bool dynamicInspection::wallTrigger(){
+		if (not this->trajectoryReady_ or this->flightState_ == FLIGHT_STATE::INSPECT or this->wallDetected_){
+			return false;
+		}
 
-			// replan for dynamic obstacles
-			if (this->computeExecutionDistance() >= 0.3 and this->hasDynamicCollision()){
-			// if (this->hasDynamicObstacle()){
-				this->replan_ = true;
-				cout << "[AutoFlight]: Replan for dynamic obstacles." << endl;
-				return;
-			}
+		if (this->isWallDetected()){
+			this->replan_ = true;
+			this->wallDetected_ = true;
+			cout << "[AutoFlight]: Replan for wall detection." << endl;
+			return true;
+		}
+		return false;
+	}
 
-			if (this->computeExecutionDistance() >= 1.5 and AutoFlight::getPoseDistance(this->odom_.pose.pose, this->goal_.pose) >= 3){
-				this->replan_ = true;
-				cout << "[AutoFlight]: Regular replan." << endl;
-				return;
-			}
+	bool dynamicInspection::collisionTrigger(){
+		if (not this->trajectoryReady_ or this->flightState_ == FLIGHT_STATE::INSPECT){
+			return false;
+		}
 
-			if (this->computeExecutionDistance() >= 0.3 and this->replanForDynamicObstacle()){
-				this->replan_ = true;
-				cout << "[AutoFlight]: Regular replan for dynamic obstacles." << endl;
-				return;
-			}
-		}		
+		// the rest of the trajectory hits an inflated occupied voxel. The clearance metrics are left to the clearance trigger
+		std::vector<Eigen::Vector3d> points;
+		std::vector<double> times;
+		this->getRestTrajectorySamples(points, times);
+		if (this->clearanceMonitor_->getStaticTtc(points, times) >= 0.0){
+			this->replan_ = true;
+			cout << "[AutoFlight]: Replan for collision." << endl;
+			return true;
+		}
+		return false;
+	}
+
+	bool dynamicInspection::clearanceTrigger(){
+		if (not this->trajectoryReady_ or this->flightState_ == FLIGHT_STATE::INSPECT){
+			return false;
+		}
+
+		// time to collision and clearance of the rest of the trajectory
+		const AutoFlight::clearanceState& clearance = this->updateClearance();
+		if (clearance.staticTtc >= 0.0){
+			this->replan_ = true;
+			cout << "[AutoFlight]: Replan for collision." << endl;
+			return true;
+		}
+
+		// replan for dynamic obstacles. Conflicts close in time do not wait for the execution distance
+		if (clearance.level == AutoFlight::CLEARANCE_LEVEL::URGENT or (clearance.level == AutoFlight::CLEARANCE_LEVEL::CONFLICT and this->getExecutionDistance() >= 0.3)){
+			this->replan_ = true;
+			cout << "[AutoFlight]: Replan for dynamic obstacles. Time to collision: " << clearance.dynamicTtc << "s." << endl;
+			return true;
+		}
+		return false;
+	}
+
+	bool dynamicInspection::regularReplanTrigger(){
+		if (not this->trajectoryReady_ or this->flightState_ == FLIGHT_STATE::INSPECT){
+			return false;
+		}
+
+		if (this->getExecutionDistance() >= 1.5 and AutoFlight::getPoseDistance(this->odom_.pose.pose, this->goal_.pose) >= 3){
+			this->replan_ = true;
+			cout << "[AutoFlight]: Regular replan." << endl;
+			return true;
+		}
+		return false;
+	}
+
+	bool dynamicInspection::dynamicObstacleTrigger(){
+		if (not this->trajectoryReady_ or this->flightState_ == FLIGHT_STATE::INSPECT){
+			return false;
+		}
+
+		// only the obstacles predicted to enter the trajectory corridor cause a replan
+		const AutoFlight::clearanceState& clearance = this->clearanceMonitor_->getState();
+		if (this->getExecutionDistance() >= 0.3 and this->replanForDynamicObstacle(clearance)){
+			this->replan_ = true;
+			cout << "[AutoFlight]: Replan for dynamic obstacles in the trajectory corridor." << endl;
+			return true;
+		}
+		return false;
 	}
 
 	void dynamicInspection::visCB(const ros::TimerEvent&){
@@ -1194,8 +1309,7 @@ namespace AutoFlight{
 				freeRegions.push_back(std::make_pair(lowerBound, upperBound));
 			}
 		}
-		this->map_->updateFreeRegions(freeRegions);
-		this->map_->freeRegions(freeRegions);
+		this->freeRegionUpdater_.update(freeRegions);
 	}
 
 	geometry_msgs::PoseStamped dynamicInspection::getForwardGoal(){
@@ -1228,42 +1342,33 @@ namespace AutoFlight{
 		return goal;
 	}
 
-	nav_msgs::Path dynamicInspection::getRestGlobalPath(){
-		nav_msgs::Path currPath;
-
-		int nextIdx = this->rrtPathMsg_.poses.size()-1;
-		Eigen::Vector3d pCurr (this->odom_.pose.pose.position.x, this->odom_.pose.pose.position.y, this->odom_.pose.pose.position.z);
-		double minDist = std::numeric_limits<double>::infinity();
-		for (size_t i=0; i<this->rrtPathMsg_.poses.size()-1; ++i){
-			geometry_msgs::PoseStamped ps = this->rrtPathMsg_.poses[i];
-			Eigen::Vector3d pEig (ps.pose.position.x, ps.pose.position.y, ps.pose.position.z);
-			Eigen::Vector3d pDiff = pCurr - pEig;
-
-			geometry_msgs::PoseStamped psNext = this->rrtPathMsg_.poses[i+1];
-			Eigen::Vector3d pEigNext (psNext.pose.position.x, psNext.pose.position.y, psNext.pose.position.z);
-			Eigen::Vector3d diffToNext = pEigNext - pEig;
-			double dist = (pEig - pCurr).norm();
-			if (trajPlanner::angleBetweenVectors(diffToNext, pDiff) > PI_const*3.0/4.0){
-				if (dist < minDist){
-					nextIdx = i;
-					minDist = dist;
-				}
-			}
+	void dynamicInspection::makeGlobalPlan(const geometry_msgs::Pose& start, const geometry_msgs::Pose& goal, nav_msgs::Path& path){
+		if (this->useGridPlanner_){
+			this->gridPlanner_->updateStart(start);
+			this->gridPlanner_->updateGoal(goal);
+			this->gridPlanner_->makePlan(path);
 		}
-
-
-		geometry_msgs::PoseStamped psCurr;
-		psCurr.pose = this->odom_.pose.pose;
-		currPath.poses.push_back(psCurr);
-		for (size_t i=nextIdx; i<this->rrtPathMsg_.poses.size(); ++i){
-			currPath.poses.push_back(this->rrtPathMsg_.poses[i]);
+		else{
+			this->rrtPlanner_->updateStart(start);
+			this->rrtPlanner_->updateGoal(goal);
+			this->rrtPlanner_->makePlan(path);
 		}
-		return currPath;		
+	}
+
+	const nav_msgs::Path& dynamicInspection::getRestGlobalPath(){
+		Eigen::Vector3d pCurr (this->odom_.pose.pose.position.x, this->odom_.pose.pose.position.y, this->odom_.pose.pose.position.z);
+		this->globalPathTracker_.update(pCurr);
+		return this->globalPathTracker_.getRestPath(this->odom_.pose.pose);
 	}
 
 	void dynamicInspection::getDynamicObstacles(std::vector<Eigen::Vector3d>& obstaclesPos, std::vector<Eigen::Vector3d>& obstaclesVel, std::vector<Eigen::Vector3d>& obstaclesSize){
 		std::vector<onboardDetector::box3D> obstacles;
-		this->detector_->getObstaclesInSensorRange(PI_const, obstacles);
+		if (this->useObstacleScenario_){
+			this->obstacleScenario_->getObstaclesInSensorRange(PI_const, obstacles);
+		}
+		else{
+			this->detector_->getObstaclesInSensorRange(PI_const, obstacles);
+		}
 		for (onboardDetector::box3D ob : obstacles){
 			Eigen::Vector3d pos (ob.x, ob.y, ob.z);
 			Eigen::Vector3d vel (ob.Vx, ob.Vy, 0.0);
@@ -1274,6 +1379,44 @@ namespace AutoFlight{
 		}
 	}
 
+	void dynamicInspection::updateObstacleSnapshot(){
+		std::shared_ptr<AutoFlight::obstacleSnapshot> snapshot (new AutoFlight::obstacleSnapshot);
+		if (this->useFakeDetector_){
+			this->getDynamicObstacles(snapshot->pos, snapshot->vel, snapshot->size);
+		}
+		else{
+			this->map_->getDynamicObstacles(snapshot->pos, snapshot->vel, snapshot->size);
+		}
+		snapshot->stamp = ros::Time::now() - ros::Duration (this->obstacleDelay_); // measurement time
+		++this->numObstacleConversions_;
+
+		// the previous snapshot (and its measurement time) is kept if the obstacles do not change
+		if (this->obstacleSnapshot_ == NULL or not this->obstacleSnapshot_->hasSameObstacles(*snapshot)){
+			snapshot->seq = (this->obstacleSnapshot_ == NULL) ? 0 : this->obstacleSnapshot_->seq + 1;
+			this->obstacleSnapshot_ = snapshot;
+		}
+
+		// each request used to be one conversion
+		ros::Time currTime = ros::Time::now();
+		double statTime = (currTime - this->obstacleStatTime_).toSec();
+		if (statTime >= 10.0){
+			if (not this->obstacleStatTime_.isZero()){
+				cout << "[AutoFlight]: Dynamic obstacle conversions: " << this->numObstacleConversions_/statTime << "/s for " << this->numObstacleRequests_/statTime << " requests/s." << endl;
+			}
+			this->numObstacleConversions_ = 0;
+			this->numObstacleRequests_ = 0;
+			this->obstacleStatTime_ = currTime;
+		}
+	}
+
+	AutoFlight::obstacleSnapshotPtr dynamicInspection::getObstacleSnapshot(){
+		if (this->obstacleSnapshot_ == NULL){
+			this->updateObstacleSnapshot();
+		}
+		++this->numObstacleRequests_;
+		return this->obstacleSnapshot_;
+	}
+
 	void dynamicInspection::getStartEndConditions(std::vector<Eigen::Vector3d>& startEndConditions){
 		/*	
 			1. start velocity
@@ -2238,32 +2381,35 @@ namespace AutoFlight{
 
 	bool dynamicInspection::hasDynamicCollision(){
 		if (this->trajectoryReady_){
-			std::vector<Eigen::Vector3d> obstaclesPos, obstaclesVel, obstaclesSize;
-			if (this->useFakeDetector_){
-				this->getDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
-			}
-			else{ 
-				this->map_->getDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
-			}			
-			for (double t=this->trajTime_; t<=this->trajectory_.getDuration(); t+=0.1){
-				Eigen::Vector3d p = this->trajectory_.at(t);
-				
-				for (size_t i=0; i<obstaclesPos.size(); ++i){
-					Eigen::Vector3d ob = obstaclesPos[i];
-					Eigen::Vector3d size = obstaclesSize[i];
-					Eigen::Vector3d lowerBound = ob - size/2;
-					Eigen::Vector3d upperBound = ob + size/2;
-					if (p(0) >= lowerBound(0) and p(0) <= upperBound(0) and
-						p(1) >= lowerBound(1) and p(1) <= upperBound(1) and
-						p(2) >= lowerBound(2) and p(2) <= upperBound(2)){
-						return true;
-					}					
-				}
-			}
+			AutoFlight::obstacleSnapshotPtr obstacles = this->getObstacleSnapshot();
+			this->obstaclePredictor_->update(obstacles);
+			std::vector<Eigen::Vector3d> points;
+			std::vector<double> times;
+			this->getRestTrajectorySamples(points, times);
+			double conflictTime;
+			return this->obstaclePredictor_->getEarliestConflict(points, times, conflictTime);
 		}
 		return false;
 	}
 
+	void dynamicInspection::getRestTrajectorySamples(std::vector<Eigen::Vector3d>& points, std::vector<double>& times){
+		// the sample at trajectory time t is reached (t - trajTime_)/linearReparamFactor seconds later
+		double linearReparamFactor = this->bsplineTraj_->getLinearFactor();
+		for (double t=this->trajTime_; t<=this->trajectory_.getDuration(); t+=0.1){
+			points.push_back(this->trajectory_.at(t));
+			times.push_back((t - this->trajTime_)/linearReparamFactor);
+		}
+	}
+
+	const AutoFlight::clearanceState& dynamicInspection::updateClearance(){
+		AutoFlight::obstacleSnapshotPtr obstacles = this->getObstacleSnapshot();
+		this->obstaclePredictor_->update(obstacles);
+		std::vector<Eigen::Vector3d> points;
+		std::vector<double> times;
+		this->getRestTrajectorySamples(points, times);
+		return this->clearanceMonitor_->update(points, times);
+	}
+
 	double dynamicInspection::computeExecutionDistance(){
 		if (this->trajectoryReady_ and not this->replan_){
 			Eigen::Vector3d prevP, currP;
@@ -2284,25 +2430,47 @@ namespace AutoFlight{
 		return -1.0;		
 	}
 
-	bool dynamicInspection::replanForDynamicObstacle(){
-		ros::Time currTime = ros::Time::now();
-		std::vector<Eigen::Vector3d> obstaclesPos, obstaclesVel, obstaclesSize;
-		if (this->useFakeDetector_){
-			this->getDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
+	double dynamicInspection::getExecutionDistance(){
+		// computed once per replan check
+		if (not this->executionDistanceReady_){
+			this->executionDistance_ = this->computeExecutionDistance();
+			this->executionDistanceReady_ = true;
 		}
-		else{ 
-			this->map_->getDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
+		return this->executionDistance_;
+	}
+
+	bool dynamicInspection::replanForDynamicObstacle(const AutoFlight::clearanceState& clearance){
+		// no obstacle enters the trajectory corridor within the prediction horizon
+		if (clearance.level == AutoFlight::CLEARANCE_LEVEL::AMPLE){
+			this->lastDynamicObstacle_ = false;
+			return false;
 		}
 
+		ros::Time currTime = ros::Time::now();
+		double timePassed = (currTime - this->lastDynamicObstacleTime_).toSec();
 		bool replan = false;
-		bool hasDynamicObstacle = (obstaclesPos.size() != 0);
-		if (hasDynamicObstacle){
-			double timePassed = (currTime - this->lastDynamicObstacleTime_).toSec();
-			if (timePassed >= this->replanTimeForDynamicObstacle_){
+		if (not this->lastDynamicObstacle_){ // an obstacle starts to enter the corridor
+			replan = true;
+		}
+		else if (timePassed >= this->replanTimeForDynamicObstacle_){
+			// replan more often as the conflict gets closer or while the predicted clearance keeps dropping
+			if (clearance.dynamicTtc >= 0.0 and timePassed >= 0.5 * clearance.dynamicTtc){
+				replan = true;
+			}
+			else if (clearance.dynamicClearance < this->dynamicClearanceRef_ - this->dynamicClearanceDrop_){
 				replan = true;
-				this->lastDynamicObstacleTime_ = currTime;
 			}
 		}
+		this->lastDynamicObstacle_ = true;
+
+		if (replan){
+			this->lastDynamicObstacleTime_ = currTime;
+			this->dynamicClearanceRef_ = clearance.dynamicClearance;
+		}
+		else{
+			// the replanned trajectory can keep a larger clearance
+			this->dynamicClearanceRef_ = std::max(this->dynamicClearanceRef_, clearance.dynamicClearance);
+		}
 		return replan;
 	}
 
@@ -6,8 +6,16 @@
 #ifndef DYNAMIC_INSPECTION
 #define DYNAMIC_INSPECTION
 #include <autonomous_flight/px4/flightBase.h>
+#include <autonomous_flight/px4/pathTracker.h>
+#include <autonomous_flight/px4/obstacleSnapshot.h>
+#include <autonomous_flight/px4/obstaclePredictor.h>
+#include <autonomous_flight/px4/freeRegionUpdater.h>
+#include <autonomous_flight/px4/gridPlanner.h>
 #include <map_manager/dynamicMap.h>
 #include <onboard_detector/fakeDetector.h>
+#include <autonomous_flight/px4/obstacleScenario.h>
+#include <autonomous_flight/px4/clearanceMonitor.h>
+#include <autonomous_flight/px4/replanEngine.h>
 #include <global_planner/rrtOccMap.h>
 #include <trajectory_planner/polyTrajOccMap.h>
 #include <trajectory_planner/piecewiseLinearTraj.h>
@@ -38,9 +46,14 @@ namespace AutoFlight{
 		// Map
 		std::shared_ptr<mapManager::dynamicMap> map_;
 		std::shared_ptr<onboardDetector::fakeDetector> detector_;
+		std::shared_ptr<AutoFlight::obstacleScenario> obstacleScenario_;
+		std::shared_ptr<AutoFlight::obstaclePredictor> obstaclePredictor_;
+		std::shared_ptr<AutoFlight::clearanceMonitor> clearanceMonitor_;
+		std::shared_ptr<AutoFlight::replanEngine> replanEngine_;
 
 		// Planner
 		std::shared_ptr<globalPlanner::rrtOccMap<3>> rrtPlanner_;
+		std::shared_ptr<AutoFlight::gridPlanner> gridPlanner_;
 		std::shared_ptr<trajPlanner::polyTrajOccMap> polyTraj_;
 		std::shared_ptr<trajPlanner::pwlTraj> pwlTraj_;
 		std::shared_ptr<trajPlanner::bsplineTraj> bsplineTraj_;
@@ -53,6 +66,8 @@ namespace AutoFlight{
 
 		// inspection parameters
 		bool useFakeDetector_;
+		bool useObstacleScenario_;
+		bool useGridPlanner_;
 		double desiredVel_;
 		double desiredAcc_;
 		double desiredAngularVel_;
@@ -84,6 +99,8 @@ namespace AutoFlight{
 		bool inspectionConfirm_;
 		bool backwardNoTurn_;
 		double replanTimeForDynamicObstacle_;
+		double dynamicClearanceDrop_;
+		double obstacleDelay_;
 		// ***only used when we specify location***
 
 		// inspection data
@@ -93,6 +110,7 @@ namespace AutoFlight{
 		std::vector<double> wallRange_;
 		bool wallDetected_ = false;
 		nav_msgs::Path rrtPathMsg_;
+		AutoFlight::pathTracker globalPathTracker_; // progress along the global path
 		nav_msgs::Path polyTrajMsg_;
 		nav_msgs::Path pwlTrajMsg_;
 		nav_msgs::Path bsplineTrajMsg_;
@@ -103,7 +121,16 @@ namespace AutoFlight{
 		double trajTime_; // current trajectory time
 		trajPlanner::bspline trajectory_; // trajectory data for navigation
 		int countBsplineFailure_ = 0;
+		bool lastDynamicObstacle_ = false;
 		ros::Time lastDynamicObstacleTime_;
+		double dynamicClearanceRef_ = 0.0; // predicted clearance at the last dynamic obstacle replan
+		AutoFlight::obstacleSnapshotPtr obstacleSnapshot_; // obstacles of the current cycle
+		int numObstacleConversions_ = 0;
+		int numObstacleRequests_ = 0;
+		ros::Time obstacleStatTime_;
+		AutoFlight::freeRegionUpdater freeRegionUpdater_; // clears only the changed part of the obstacle boxes
+		double executionDistance_ = 0.0;
+		bool executionDistanceReady_ = false;
 
 	public:
 		dynamicInspection();
@@ -124,9 +151,12 @@ namespace AutoFlight{
 		void freeMapCB(const ros::TimerEvent&);
 
 		geometry_msgs::PoseStamped getForwardGoal();
-		nav_msgs::Path getRestGlobalPath();
+		void makeGlobalPlan(const geometry_msgs::Pose& start, const geometry_msgs::Pose& goal, nav_msgs::Path& path);
+		const nav_msgs::Path& getRestGlobalPath();
 		void getStartEndConditions(std::vector<Eigen::Vector3d>& startEndCondition);
 		void getDynamicObstacles(std::vector<Eigen::Vector3d>& obstaclesPos, std::vector<Eigen::Vector3d>& obstaclesVel, std::vector<Eigen::Vector3d>& obstaclesSize);
+		void updateObstacleSnapshot();
+		AutoFlight::obstacleSnapshotPtr getObstacleSnapshot();
 		void changeState(const FLIGHT_STATE& flightState);
 
 
@@ -170,8 +200,17 @@ namespace AutoFlight{
 		// navigation
 		bool hasCollision();
 		bool hasDynamicCollision();
+		void getRestTrajectorySamples(std::vector<Eigen::Vector3d>& points, std::vector<double>& times);
+		const AutoFlight::clearanceState& updateClearance();
+		void registerReplanTriggers();
+		bool wallTrigger();
+		bool collisionTrigger();
+		bool clearanceTrigger();
+		bool regularReplanTrigger();
+		bool dynamicObstacleTrigger();
 		double computeExecutionDistance();
-		bool replanForDynamicObstacle();
+		double getExecutionDistance();
+		bool replanForDynamicObstacle(const AutoFlight::clearanceState& clearance);
 		nav_msgs::Path getCurrentTraj(double dt);
 		
 		// utils
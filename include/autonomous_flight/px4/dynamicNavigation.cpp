@@ -10,8 +10,8 @@ namespace AutoFlight{
 		this->initParam();
 		this->initModules();
 		this->registerPub();
-		if (this->useFakeDetector_){
-			// free map callback
+		if (this->useFakeDetector_ and not this->useObstacleScenario_){
+			// free map callback (the scripted obstacles are not in the sensor data)
 			this->freeMapTimer_ = this->nh_.createTimer(ros::Duration(0.01), &dynamicNavigation::freeMapCB, this);
 		}
 		
@@ -28,6 +28,15 @@ namespace AutoFlight{
 			cout << "[AutoFlight]: Use fake detector is set to: " << this->useFakeDetector_ << "." << endl;
 		}
 
+		// scripted obstacles in place of the fake detector
+		if (not this->nh_.getParam("autonomous_flight/use_obstacle_scenario", this->useObstacleScenario_)){
+			this->useObstacleScenario_ = false;
+			cout << "[AutoFlight]: No use obstacle scenario param found. Use default: false." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Use obstacle scenario is set to: " << this->useObstacleScenario_ << "." << endl;
+		}
+
 
     	// use global planner or not	
 		if (not this->nh_.getParam("autonomous_flight/use_global_planner", this->useGlobalPlanner_)){
@@ -84,13 +93,47 @@ namespace AutoFlight{
 			cout << "[AutoFlight]: Desired angular velocity is set to: " << this->desiredAngularVel_ << "rad/s." << endl;
 		}	
 
-    	// replan time for dynamic obstacle
+		// minimum time between replans for the dynamic obstacles in the trajectory corridor
 		if (not this->nh_.getParam("autonomous_flight/replan_time_for_dynamic_obstacles", this->replanTimeForDynamicObstacle_)){
 			this->replanTimeForDynamicObstacle_ = 0.3;
 			cout << "[AutoFlight]: No dynamic obstacle replan time param found. Use default: 0.3s." << endl;
 		}
 		else{
 			cout << "[AutoFlight]: Dynamic obstacle replan time is set to: " << this->replanTimeForDynamicObstacle_ << "s." << endl;
+		}
+
+		// yaw planned along the trajectory: velocity, goal or waypoint
+		if (not this->nh_.getParam("autonomous_flight/yaw_mode", this->yawMode_)){
+			this->yawMode_ = "velocity";
+			cout << "[AutoFlight]: No yaw mode param found. Use default: velocity." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Yaw mode is set to: " << this->yawMode_ << "." << endl;
+		}
+		AutoFlight::YAW_MODE yawMode;
+		if (not AutoFlight::yawPlanner::getMode(this->yawMode_, yawMode)){
+			yawMode = AutoFlight::YAW_MODE::FACE_VELOCITY;
+			cout << "[AutoFlight]: Invalid yaw mode " << this->yawMode_ << ". Use velocity." << endl;
+		}
+		this->yawPlanner_.setMode(yawMode);
+		this->yawPlanner_.setMaxAngularVel(this->desiredAngularVel_);
+
+		// replan when the predicted clearance to the dynamic obstacles dropped by this distance
+		if (not this->nh_.getParam("autonomous_flight/dynamic_clearance_drop", this->dynamicClearanceDrop_)){
+			this->dynamicClearanceDrop_ = 0.1;
+			cout << "[AutoFlight]: No dynamic clearance drop param found. Use default: 0.1 m." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Dynamic clearance drop is set to: " << this->dynamicClearanceDrop_ << "m." << endl;
+		}
+
+		// delay from the obstacle measurement to its arrival
+		if (not this->nh_.getParam("autonomous_flight/obstacle_measurement_delay", this->obstacleDelay_)){
+			this->obstacleDelay_ = 0.05;
+			cout << "[AutoFlight]: No obstacle measurement delay param found. Use default: 0.05s." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Obstacle measurement delay is set to: " << this->obstacleDelay_ << "s." << endl;
 		}	
 
     	// trajectory data save path   	
@@ -101,21 +144,100 @@ namespace AutoFlight{
 		else{
 			cout << "[AutoFlight]: Trajectory info save path is set to: " << this->trajSavePath_ << "." << endl;
 		}			
+
+		// global planner type
+		if (not this->nh_.getParam("grid_planner/use_grid_planner", this->useGridPlanner_)){
+			this->useGridPlanner_ = false;
+			cout << "[AutoFlight]: No use grid planner param found. Use default: false (RRT)." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Use grid planner is set to: " << this->useGridPlanner_ << "." << endl;
+		}
+		// goal snapping radius
+		if (not this->nh_.getParam("autonomous_flight/goal_snap_radius", this->goalSnapRadius_)){
+			this->goalSnapRadius_ = 1.0;
+			cout << "[AutoFlight]: No goal snap radius param found. Use default: 1.0 m." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Goal snap radius is set to: " << this->goalSnapRadius_ << "m." << endl;
+		}
+
+		// motion primitive fallback
+		if (not this->nh_.getParam("autonomous_flight/use_motion_primitive_fallback", this->useMotionPrimitive_)){
+			this->useMotionPrimitive_ = true;
+			cout << "[AutoFlight]: No use motion primitive fallback param found. Use default: true." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Use motion primitive fallback is set to: " << this->useMotionPrimitive_ << "." << endl;
+		}
+
+		// motion primitive library file
+		if (not this->nh_.getParam("autonomous_flight/motion_primitive_file", this->motionPrimitiveFile_)){
+			this->motionPrimitiveFile_ = "No";
+			cout << "[AutoFlight]: No motion primitive file param found. Generate the library at startup." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Motion primitive file is set to: " << this->motionPrimitiveFile_ << "." << endl;
+		}
 	}
 
 	void dynamicNavigation::initModules(){
 		// initialize map
 		if (this->useFakeDetector_){
-			// initialize fake detector
-			this->detector_.reset(new onboardDetector::fakeDetector (this->nh_));	
+			// initialize fake detector (or the scripted obstacles in place of it)
+			if (this->useObstacleScenario_){
+				this->obstacleScenario_.reset(new AutoFlight::obstacleScenario (this->nh_));
+			}
+			else{
+				this->detector_.reset(new onboardDetector::fakeDetector (this->nh_));
+			}
 			this->map_.reset(new mapManager::dynamicMap (this->nh_, false));
 		}
 		else{
 			this->map_.reset(new mapManager::dynamicMap (this->nh_));
 		}
-		// initialize rrt planner
-		this->rrtPlanner_.reset(new globalPlanner::rrtOccMap<3> (this->nh_));
-		this->rrtPlanner_->setMap(this->map_);
+
+		// initialize obstacle predictor
+		this->obstaclePredictor_.reset(new AutoFlight::obstaclePredictor (this->nh_));
+		this->obstaclePredictor_->setRobotSize(this->map_->getRobotSize());
+
+		// initialize clearance monitor
+		this->clearanceMonitor_.reset(new AutoFlight::clearanceMonitor (this->nh_));
+		this->clearanceMonitor_->setMap(this->map_);
+		this->clearanceMonitor_->setPredictor(this->obstaclePredictor_);
+
+		// initialize replan engine
+		this->replanEngine_.reset(new AutoFlight::replanEngine (this->nh_));
+		this->registerReplanTriggers();
+
+		// initialize free region updater
+		this->freeRegionUpdater_.setMap(this->map_);
+
+		// initialize global planner
+		if (this->useGridPlanner_){
+			this->gridPlanner_.reset(new AutoFlight::gridPlanner (this->nh_));
+			this->gridPlanner_->setMap(this->map_);
+		}
+		else{
+			this->rrtPlanner_.reset(new globalPlanner::rrtOccMap<3> (this->nh_));
+			this->rrtPlanner_->setMap(this->map_);
+		}
+
+		// initialize goal snapper
+		this->goalSnapper_.setMap(this->map_);
+		this->goalSnapper_.setRadius(this->goalSnapRadius_);
+
+		// initialize motion primitive library
+		if (this->useMotionPrimitive_){
+			this->mpLibrary_.setMap(this->map_);
+			if (this->motionPrimitiveFile_ == "No" or not this->mpLibrary_.load(this->motionPrimitiveFile_, this->desiredVel_, this->desiredAcc_)){
+				if (this->motionPrimitiveFile_ != "No"){
+					cout << "[AutoFlight]: Fail to load motion primitive file. Generate the library at startup." << endl;
+				}
+				this->mpLibrary_.generate(this->desiredVel_, this->desiredAcc_, 0.25, 7, 1.0, 0.05);
+			}
+			cout << "[AutoFlight]: Motion primitive library has " << this->mpLibrary_.getNumPrimitives() << " primitives." << endl;
+		}
 
 		// initialize polynomial trajectory planner
 		this->polyTraj_.reset(new trajPlanner::polyTrajOccMap (this->nh_));
@@ -159,13 +281,10 @@ namespace AutoFlight{
 		if (not this->firstGoal_) return;
 
 		if (this->replan_){
-			std::vector<Eigen::Vector3d> obstaclesPos, obstaclesVel, obstaclesSize;
-			if (this->useFakeDetector_){
-				this->getDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
-			}
-			else{ 
-				this->map_->getDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
-			}
+			AutoFlight::obstacleSnapshotPtr obstacles = this->getObstacleSnapshot();
+			const std::vector<Eigen::Vector3d>& obstaclesPos = obstacles->pos;
+			const std::vector<Eigen::Vector3d>& obstaclesVel = obstacles->vel;
+			const std::vector<Eigen::Vector3d>& obstaclesSize = obstacles->size;
 			// get start and end condition for trajectory generation (the end condition is the final zero condition)
 			std::vector<Eigen::Vector3d> startEndConditions;
 			this->getStartEndConditions(startEndConditions); 
@@ -175,12 +294,11 @@ namespace AutoFlight{
 			double initTs = this->bsplineTraj_->getInitTs();
 			if (this->useGlobalPlanner_){
 				if (this->needGlobalPlan_){
-					this->rrtPlanner_->updateStart(this->odom_.pose.pose);
-					this->rrtPlanner_->updateGoal(this->goal_.pose);
 					nav_msgs::Path rrtPathMsgTemp;
-					this->rrtPlanner_->makePlan(rrtPathMsgTemp);
+					this->makeGlobalPlan(this->odom_.pose.pose, this->goal_.pose, rrtPathMsgTemp);
 					if (rrtPathMsgTemp.poses.size() >= 2){
 						this->rrtPathMsg_ = rrtPathMsgTemp;
+						this->globalPathTracker_.setPath(this->rrtPathMsg_);
 						this->globalPlanReady_ = true;
 					}
 					this->needGlobalPlan_ = false;
@@ -189,7 +307,7 @@ namespace AutoFlight{
 				else{
 					if (this->globalPlanReady_){
 						// get rest of global plan
-						nav_msgs::Path restPath = this->getRestGlobalPath();
+						const nav_msgs::Path& restPath = this->getRestGlobalPath();
 						this->polyTraj_->updatePath(restPath, startEndConditions);
 						this->polyTraj_->makePlan(this->polyTrajMsg_); // no corridor constraint		
 						nav_msgs::Path adjustedInputPolyTraj;
@@ -345,16 +463,24 @@ namespace AutoFlight{
 			this->inputTrajMsg_ = inputTraj;
 			bool updateSuccess = this->bsplineTraj_->updatePath(inputTraj, startEndConditions);
 			if (obstaclesPos.size() != 0 and updateSuccess){
-				this->bsplineTraj_->updateDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
+				// only the obstacles near the input trajectory can affect the optimization
+				std::vector<Eigen::Vector3d> nearObstaclesPos, nearObstaclesVel, nearObstaclesSize;
+				this->obstaclePredictor_->update(obstacles);
+				this->obstaclePredictor_->getObstaclesNearPath(inputTraj, nearObstaclesPos, nearObstaclesVel, nearObstaclesSize);
+				this->bsplineTraj_->updateDynamicObstacles(nearObstaclesPos, nearObstaclesVel, nearObstaclesSize);
 			}
 			if (updateSuccess){
 				nav_msgs::Path bsplineTrajMsgTemp;
 				bool planSuccess = this->bsplineTraj_->makePlan(bsplineTrajMsgTemp);
 				if (planSuccess){
+					this->fallbackActive_ = false;
 					this->bsplineTrajMsg_ = bsplineTrajMsgTemp;
 					this->trajStartTime_ = ros::Time::now();
 					this->trajTime_ = 0.0; // reset trajectory time
 					this->trajectory_ = this->bsplineTraj_->getTrajectory();
+					if (this->useYawControl_ and not this->noYawTurning_){
+						this->planYaw();
+					}
 
 					// optimize time
 					// ros::Time timeOptStartTime = ros::Time::now();
@@ -371,14 +497,25 @@ namespace AutoFlight{
 					// if the current trajectory/or new goal point is assigned is not valid, then just stop
 					if (this->hasCollision()){
 						this->trajectoryReady_ = false;
-						this->stop();
-						cout << "[AutoFlight]: Stop!!! Trajectory generation fails." << endl;
-						this->replan_ = false;
+						if (this->startFallbackPrimitive(obstaclesPos, obstaclesVel, obstaclesSize)){
+							cout << "[AutoFlight]: Trajectory generation fails. Use motion primitive and replan." << endl;
+							this->replan_ = true;
+						}
+						else{
+							this->stop();
+							cout << "[AutoFlight]: Stop!!! Trajectory generation fails." << endl;
+							this->replan_ = false;
+						}
 					}
 					else if (this->hasDynamicCollision()){
 						this->trajectoryReady_ = false;
-						this->stop();
-						cout << "[AutoFlight]: Stop!!! Trajectory generation fails. Replan for dynamic obstacles." << endl;
+						if (this->startFallbackPrimitive(obstaclesPos, obstaclesVel, obstaclesSize)){
+							cout << "[AutoFlight]: Trajectory generation fails. Use motion primitive and replan for dynamic obstacles." << endl;
+						}
+						else{
+							this->stop();
+							cout << "[AutoFlight]: Stop!!! Trajectory generation fails. Replan for dynamic obstacles." << endl;
+						}
 						this->replan_ = true;
 					}
 					else{
@@ -405,61 +542,126 @@ namespace AutoFlight{
 	void dynamicNavigation::replanCheckCB(const ros::TimerEvent&){
 		/*
 			Replan if
-			1. collision detected
-			2. new goal point assigned
+			1. new goal point assigned
+			2. collision detected (static or predicted dynamic)
 			3. fixed distance
+			4. dynamic obstacles near the trajectory
+			The triggers are run by priority within the time budget of the replan engine
 		*/
-		if (this->goalReceived_){
-			this->replan_ = false;
-			this->trajectoryReady_ = false;
-			if (not this->noYawTurning_ and not this->useYawControl_){
-				double yaw = atan2(this->goal_.pose.position.y - this->odom_.pose.pose.position.y, this->goal_.pose.position.x - this->odom_.pose.pose.position.x);
-				this->facingYaw_ = yaw;
-				this->moveToOrientation(yaw, this->desiredAngularVel_);
-			}
-			this->firstTimeSave_ = true;
+		this->updateObstacleSnapshot(); // obstacles shared by all checks of this cycle
+		this->executionDistanceReady_ = false;
+		this->replanEngine_->run();
+	}
+
+	void dynamicNavigation::registerReplanTriggers(){
+		// name, priority, estimated cost (s), minimum period (s), urgent (ignores the budget and the hold time)
+		this->replanEngine_->addTrigger("new_goal", 0, 1e-6, 0.0, true, [this](){return this->newGoalTrigger();});
+		this->replanEngine_->addTrigger("collision", 1, 5e-5, 0.0, true, [this](){return this->collisionTrigger();});
+		this->replanEngine_->addTrigger("clearance", 2, 5e-4, 0.1, false, [this](){return this->clearanceTrigger();});
+		this->replanEngine_->addTrigger("regular", 3, 5e-5, 0.05, false, [this](){return this->regularReplanTrigger();});
+		this->replanEngine_->addTrigger("dynamic_obstacle", 4, 5e-5, 0.05, false, [this](){return this->dynamicObstacleTrigger();});
+	}
+
+	bool dynamicNavigation::newGoalTrigger(){
+		if (not this->goalReceived_){
+			return false;
+		}
+
+		this->snapGoal();
+		this->replan_ = false;
+		this->trajectoryReady_ = false;
+		this->fallbackActive_ = false;
+		if (not this->noYawTurning_ and not this->useYawControl_){
+			double yaw = atan2(this->goal_.pose.position.y - this->odom_.pose.pose.position.y, this->goal_.pose.position.x - this->odom_.pose.pose.position.x);
+			this->facingYaw_ = yaw;
+			this->moveToOrientation(yaw, this->desiredAngularVel_);
+		}
+		this->firstTimeSave_ = true;
+		this->replan_ = true;
+		this->goalReceived_ = false;
+		if (this->useGlobalPlanner_){
+			cout << "[AutoFlight]: Start global planning." << endl;
+			this->needGlobalPlan_ = true;
+			this->globalPlanReady_ = false;
+		}
+
+		cout << "[AutoFlight]: Replan for new goal position." << endl; 
+		return true;
+	}
+
+	bool dynamicNavigation::collisionTrigger(){
+		if (not this->trajectoryReady_){
+			return false;
+		}
+
+		// the rest of the trajectory hits an inflated occupied voxel. The clearance metrics are left to the clearance trigger
+		std::vector<Eigen::Vector3d> points;
+		std::vector<double> times;
+		this->getRestTrajectorySamples(points, times);
+		if (this->clearanceMonitor_->getStaticTtc(points, times) >= 0.0){
 			this->replan_ = true;
-			this->goalReceived_ = false;
-			if (this->useGlobalPlanner_){
-				cout << "[AutoFlight]: Start global planning." << endl;
-				this->needGlobalPlan_ = true;
-				this->globalPlanReady_ = false;
-			}
+			cout << "[AutoFlight]: Replan for collision." << endl;
+			return true;
+		}
+		return false;
+	}
 
-			cout << "[AutoFlight]: Replan for new goal position." << endl; 
-			return;
+	bool dynamicNavigation::clearanceTrigger(){
+		if (not this->trajectoryReady_){
+			return false;
 		}
 
-		if (this->trajectoryReady_){
-			if (this->hasCollision()){ // if trajectory not ready, do not replan
-				this->replan_ = true;
-				cout << "[AutoFlight]: Replan for collision." << endl;
-				return;
-			}
+		// time to collision and clearance of the rest of the trajectory
+		const AutoFlight::clearanceState& clearance = this->updateClearance();
+		if (clearance.staticTtc >= 0.0){
+			this->replan_ = true;
+			cout << "[AutoFlight]: Replan for collision." << endl;
+			return true;
+		}
 
-			// replan for dynamic obstacles
-			if (this->computeExecutionDistance() >= 0.3 and this->hasDynamicCollision()){
-			// if (this->hasDynamicObstacle()){
-				this->replan_ = true;
-				cout << "[AutoFlight]: Replan for dynamic obstacles." << endl;
-				return;
-			}
+		// replan for dynamic obstacles. Conflicts close in time do not wait for the execution distance
+		if (clearance.level == AutoFlight::CLEARANCE_LEVEL::URGENT or (clearance.level == AutoFlight::CLEARANCE_LEVEL::CONFLICT and this->getExecutionDistance() >= 0.3)){
+			this->replan_ = true;
+			cout << "[AutoFlight]: Replan for dynamic obstacles. Time to collision: " << clearance.dynamicTtc << "s." << endl;
+			return true;
+		}
+		return false;
+	}
 
-			if (this->computeExecutionDistance() >= 1.5 and AutoFlight::getPoseDistance(this->odom_.pose.pose, this->goal_.pose) >= 3){
-				this->replan_ = true;
-				cout << "[AutoFlight]: Regular replan." << endl;
-				return;
-			}
+	bool dynamicNavigation::regularReplanTrigger(){
+		if (not this->trajectoryReady_){
+			return false;
+		}
 
-			if (this->computeExecutionDistance() >= 0.3 and this->replanForDynamicObstacle()){
-				this->replan_ = true;
-				cout << "[AutoFlight]: Regular replan for dynamic obstacles." << endl;
-				return;
-			}
+		if (this->getExecutionDistance() >= 1.5 and AutoFlight::getPoseDistance(this->odom_.pose.pose, this->goal_.pose) >= 3){
+			this->replan_ = true;
+			cout << "[AutoFlight]: Regular replan." << endl;
+			return true;
+		}
+		return false;
+	}
+
+	bool dynamicNavigation::dynamicObstacleTrigger(){
+		if (not this->trajectoryReady_){
+			return false;
+		}
+
+		// only the obstacles predicted to enter the trajectory corridor cause a replan
+		const AutoFlight::clearanceState& clearance = this->clearanceMonitor_->getState();
+		if (this->getExecutionDistance() >= 0.3 and this->replanForDynamicObstacle(clearance)){
+			this->replan_ = true;
+			cout << "[AutoFlight]: Replan for dynamic obstacles in the trajectory corridor." << endl;
+			return true;
 		}
+		return false;
 	}
 
 	void dynamicNavigation::trajExeCB(const ros::TimerEvent&){
+		if (this->fallbackActive_ and not this->trajectoryReady_){
+			this->executeFallbackPrimitive();
+			return;
+		}
+
 		if (this->trajectoryReady_){
 			ros::Time currTime = ros::Time::now();
 			double realTime = (currTime - this->trajStartTime_).toSec();
@@ -493,8 +695,9 @@ namespace AutoFlight{
 					target.yaw = AutoFlight::rpy_from_quaternion(this->odom_.pose.pose.orientation);
 				}
 				else{
-					target.yaw = atan2(vel(1), vel(0));
-				}				
+					target.yaw = this->yawPlanner_.at(this->trajTime_);
+				}
+				this->targetYaw_ = target.yaw;				
 				target.position.x = pos(0);
 				target.position.y = pos(1);
 				target.position.z = pos(2);
@@ -509,6 +712,21 @@ namespace AutoFlight{
 		}
 	}
 
+	void dynamicNavigation::planYaw(){
+		// continue from the commanded yaw in flight
+		double startYaw = this->trajectoryReady_ ? this->targetYaw_ : AutoFlight::rpy_from_quaternion(this->odom_.pose.pose.orientation);
+		nav_msgs::Path waypoints;
+		if (this->useGlobalPlanner_ and this->globalPlanReady_){
+			waypoints = this->getRestGlobalPath();
+		}
+		else{
+			geometry_msgs::PoseStamped pStart;
+			pStart.pose = this->odom_.pose.pose;
+			waypoints.poses = {pStart, this->goal_};
+		}
+		this->yawPlanner_.plan(this->trajectory_, this->bsplineTraj_->getLinearFactor(), startYaw, waypoints);
+	}
+
 	void dynamicNavigation::visCB(const ros::TimerEvent&){
 		if (this->rrtPathMsg_.poses.size() != 0){
 			this->rrtPathPub_.publish(this->rrtPathMsg_);
@@ -539,8 +757,7 @@ namespace AutoFlight{
 				freeRegions.push_back(std::make_pair(lowerBound, upperBound));
 			}
 		}
-		this->map_->updateFreeRegions(freeRegions);
-		this->map_->freeRegions(freeRegions);
+		this->freeRegionUpdater_.update(freeRegions);
 	}
 
 	void dynamicNavigation::run(){
@@ -591,33 +808,35 @@ namespace AutoFlight{
 
 	bool dynamicNavigation::hasDynamicCollision(){
 		if (this->trajectoryReady_){
-			std::vector<Eigen::Vector3d> obstaclesPos, obstaclesVel, obstaclesSize;
-			if (this->useFakeDetector_){
-				this->getDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
-			}
-			else{ 
-				this->map_->getDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
-			}
-
-			for (double t=this->trajTime_; t<=this->trajectory_.getDuration(); t+=0.1){
-				Eigen::Vector3d p = this->trajectory_.at(t);
-				
-				for (size_t i=0; i<obstaclesPos.size(); ++i){
-					Eigen::Vector3d ob = obstaclesPos[i];
-					Eigen::Vector3d size = obstaclesSize[i];
-					Eigen::Vector3d lowerBound = ob - size/2;
-					Eigen::Vector3d upperBound = ob + size/2;
-					if (p(0) >= lowerBound(0) and p(0) <= upperBound(0) and
-						p(1) >= lowerBound(1) and p(1) <= upperBound(1) and
-						p(2) >= lowerBound(2) and p(2) <= upperBound(2)){
-						return true;
-					}					
-				}
-			}
+			AutoFlight::obstacleSnapshotPtr obstacles = this->getObstacleSnapshot();
+			this->obstaclePredictor_->update(obstacles);
+			std::vector<Eigen::Vector3d> points;
+			std::vector<double> times;
+			this->getRestTrajectorySamples(points, times);
+			double conflictTime;
+			return this->obstaclePredictor_->getEarliestConflict(points, times, conflictTime);
 		}
 		return false;
 	}
 
+	void dynamicNavigation::getRestTrajectorySamples(std::vector<Eigen::Vector3d>& points, std::vector<double>& times){
+		// the sample at trajectory time t is reached (t - trajTime_)/linearReparamFactor seconds later
+		double linearReparamFactor = this->bsplineTraj_->getLinearFactor();
+		for (double t=this->trajTime_; t<=this->trajectory_.getDuration(); t+=0.1){
+			points.push_back(this->trajectory_.at(t));
+			times.push_back((t - this->trajTime_)/linearReparamFactor);
+		}
+	}
+
+	const AutoFlight::clearanceState& dynamicNavigation::updateClearance(){
+		AutoFlight::obstacleSnapshotPtr obstacles = this->getObstacleSnapshot();
+		this->obstaclePredictor_->update(obstacles);
+		std::vector<Eigen::Vector3d> points;
+		std::vector<double> times;
+		this->getRestTrajectorySamples(points, times);
+		return this->clearanceMonitor_->update(points, times);
+	}
+
 	double dynamicNavigation::computeExecutionDistance(){
 		if (this->trajectoryReady_ and not this->replan_){
 			Eigen::Vector3d prevP, currP;
@@ -638,30 +857,47 @@ namespace AutoFlight{
 		return -1.0;
 	}
 
-	bool dynamicNavigation::replanForDynamicObstacle(){
-		ros::Time currTime = ros::Time::now();
-		std::vector<Eigen::Vector3d> obstaclesPos, obstaclesVel, obstaclesSize;
-		if (this->useFakeDetector_){
-			this->getDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
+	double dynamicNavigation::getExecutionDistance(){
+		// computed once per replan check
+		if (not this->executionDistanceReady_){
+			this->executionDistance_ = this->computeExecutionDistance();
+			this->executionDistanceReady_ = true;
 		}
-		else{ 
-			this->map_->getDynamicObstacles(obstaclesPos, obstaclesVel, obstaclesSize);
+		return this->executionDistance_;
+	}
+
+	bool dynamicNavigation::replanForDynamicObstacle(const AutoFlight::clearanceState& clearance){
+		// no obstacle enters the trajectory corridor within the prediction horizon
+		if (clearance.level == AutoFlight::CLEARANCE_LEVEL::AMPLE){
+			this->lastDynamicObstacle_ = false;
+			return false;
 		}
 
+		ros::Time currTime = ros::Time::now();
+		double timePassed = (currTime - this->lastDynamicObstacleTime_).toSec();
 		bool replan = false;
-		bool hasDynamicObstacle = (obstaclesPos.size() != 0);
-		if (hasDynamicObstacle){
-			double timePassed = (currTime - this->lastDynamicObstacleTime_).toSec();
-			if (this->lastDynamicObstacle_ == false or timePassed >= this->replanTimeForDynamicObstacle_){
+		if (not this->lastDynamicObstacle_){ // an obstacle starts to enter the corridor
+			replan = true;
+		}
+		else if (timePassed >= this->replanTimeForDynamicObstacle_){
+			// replan more often as the conflict gets closer or while the predicted clearance keeps dropping
+			if (clearance.dynamicTtc >= 0.0 and timePassed >= 0.5 * clearance.dynamicTtc){
+				replan = true;
+			}
+			else if (clearance.dynamicClearance < this->dynamicClearanceRef_ - this->dynamicClearanceDrop_){
 				replan = true;
-				this->lastDynamicObstacleTime_ = currTime;
 			}
-			this->lastDynamicObstacle_ = true;
+		}
+		this->lastDynamicObstacle_ = true;
+
+		if (replan){
+			this->lastDynamicObstacleTime_ = currTime;
+			this->dynamicClearanceRef_ = clearance.dynamicClearance;
 		}
 		else{
-			this->lastDynamicObstacle_ = false;
+			// the replanned trajectory can keep a larger clearance
+			this->dynamicClearanceRef_ = std::max(this->dynamicClearanceRef_, clearance.dynamicClearance);
 		}
-
 		return replan;
 	}
 
@@ -688,42 +924,121 @@ namespace AutoFlight{
 	}
 
 
-	nav_msgs::Path dynamicNavigation::getRestGlobalPath(){
-		nav_msgs::Path currPath;
+	bool dynamicNavigation::startFallbackPrimitive(const std::vector<Eigen::Vector3d>& obstaclesPos, const std::vector<Eigen::Vector3d>& obstaclesVel, const std::vector<Eigen::Vector3d>& obstaclesSize){
+		if (not this->useMotionPrimitive_ or not this->mpLibrary_.isInit()){
+			return false;
+		}
+		Eigen::Vector3d goal (this->goal_.pose.position.x, this->goal_.pose.position.y, this->goal_.pose.position.z);
+		double yaw = AutoFlight::rpy_from_quaternion(this->odom_.pose.pose.orientation);
+		ros::Time startTime = ros::Time::now();
+		int speedBin, idx;
+		bool success = this->mpLibrary_.query(this->currPos_, this->currVel_, yaw, goal, obstaclesPos, obstaclesVel, obstaclesSize, speedBin, idx);
+		double queryTime = (ros::Time::now() - startTime).toSec();
+		if (not success){
+			cout << "[AutoFlight]: No safe motion primitive found." << endl;
+			return false;
+		}
 
-		int nextIdx = this->rrtPathMsg_.poses.size()-1;
-		Eigen::Vector3d pCurr (this->odom_.pose.pose.position.x, this->odom_.pose.pose.position.y, this->odom_.pose.pose.position.z);
-		double minDist = std::numeric_limits<double>::infinity();
-		for (size_t i=0; i<this->rrtPathMsg_.poses.size()-1; ++i){
-			geometry_msgs::PoseStamped ps = this->rrtPathMsg_.poses[i];
-			Eigen::Vector3d pEig (ps.pose.position.x, ps.pose.position.y, ps.pose.position.z);
-			Eigen::Vector3d pDiff = pCurr - pEig;
-
-			geometry_msgs::PoseStamped psNext = this->rrtPathMsg_.poses[i+1];
-			Eigen::Vector3d pEigNext (psNext.pose.position.x, psNext.pose.position.y, psNext.pose.position.z);
-			Eigen::Vector3d diffToNext = pEigNext - pEig;
-			double dist = (pEig - pCurr).norm();
-			if (trajPlanner::angleBetweenVectors(diffToNext, pDiff) > PI_const*3.0/4.0){
-				if (dist < minDist){
-					nextIdx = i;
-					minDist = dist;
-				}
-			}
+		this->fallbackSpeedBin_ = speedBin;
+		this->fallbackIdx_ = idx;
+		this->fallbackStartPos_ = this->currPos_;
+		double speed = this->currVel_.head<2>().norm();
+		this->fallbackSpeed_ = this->mpLibrary_.getBinSpeed(speedBin); // the primitive is flown as it was checked
+		this->fallbackHeading_ = (speed > 0.1) ? atan2(this->currVel_(1), this->currVel_(0)) : yaw;
+		this->fallbackYaw_ = yaw;
+
+		// the primitive starts at the bin speed. The difference to the current velocity is removed with the max acceleration
+		Eigen::Vector2d startVel (cos(this->fallbackHeading_), sin(this->fallbackHeading_));
+		this->fallbackVelOffset_ = this->currVel_.head<2>() - startVel * this->fallbackSpeed_;
+		this->fallbackBlendTime_ = this->fallbackVelOffset_.norm()/this->desiredAcc_;
+		this->fallbackStartTime_ = ros::Time::now();
+		this->fallbackActive_ = true;
+		cout << "[AutoFlight]: Motion primitive found in " << queryTime * 1e6 << "us." << endl;
+		return true;
+	}
+
+	void dynamicNavigation::executeFallbackPrimitive(){
+		const AutoFlight::motionPrimitive& prim = this->mpLibrary_.getPrimitive(this->fallbackSpeedBin_, this->fallbackIdx_);
+		double t = (ros::Time::now() - this->fallbackStartTime_).toSec();
+		Eigen::Vector2d pos, vel, acc;
+		this->mpLibrary_.getState(prim, this->fallbackSpeed_, t, pos, vel, acc);
+		Eigen::Matrix2d rot;
+		rot << cos(this->fallbackHeading_), -sin(this->fallbackHeading_), sin(this->fallbackHeading_), cos(this->fallbackHeading_);
+		pos = this->fallbackStartPos_.head<2>() + rot * pos;
+		vel = rot * vel;
+		acc = rot * acc;
+
+		// blend from the current velocity (off the checked samples by at most |offset|^2/(2 max acc))
+		if (t < this->fallbackBlendTime_){
+			double ratio = 1.0 - t/this->fallbackBlendTime_;
+			pos += this->fallbackVelOffset_ * (t - 0.5 * t * t/this->fallbackBlendTime_);
+			vel += this->fallbackVelOffset_ * ratio;
+			acc -= this->fallbackVelOffset_/this->fallbackBlendTime_;
+		}
+		else{
+			pos += this->fallbackVelOffset_ * 0.5 * this->fallbackBlendTime_;
 		}
 
+		tracking_controller::Target target;
+		target.position.x = pos(0);
+		target.position.y = pos(1);
+		target.position.z = this->fallbackStartPos_(2);
+		target.velocity.x = vel(0);
+		target.velocity.y = vel(1);
+		target.velocity.z = 0.0;
+		target.acceleration.x = acc(0);
+		target.acceleration.y = acc(1);
+		target.acceleration.z = 0.0;
+		target.yaw = this->fallbackYaw_;
+		this->updateTargetWithState(target);
+	}
 
-		geometry_msgs::PoseStamped psCurr;
-		psCurr.pose = this->odom_.pose.pose;
-		currPath.poses.push_back(psCurr);
-		for (size_t i=nextIdx; i<this->rrtPathMsg_.poses.size(); ++i){
-			currPath.poses.push_back(this->rrtPathMsg_.poses[i]);
+	void dynamicNavigation::snapGoal(){
+		Eigen::Vector3d goal (this->goal_.pose.position.x, this->goal_.pose.position.y, this->goal_.pose.position.z);
+		Eigen::Vector3d currPos (this->odom_.pose.pose.position.x, this->odom_.pose.pose.position.y, this->odom_.pose.pose.position.z);
+		Eigen::Vector3d goalSnapped;
+		ros::Time startTime = ros::Time::now();
+		bool success = this->goalSnapper_.snap(currPos, goal, goalSnapped);
+		double snapTime = (ros::Time::now() - startTime).toSec();
+		if (not success){
+			cout << "[AutoFlight]: No free goal connected to the robot found within " << this->goalSnapRadius_ << "m. Use the original goal." << endl;
+			return;
+		}
+		if ((goalSnapped - goal).norm() > 0){
+			this->goal_.pose.position.x = goalSnapped(0);
+			this->goal_.pose.position.y = goalSnapped(1);
+			this->goal_.pose.position.z = goalSnapped(2);
+			cout << "[AutoFlight]: Goal snapped by " << (goalSnapped - goal).norm() << "m to a free position in " << snapTime * 1000.0 << "ms." << endl;
+		}
+	}
+
+	void dynamicNavigation::makeGlobalPlan(const geometry_msgs::Pose& start, const geometry_msgs::Pose& goal, nav_msgs::Path& path){
+		if (this->useGridPlanner_){
+			this->gridPlanner_->updateStart(start);
+			this->gridPlanner_->updateGoal(goal);
+			this->gridPlanner_->makePlan(path);
+		}
+		else{
+			this->rrtPlanner_->updateStart(start);
+			this->rrtPlanner_->updateGoal(goal);
+			this->rrtPlanner_->makePlan(path);
 		}
-		return currPath;		
+	}
+
+	const nav_msgs::Path& dynamicNavigation::getRestGlobalPath(){
+		Eigen::Vector3d pCurr (this->odom_.pose.pose.position.x, this->odom_.pose.pose.position.y, this->odom_.pose.pose.position.z);
+		this->globalPathTracker_.update(pCurr);
+		return this->globalPathTracker_.getRestPath(this->odom_.pose.pose);
 	}
 
 	void dynamicNavigation::getDynamicObstacles(std::vector<Eigen::Vector3d>& obstaclesPos, std::vector<Eigen::Vector3d>& obstaclesVel, std::vector<Eigen::Vector3d>& obstaclesSize){
 		std::vector<onboardDetector::box3D> obstacles;
-		this->detector_->getObstaclesInSensorRange(PI_const, obstacles);
+		if (this->useObstacleScenario_){
+			this->obstacleScenario_->getObstaclesInSensorRange(PI_const, obstacles);
+		}
+		else{
+			this->detector_->getObstaclesInSensorRange(PI_const, obstacles);
+		}
 		for (onboardDetector::box3D ob : obstacles){
 			Eigen::Vector3d pos (ob.x, ob.y, ob.z);
 			Eigen::Vector3d vel (ob.Vx, ob.Vy, 0.0);
@@ -733,4 +1048,42 @@ namespace AutoFlight{
 			obstaclesSize.push_back(size);
 		}
 	}
+
+	void dynamicNavigation::updateObstacleSnapshot(){
+		std::shared_ptr<AutoFlight::obstacleSnapshot> snapshot (new AutoFlight::obstacleSnapshot);
+		if (this->useFakeDetector_){
+			this->getDynamicObstacles(snapshot->pos, snapshot->vel, snapshot->size);
+		}
+		else{
+			this->map_->getDynamicObstacles(snapshot->pos, snapshot->vel, snapshot->size);
+		}
+		snapshot->stamp = ros::Time::now() - ros::Duration (this->obstacleDelay_); // measurement time
+		++this->numObstacleConversions_;
+
+		// the previous snapshot (and its measurement time) is kept if the obstacles do not change
+		if (this->obstacleSnapshot_ == NULL or not this->obstacleSnapshot_->hasSameObstacles(*snapshot)){
+			snapshot->seq = (this->obstacleSnapshot_ == NULL) ? 0 : this->obstacleSnapshot_->seq + 1;
+			this->obstacleSnapshot_ = snapshot;
+		}
+
+		// each request used to be one conversion
+		ros::Time currTime = ros::Time::now();
+		double statTime = (currTime - this->obstacleStatTime_).toSec();
+		if (statTime >= 10.0){
+			if (not this->obstacleStatTime_.isZero()){
+				cout << "[AutoFlight]: Dynamic obstacle conversions: " << this->numObstacleConversions_/statTime << "/s for " << this->numObstacleRequests_/statTime << " requests/s." << endl;
+			}
+			this->numObstacleConversions_ = 0;
+			this->numObstacleRequests_ = 0;
+			this->obstacleStatTime_ = currTime;
+		}
+	}
+
+	AutoFlight::obstacleSnapshotPtr dynamicNavigation::getObstacleSnapshot(){
+		if (this->obstacleSnapshot_ == NULL){
+			this->updateObstacleSnapshot();
+		}
+		++this->numObstacleRequests_;
+		return this->obstacleSnapshot_;
+	}
 }
\ No newline at end of file
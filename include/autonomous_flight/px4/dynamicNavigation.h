@@ -8,8 +8,19 @@
 #define AUTOFLIGHT_DYNAMIC_NAVIGATION_H
 
 #include <autonomous_flight/px4/flightBase.h>
+#include <autonomous_flight/px4/pathTracker.h>
+#include <autonomous_flight/px4/obstacleSnapshot.h>
+#include <autonomous_flight/px4/obstaclePredictor.h>
+#include <autonomous_flight/px4/freeRegionUpdater.h>
+#include <autonomous_flight/px4/gridPlanner.h>
+#include <autonomous_flight/px4/goalSnapper.h>
+#include <autonomous_flight/px4/motionPrimitiveLibrary.h>
 #include <map_manager/dynamicMap.h>
 #include <onboard_detector/fakeDetector.h>
+#include <autonomous_flight/px4/obstacleScenario.h>
+#include <autonomous_flight/px4/clearanceMonitor.h>
+#include <autonomous_flight/px4/replanEngine.h>
+#include <autonomous_flight/px4/yawPlanner.h>
 #include <global_planner/rrtOccMap.h>
 #include <trajectory_planner/polyTrajOccMap.h>
 #include <trajectory_planner/piecewiseLinearTraj.h>
@@ -20,7 +31,12 @@ namespace AutoFlight{
 	private:
 		std::shared_ptr<mapManager::dynamicMap> map_;
 		std::shared_ptr<onboardDetector::fakeDetector> detector_;
+		std::shared_ptr<AutoFlight::obstacleScenario> obstacleScenario_;
+		std::shared_ptr<AutoFlight::obstaclePredictor> obstaclePredictor_;
+		std::shared_ptr<AutoFlight::clearanceMonitor> clearanceMonitor_;
+		std::shared_ptr<AutoFlight::replanEngine> replanEngine_;
 		std::shared_ptr<globalPlanner::rrtOccMap<3>> rrtPlanner_;
+		std::shared_ptr<AutoFlight::gridPlanner> gridPlanner_;
 		std::shared_ptr<trajPlanner::polyTrajOccMap> polyTraj_;
 		std::shared_ptr<trajPlanner::pwlTraj> pwlTraj_;
 		std::shared_ptr<trajPlanner::bsplineTraj> bsplineTraj_;
@@ -39,13 +55,21 @@ namespace AutoFlight{
 
 		// parameters
 		bool useFakeDetector_;
+		bool useObstacleScenario_;
 		bool useGlobalPlanner_;
+		bool useGridPlanner_;
+		double goalSnapRadius_;
+		bool useMotionPrimitive_;
+		std::string motionPrimitiveFile_;
 		bool noYawTurning_;
 		bool useYawControl_;
+		std::string yawMode_;
 		double desiredVel_;
 		double desiredAcc_;
 		double desiredAngularVel_;
 		double replanTimeForDynamicObstacle_;
+		double dynamicClearanceDrop_;
+		double obstacleDelay_;
 		std::string trajSavePath_;
 
 		// navigation data
@@ -53,6 +77,19 @@ namespace AutoFlight{
 		bool needGlobalPlan_ = false;
 		bool globalPlanReady_ = false;
 		nav_msgs::Path rrtPathMsg_;
+		AutoFlight::pathTracker globalPathTracker_; // progress along the global path
+		AutoFlight::goalSnapper goalSnapper_;
+		AutoFlight::motionPrimitiveLibrary mpLibrary_;
+		bool fallbackActive_ = false; // executing a motion primitive while the planner retries
+		int fallbackSpeedBin_;
+		int fallbackIdx_;
+		ros::Time fallbackStartTime_;
+		Eigen::Vector3d fallbackStartPos_;
+		double fallbackSpeed_;
+		double fallbackHeading_;
+		double fallbackYaw_;
+		Eigen::Vector2d fallbackVelOffset_; // current velocity minus the start velocity of the primitive, blended out
+		double fallbackBlendTime_;
 		nav_msgs::Path polyTrajMsg_;
 		nav_msgs::Path pwlTrajMsg_;
 		nav_msgs::Path bsplineTrajMsg_;
@@ -63,9 +100,19 @@ namespace AutoFlight{
 		double prevInputTrajTime_ = 0.0;
 		trajPlanner::bspline trajectory_; // trajectory data for tracking
 		double facingYaw_;
+		AutoFlight::yawPlanner yawPlanner_; // yaw along the trajectory with yaw control
+		double targetYaw_ = 0.0; // last commanded yaw
 		bool firstTimeSave_ = false;
 		bool lastDynamicObstacle_ = false;
 		ros::Time lastDynamicObstacleTime_;
+		double dynamicClearanceRef_ = 0.0; // predicted clearance at the last dynamic obstacle replan
+		AutoFlight::obstacleSnapshotPtr obstacleSnapshot_; // obstacles of the current cycle
+		int numObstacleConversions_ = 0;
+		int numObstacleRequests_ = 0;
+		ros::Time obstacleStatTime_;
+		AutoFlight::freeRegionUpdater freeRegionUpdater_; // clears only the changed part of the obstacle boxes
+		double executionDistance_ = 0.0;
+		bool executionDistanceReady_ = false;
 		
 
 
@@ -82,16 +129,32 @@ namespace AutoFlight{
 		void trajExeCB(const ros::TimerEvent&);
 		void visCB(const ros::TimerEvent&);
 		void freeMapCB(const ros::TimerEvent&); // using fake detector
+		void planYaw();
 
 		void run();	
 		void getStartEndConditions(std::vector<Eigen::Vector3d>& startEndConditions);	
 		bool hasCollision();
 		bool hasDynamicCollision();
+		void getRestTrajectorySamples(std::vector<Eigen::Vector3d>& points, std::vector<double>& times);
+		const AutoFlight::clearanceState& updateClearance();
+		void registerReplanTriggers();
+		bool newGoalTrigger();
+		bool collisionTrigger();
+		bool clearanceTrigger();
+		bool regularReplanTrigger();
+		bool dynamicObstacleTrigger();
 		double computeExecutionDistance();
-		bool replanForDynamicObstacle();
+		double getExecutionDistance();
+		bool replanForDynamicObstacle(const AutoFlight::clearanceState& clearance);
 		nav_msgs::Path getCurrentTraj(double dt);
-		nav_msgs::Path getRestGlobalPath();
+		bool startFallbackPrimitive(const std::vector<Eigen::Vector3d>& obstaclesPos, const std::vector<Eigen::Vector3d>& obstaclesVel, const std::vector<Eigen::Vector3d>& obstaclesSize);
+		void executeFallbackPrimitive();
+		void snapGoal();
+		void makeGlobalPlan(const geometry_msgs::Pose& start, const geometry_msgs::Pose& goal, nav_msgs::Path& path);
+		const nav_msgs::Path& getRestGlobalPath();
 		void getDynamicObstacles(std::vector<Eigen::Vector3d>& obstaclesPos, std::vector<Eigen::Vector3d>& obstaclesVel, std::vector<Eigen::Vector3d>& obstaclesSize);
+		void updateObstacleSnapshot();
+		AutoFlight::obstacleSnapshotPtr getObstacleSnapshot();
 	};
 }
 
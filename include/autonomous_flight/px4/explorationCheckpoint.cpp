@@ -0,0 +1,511 @@
+/*
+	FILE: explorationCheckpoint.cpp
+	------------------------
+	exploration checkpoint implementation
+*/
+#include <autonomous_flight/px4/explorationCheckpoint.h>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace AutoFlight{
+	static const char checkpointFileMagic[4] = {'A', 'F', 'E', 'C'};
+	static const uint32_t checkpointFileVersion = 3;
+	static const int checkpointHeaderBytes = 60; // magic, version, res, region min, size, block size, trailer bytes
+	static const int checkpointTrailerField = 56; // offset of the trailer bytes in the header
+
+	static uint32_t checkpointCRC(const uint8_t* data, size_t size){
+		// CRC-32 (IEEE)
+		static uint32_t table[256] = {0};
+		static bool tableReady = false;
+		if (not tableReady){
+			for (uint32_t i=0; i<256; ++i){
+				uint32_t c = i;
+				for (int k=0; k<8; ++k){
+					c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+				}
+				table[i] = c;
+			}
+			tableReady = true;
+		}
+		uint32_t crc = 0xFFFFFFFF;
+		for (size_t i=0; i<size; ++i){
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return crc ^ 0xFFFFFFFF;
+	}
+
+	static bool writeAt(int fd, const void* data, size_t size, off_t offset){
+		const char* ptr = (const char*)data;
+		while (size > 0){
+			ssize_t n = pwrite(fd, ptr, size, offset);
+			if (n <= 0){
+				return false;
+			}
+			ptr += n;
+			size -= n;
+			offset += n;
+		}
+		return true;
+	}
+
+	explorationCheckpoint::explorationCheckpoint(const ros::NodeHandle& nh) : nh_(nh), region_(nh){
+		this->initParam();
+		if (this->isEnabled()){
+			this->writer_ = std::thread(&explorationCheckpoint::writerLoop, this);
+		}
+	}
+
+	explorationCheckpoint::~explorationCheckpoint(){
+		{
+			std::lock_guard<std::mutex> lock (this->writeMutex_);
+			this->stop_ = true;
+		}
+		this->writeCV_.notify_one();
+		if (this->writer_.joinable()){
+			this->writer_.join();
+		}
+	}
+
+	void explorationCheckpoint::initParam(){
+		// checkpoint file
+		if (not this->nh_.getParam("exploration_checkpoint/file", this->file_)){
+			this->file_ = "No";
+			cout << "[ExplorationCheckpoint]: No checkpoint file param found. Checkpoint is disabled." << endl;
+		}
+		else{
+			cout << "[ExplorationCheckpoint]: Checkpoint file is set to: " << this->file_ << "." << endl;
+		}
+
+		// time between two checkpoints
+		if (not this->nh_.getParam("exploration_checkpoint/period", this->period_)){
+			this->period_ = 10.0;
+			cout << "[ExplorationCheckpoint]: No period param found. Use default: 10.0s." << endl;
+		}
+		else{
+			cout << "[ExplorationCheckpoint]: Period is set to: " << this->period_ << "s." << endl;
+		}
+
+		// load the checkpoint at startup
+		if (not this->nh_.getParam("exploration_checkpoint/resume", this->resume_)){
+			this->resume_ = true;
+			cout << "[ExplorationCheckpoint]: No resume param found. Use default: true." << endl;
+		}
+		else{
+			cout << "[ExplorationCheckpoint]: Resume is set to: " << this->resume_ << "." << endl;
+		}
+	}
+
+	void explorationCheckpoint::setMap(const std::shared_ptr<mapManager::occMap>& map){
+		this->map_ = map;
+		this->res_ = this->map_->getRes();
+		this->region_.setResolution(this->res_);
+		this->size_ = this->region_.getSize();
+		for (int i=0; i<3; ++i){
+			this->numBlocks_(i) = (this->size_(i) + this->blockSize_ - 1) / this->blockSize_;
+		}
+		this->blocks_.assign(this->numBlocks_.prod(), std::vector<uint8_t> (this->getBlockBytes(), 0));
+	}
+
+	bool explorationCheckpoint::isEnabled(){
+		return this->file_ != "No";
+	}
+
+	bool explorationCheckpoint::load(nav_msgs::Path& path, int& waypointIdx, double& pathTime){
+		path.poses.clear();
+		waypointIdx = 1;
+		pathTime = 0.0;
+		if (not this->isEnabled() or not this->resume_){
+			return false;
+		}
+		std::ifstream file (this->file_, std::ios::binary);
+		if (not file.is_open()){
+			cout << "[ExplorationCheckpoint]: No checkpoint found. Start a new exploration." << endl;
+			return false;
+		}
+
+		// the layout has to match the current region
+		char magic[4];
+		uint32_t version, trailerBytes;
+		double res;
+		Eigen::Vector3d regionMin;
+		Eigen::Vector3i size;
+		int32_t blockSize;
+		file.read(magic, 4);
+		file.read((char*)&version, sizeof(uint32_t));
+		file.read((char*)&res, sizeof(double));
+		file.read((char*)regionMin.data(), 3 * sizeof(double));
+		file.read((char*)size.data(), 3 * sizeof(int32_t));
+		file.read((char*)&blockSize, sizeof(int32_t));
+		file.read((char*)&trailerBytes, sizeof(uint32_t));
+		if (not file.good() or std::memcmp(magic, checkpointFileMagic, 4) != 0 or version != checkpointFileVersion){
+			cout << "[ExplorationCheckpoint]: Invalid checkpoint file. Start a new exploration." << endl;
+			return false;
+		}
+		if (std::abs(res - this->res_) > 1e-6 or (regionMin - this->region_.getRegionMin()).norm() > 1e-6 or size != this->size_ or blockSize != this->blockSize_){
+			cout << "[ExplorationCheckpoint]: Checkpoint does not match the map resolution or the region. Start a new exploration." << endl;
+			return false;
+		}
+
+		// a block with a wrong checksum (write interrupted by the landing) is unknown and written again with the next save
+		std::vector<std::vector<uint8_t>> blocks (this->blocks_.size(), std::vector<uint8_t> (this->getBlockBytes()));
+		std::vector<int> corruptBlocks;
+		for (size_t b=0; b<blocks.size(); ++b){
+			uint32_t crc;
+			file.read((char*)blocks[b].data(), blocks[b].size());
+			file.read((char*)&crc, sizeof(uint32_t));
+			if (file.good() and crc != checkpointCRC(blocks[b].data(), blocks[b].size())){
+				std::fill(blocks[b].begin(), blocks[b].end(), 0);
+				corruptBlocks.push_back(b);
+			}
+		}
+		if (not file.good()){
+			cout << "[ExplorationCheckpoint]: Incomplete checkpoint file. Start a new exploration." << endl;
+			return false;
+		}
+
+		// the trailer (waypoints, path and progress) ends with its checksum. A broken trailer only loses the mission state
+		const size_t progressBytes = sizeof(int32_t) + sizeof(double);
+		std::streampos trailerStart = file.tellg();
+		file.seekg(0, std::ios::end);
+		bool trailerValid = trailerBytes >= 3 * sizeof(uint32_t) + progressBytes and std::streamoff(trailerBytes) <= file.tellg() - trailerStart;
+		std::vector<uint8_t> trailer (trailerValid ? trailerBytes : 0);
+		file.seekg(trailerStart);
+		file.read((char*)trailer.data(), trailer.size());
+		trailerValid = trailerValid and file.good();
+		std::vector<Eigen::Vector3d> waypoints;
+		if (trailerValid){
+			uint32_t crc;
+			std::memcpy(&crc, trailer.data() + trailerBytes - sizeof(uint32_t), sizeof(uint32_t));
+			trailerValid = crc == checkpointCRC(trailer.data(), trailerBytes - sizeof(uint32_t));
+		}
+		uint32_t numWaypoints = 0, numPoses = 0;
+		size_t offset = 0;
+		if (trailerValid){
+			std::memcpy(&numWaypoints, trailer.data(), sizeof(uint32_t));
+			offset = sizeof(uint32_t) + size_t(numWaypoints) * 3 * sizeof(double);
+			if (offset + 2 * sizeof(uint32_t) <= trailerBytes){
+				std::memcpy(&numPoses, trailer.data() + offset, sizeof(uint32_t));
+			}
+			trailerValid = offset + 2 * sizeof(uint32_t) + size_t(numPoses) * 7 * sizeof(double) + progressBytes == trailerBytes;
+		}
+		if (trailerValid){
+			for (uint32_t i=0; i<numWaypoints; ++i){
+				Eigen::Vector3d p;
+				std::memcpy(p.data(), trailer.data() + sizeof(uint32_t) + i * 3 * sizeof(double), 3 * sizeof(double));
+				waypoints.push_back(p);
+			}
+			for (uint32_t i=0; i<numPoses; ++i){
+				double pose[7]; // position, orientation (x, y, z, w)
+				std::memcpy(pose, trailer.data() + offset + sizeof(uint32_t) + i * 7 * sizeof(double), 7 * sizeof(double));
+				geometry_msgs::PoseStamped ps;
+				ps.header.frame_id = "map";
+				ps.pose.position.x = pose[0];
+				ps.pose.position.y = pose[1];
+				ps.pose.position.z = pose[2];
+				ps.pose.orientation.x = pose[3];
+				ps.pose.orientation.y = pose[4];
+				ps.pose.orientation.z = pose[5];
+				ps.pose.orientation.w = pose[6];
+				path.poses.push_back(ps);
+			}
+			int32_t idx;
+			size_t progressOffset = offset + sizeof(uint32_t) + size_t(numPoses) * 7 * sizeof(double);
+			std::memcpy(&idx, trailer.data() + progressOffset, sizeof(int32_t));
+			std::memcpy(&pathTime, trailer.data() + progressOffset + sizeof(int32_t), sizeof(double));
+			waypointIdx = std::min(std::max(int(idx), 1), std::max(int(numPoses) - 1, 1));
+		}
+		else{
+			cout << "[ExplorationCheckpoint]: Checkpoint waypoints and path are corrupt. Only the map is restored." << endl;
+		}
+		if (not corruptBlocks.empty()){
+			cout << "[ExplorationCheckpoint]: " << corruptBlocks.size() << " corrupt checkpoint blocks are set to unknown." << endl;
+		}
+		path.header.frame_id = "map";
+		this->blocks_ = blocks;
+		this->waypointHistory_ = waypoints;
+
+		// restore the free space by runs along x. The map has no interface to set the occupied voxels, they
+		// stay unknown in the map until observed again (and are kept in the checkpoint until then)
+		auto getState = [this](int x, int y, int z){
+			int b = (x / this->blockSize_ * this->numBlocks_(1) + y / this->blockSize_) * this->numBlocks_(2) + z / this->blockSize_;
+			int i = ((x % this->blockSize_) * this->blockSize_ + y % this->blockSize_) * this->blockSize_ + z % this->blockSize_;
+			return (this->blocks_[b][i/4] >> (2 * (i % 4))) & 3;
+		};
+		int numFree = 0;
+		int numOccupied = 0;
+		for (int z=0; z<this->size_(2); ++z){
+			for (int y=0; y<this->size_(1); ++y){
+				int runStart = -1;
+				for (int x=0; x<=this->size_(0); ++x){
+					int state = x < this->size_(0) ? getState(x, y, z) : 0;
+					numOccupied += state == 2;
+					if (state == 1){
+						++numFree;
+						if (runStart < 0){
+							runStart = x;
+						}
+					}
+					else if (runStart >= 0){
+						this->map_->freeRegion(this->region_.toPos(Eigen::Vector3i (runStart, y, z)), this->region_.toPos(Eigen::Vector3i (x-1, y, z)));
+						runStart = -1;
+					}
+				}
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock (this->writeMutex_);
+			this->fileReady_ = true;
+			this->unsavedBlocks_.insert(corruptBlocks.begin(), corruptBlocks.end());
+		}
+		double voxelVolume = pow(this->res_, 3);
+		cout << "[ExplorationCheckpoint]: Checkpoint loaded. Free: " << numFree * voxelVolume << "m^3, occupied: " << numOccupied * voxelVolume
+		     << "m^3 (not restored), waypoints: " << waypoints.size() << ", path: " << path.poses.size() << " poses (next: " << waypointIdx
+		     << ", flown for " << pathTime << "s)." << endl;
+		return true;
+	}
+
+	void explorationCheckpoint::update(const Eigen::Vector3d& pos){
+		this->region_.addPosition(pos);
+	}
+
+	void explorationCheckpoint::addWaypoint(const Eigen::Vector3d& waypoint){
+		this->waypointHistory_.push_back(waypoint);
+	}
+
+	void explorationCheckpoint::save(const nav_msgs::Path& path, int waypointIdx, double pathTime){
+		if (not this->isEnabled() or not this->map_){
+			return;
+		}
+		ros::Time currTime = ros::Time::now();
+		if (not this->lastSaveTime_.isZero() and (currTime - this->lastSaveTime_).toSec() < this->period_){
+			return;
+		}
+		this->lastSaveTime_ = currTime;
+
+		// only the map queries run here. The packing and the comparison with the file are done by the writer thread
+		Eigen::Vector3i blockMin, blockMax;
+		if (this->region_.getDirtyRange(blockMin, blockMax)){
+			blockMin /= this->blockSize_;
+			blockMax /= this->blockSize_;
+		}
+		else{
+			blockMin = Eigen::Vector3i::Zero();
+			blockMax = -Eigen::Vector3i::Ones();
+		}
+		std::map<int, std::vector<uint8_t>> dirtyStates;
+		for (int bx=blockMin(0); bx<=blockMax(0); ++bx){
+			for (int by=blockMin(1); by<=blockMax(1); ++by){
+				for (int bz=blockMin(2); bz<=blockMax(2); ++bz){
+					int b = (bx * this->numBlocks_(1) + by) * this->numBlocks_(2) + bz;
+					this->sampleBlock(Eigen::Vector3i (bx, by, bz), dirtyStates[b]);
+				}
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock (this->writeMutex_);
+			for (std::pair<const int, std::vector<uint8_t>>& block : dirtyStates){
+				std::vector<uint8_t>& pending = this->pendingStates_[block.first];
+				if (pending.empty()){
+					pending.swap(block.second);
+					continue;
+				}
+				for (size_t i=0; i<pending.size(); ++i){ // a block not taken yet keeps the voxels unknown in the new sample
+					if (block.second[i] != 0){
+						pending[i] = block.second[i];
+					}
+				}
+			}
+			this->pendingWaypoints_ = this->waypointHistory_;
+			this->pendingPath_ = path;
+			this->pendingWaypointIdx_ = waypointIdx;
+			this->pendingPathTime_ = pathTime;
+			this->hasPending_ = true;
+		}
+		this->writeCV_.notify_one();
+	}
+
+	void explorationCheckpoint::sampleBlock(const Eigen::Vector3i& blockIdx, std::vector<uint8_t>& states){
+		// one byte per voxel. 0 (unknown in the map) keeps the state of the checkpoint (occupied voxels of a loaded checkpoint)
+		states.assign(this->blockSize_ * this->blockSize_ * this->blockSize_, 0);
+		for (int x=0; x<this->blockSize_; ++x){
+			for (int y=0; y<this->blockSize_; ++y){
+				for (int z=0; z<this->blockSize_; ++z){
+					Eigen::Vector3i idx = blockIdx * this->blockSize_ + Eigen::Vector3i (x, y, z);
+					if ((idx.array() >= this->size_.array()).any()){
+						continue;
+					}
+					Eigen::Vector3d p = this->region_.toPos(idx);
+					if (not this->map_->isInMap(p) or this->map_->isUnknown(p)){
+						continue;
+					}
+					states[(x * this->blockSize_ + y) * this->blockSize_ + z] = this->map_->isOccupied(p) ? 2 : 1;
+				}
+			}
+		}
+	}
+
+	bool explorationCheckpoint::packBlock(const std::vector<uint8_t>& states, std::vector<uint8_t>& data){
+		bool changed = false;
+		for (size_t i=0; i<states.size(); ++i){
+			if (states[i] == 0){
+				continue;
+			}
+			uint8_t packed = (data[i/4] & ~(3 << (2 * (i % 4)))) | (states[i] << (2 * (i % 4)));
+			changed = changed or packed != data[i/4];
+			data[i/4] = packed;
+		}
+		return changed;
+	}
+
+	void explorationCheckpoint::writerLoop(){
+		while (true){
+			std::map<int, std::vector<uint8_t>> states;
+			std::vector<Eigen::Vector3d> waypoints;
+			nav_msgs::Path path;
+			int waypointIdx;
+			double pathTime;
+			{
+				std::unique_lock<std::mutex> lock (this->writeMutex_);
+				this->writeCV_.wait(lock, [this](){return this->hasPending_ or this->stop_;});
+				if (not this->hasPending_){
+					break;
+				}
+				states.swap(this->pendingStates_);
+				waypoints = this->pendingWaypoints_;
+				path = this->pendingPath_;
+				waypointIdx = this->pendingWaypointIdx_;
+				pathTime = this->pendingPathTime_;
+				this->hasPending_ = false;
+			}
+
+			ros::WallTime startTime = ros::WallTime::now();
+			for (const std::pair<const int, std::vector<uint8_t>>& block : states){
+				if (this->packBlock(block.second, this->blocks_[block.first])){
+					this->unsavedBlocks_.insert(block.first);
+				}
+			}
+
+			// the blocks stay unsaved until a write succeeds, so a failed block is written again with the next save
+			int numBlocks = this->unsavedBlocks_.size();
+			if (this->writeFile(this->unsavedBlocks_, waypoints, path, waypointIdx, pathTime)){
+				this->unsavedBlocks_.clear();
+				cout << "[ExplorationCheckpoint]: Checkpoint saved. Blocks: " << numBlocks << ", time: " << (ros::WallTime::now() - startTime).toSec() << "s." << endl;
+			}
+			else{
+				cout << "[ExplorationCheckpoint]: Cannot write the checkpoint file: " << this->file_ << ". " << numBlocks << " blocks are kept for the next save." << endl;
+			}
+		}
+	}
+
+	bool explorationCheckpoint::writeFile(const std::set<int>& blocks, const std::vector<Eigen::Vector3d>& waypoints, const nav_msgs::Path& path, int waypointIdx, double pathTime){
+		/*
+			Each block is followed by its checksum and the trailer ends with its checksum, so a write cut
+			by the landing only loses the parts being written. A new file is written to a temporary file
+			and renamed, the in place writes are synced before the next save
+		*/
+		bool fileReady;
+		{
+			std::lock_guard<std::mutex> lock (this->writeMutex_);
+			fileReady = this->fileReady_;
+		}
+		int blockBytes = this->getBlockBytes();
+		int recordBytes = blockBytes + sizeof(uint32_t);
+		int numBlocks = this->numBlocks_.prod();
+
+		// a new file with the header and every block
+		if (not fileReady){
+			std::string tempFile = this->file_ + ".tmp";
+			int fd = open(tempFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if (fd < 0){
+				return false;
+			}
+			std::vector<uint8_t> data (checkpointHeaderBytes + size_t(numBlocks) * recordBytes, 0);
+			uint8_t* ptr = data.data();
+			int32_t blockSize = this->blockSize_;
+			std::memcpy(ptr, checkpointFileMagic, 4);
+			std::memcpy(ptr + 4, &checkpointFileVersion, sizeof(uint32_t));
+			std::memcpy(ptr + 8, &this->res_, sizeof(double));
+			std::memcpy(ptr + 16, this->region_.getRegionMin().data(), 3 * sizeof(double));
+			std::memcpy(ptr + 40, this->size_.data(), 3 * sizeof(int32_t));
+			std::memcpy(ptr + 52, &blockSize, sizeof(int32_t)); // trailer bytes stay 0 until the trailer is written
+			for (int b=0; b<numBlocks; ++b){
+				const std::vector<uint8_t>& blockData = this->blocks_[b];
+				uint32_t crc = checkpointCRC(blockData.data(), blockBytes);
+				uint8_t* record = ptr + checkpointHeaderBytes + size_t(b) * recordBytes;
+				std::memcpy(record, blockData.data(), blockBytes);
+				std::memcpy(record + blockBytes, &crc, sizeof(uint32_t));
+			}
+			bool success = writeAt(fd, data.data(), data.size(), 0) and fsync(fd) == 0;
+			success = close(fd) == 0 and success;
+			if (not success or std::rename(tempFile.c_str(), this->file_.c_str()) != 0){
+				return false;
+			}
+		}
+
+		// changed blocks in place, then the trailer and its size in the header
+		int fd = open(this->file_.c_str(), O_RDWR);
+		if (fd < 0){
+			return false;
+		}
+		bool success = true;
+		if (fileReady){
+			std::vector<uint8_t> record (recordBytes);
+			for (int b : blocks){
+				uint32_t crc = checkpointCRC(this->blocks_[b].data(), blockBytes);
+				std::memcpy(record.data(), this->blocks_[b].data(), blockBytes);
+				std::memcpy(record.data() + blockBytes, &crc, sizeof(uint32_t));
+				success = success and writeAt(fd, record.data(), recordBytes, checkpointHeaderBytes + off_t(b) * recordBytes);
+			}
+		}
+		uint32_t numWaypoints = waypoints.size();
+		uint32_t numPoses = path.poses.size();
+		int32_t idx = waypointIdx;
+		uint32_t trailerBytes = 3 * sizeof(uint32_t) + numWaypoints * 3 * sizeof(double) + numPoses * 7 * sizeof(double) + sizeof(int32_t) + sizeof(double);
+		std::vector<uint8_t> trailer (trailerBytes);
+		uint8_t* ptr = trailer.data();
+		std::memcpy(ptr, &numWaypoints, sizeof(uint32_t));
+		ptr += sizeof(uint32_t);
+		for (const Eigen::Vector3d& p : waypoints){
+			std::memcpy(ptr, p.data(), 3 * sizeof(double));
+			ptr += 3 * sizeof(double);
+		}
+		std::memcpy(ptr, &numPoses, sizeof(uint32_t));
+		ptr += sizeof(uint32_t);
+		for (const geometry_msgs::PoseStamped& ps : path.poses){
+			double pose[7] = {ps.pose.position.x, ps.pose.position.y, ps.pose.position.z, ps.pose.orientation.x, ps.pose.orientation.y, ps.pose.orientation.z, ps.pose.orientation.w};
+			std::memcpy(ptr, pose, 7 * sizeof(double));
+			ptr += 7 * sizeof(double);
+		}
+		std::memcpy(ptr, &idx, sizeof(int32_t));
+		ptr += sizeof(int32_t);
+		std::memcpy(ptr, &pathTime, sizeof(double));
+		ptr += sizeof(double);
+		uint32_t crc = checkpointCRC(trailer.data(), trailerBytes - sizeof(uint32_t));
+		std::memcpy(ptr, &crc, sizeof(uint32_t));
+		off_t trailerOffset = checkpointHeaderBytes + off_t(numBlocks) * recordBytes;
+		success = success and writeAt(fd, trailer.data(), trailerBytes, trailerOffset) and ftruncate(fd, trailerOffset + trailerBytes) == 0;
+		success = success and writeAt(fd, &trailerBytes, sizeof(uint32_t), checkpointTrailerField);
+		success = success and fsync(fd) == 0;
+		success = close(fd) == 0 and success;
+		if (not success){
+			return false;
+		}
+
+		if (not fileReady){
+			std::lock_guard<std::mutex> lock (this->writeMutex_);
+			this->fileReady_ = true;
+		}
+		return true;
+	}
+
+	int explorationCheckpoint::getBlockBytes(){
+		return (this->blockSize_ * this->blockSize_ * this->blockSize_ * 2 + 7) / 8;
+	}
+}
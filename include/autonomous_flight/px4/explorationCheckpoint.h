@@ -0,0 +1,94 @@
+/*
+	FILE: explorationCheckpoint.h
+	------------------------
+	exploration checkpoint written in the background and loaded at startup
+*/
+
+#ifndef AUTOFLIGHT_EXPLORATION_CHECKPOINT_H
+#define AUTOFLIGHT_EXPLORATION_CHECKPOINT_H
+#include <ros/ros.h>
+#include <map_manager/occupancyMap.h>
+#include <autonomous_flight/px4/dirtyRegionTracker.h>
+#include <nav_msgs/Path.h>
+#include <Eigen/Dense>
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+
+using std::cout; using std::endl;
+namespace AutoFlight{
+	/*
+		The checkpoint file holds the voxel states (2 bits: unknown, free, occupied) of the global
+		region in blocks of 8x8x8 voxels at fixed offsets, followed by the reached waypoints, the
+		current exploration path and the progress along it. Each block and the trailer carry a CRC-32,
+		so a cut write is detected at the load. Each save only samples the map in the blocks of the
+		dirty region. The writer thread packs them, rewrites the changed blocks in place and keeps the
+		blocks of a failed write for the next save; the caller never waits for the file.
+	*/
+	class explorationCheckpoint{
+	private:
+		ros::NodeHandle nh_;
+		std::shared_ptr<mapManager::occMap> map_;
+
+		// parameters
+		std::string file_;
+		double period_;
+		bool resume_;
+
+		// blocks of the global region
+		const int blockSize_ = 8;
+		AutoFlight::dirtyRegionTracker region_;
+		double res_;
+		Eigen::Vector3i size_; // voxels
+		Eigen::Vector3i numBlocks_;
+		std::vector<Eigen::Vector3d> waypointHistory_;
+		ros::Time lastSaveTime_;
+
+		// writer thread (owns the packed blocks)
+		std::thread writer_;
+		std::mutex writeMutex_;
+		std::condition_variable writeCV_;
+		std::vector<std::vector<uint8_t>> blocks_; // packed states of the latest save
+		std::set<int> unsavedBlocks_; // blocks not in the file yet (changed, failed to write or corrupt at the load)
+		std::map<int, std::vector<uint8_t>> pendingStates_; // voxel states of the dirty blocks (0: unknown, 1: free, 2: occupied)
+		std::vector<Eigen::Vector3d> pendingWaypoints_;
+		nav_msgs::Path pendingPath_;
+		int pendingWaypointIdx_ = 1;
+		double pendingPathTime_ = 0.0;
+		bool hasPending_ = false;
+		bool fileReady_ = false; // the file matches the region layout (loaded or created)
+		bool stop_ = false;
+
+	public:
+		explorationCheckpoint(const ros::NodeHandle& nh);
+		~explorationCheckpoint();
+		void initParam();
+		void setMap(const std::shared_ptr<mapManager::occMap>& map);
+		bool isEnabled();
+
+		// restores the free space into the map and returns the exploration path of the checkpoint with the
+		// index of its next waypoint and the time flown along it
+		bool load(nav_msgs::Path& path, int& waypointIdx, double& pathTime);
+
+		// robot position at the rate of the caller
+		void update(const Eigen::Vector3d& pos);
+		void addWaypoint(const Eigen::Vector3d& waypoint);
+
+		// queues the dirty blocks and the path every period
+		void save(const nav_msgs::Path& path, int waypointIdx, double pathTime);
+
+	private:
+		void sampleBlock(const Eigen::Vector3i& blockIdx, std::vector<uint8_t>& states);
+		bool packBlock(const std::vector<uint8_t>& states, std::vector<uint8_t>& data);
+		void writerLoop();
+		bool writeFile(const std::set<int>& blocks, const std::vector<Eigen::Vector3d>& waypoints, const nav_msgs::Path& path, int waypointIdx, double pathTime);
+		int getBlockBytes();
+	};
+}
+
+#endif
@@ -0,0 +1,177 @@
+/*
+	FILE: explorationTelemetry.cpp
+	------------------------
+	exploration telemetry implementation
+*/
+#include <autonomous_flight/px4/explorationTelemetry.h>
+
+namespace AutoFlight{
+	explorationTelemetry::explorationTelemetry(const ros::NodeHandle& nh) : nh_(nh), region_(nh){
+		this->initParam();
+		this->registerPub();
+		this->planTimeHist_.resize(this->planTimeBins_.size() + 1, 0);
+	}
+
+	void explorationTelemetry::initParam(){
+		// below this speed the robot is hovering
+		if (not this->nh_.getParam("exploration_telemetry/hover_speed", this->hoverSpeed_)){
+			this->hoverSpeed_ = 0.1;
+			cout << "[ExplorationTelemetry]: No hover speed param found. Use default: 0.1m/s." << endl;
+		}
+		else{
+			cout << "[ExplorationTelemetry]: Hover speed is set to: " << this->hoverSpeed_ << "m/s." << endl;
+		}
+	}
+
+	void explorationTelemetry::registerPub(){
+		this->telemetryPub_ = this->nh_.advertise<std_msgs::Float64MultiArray>("dynamicExploration/telemetry", 10);
+	}
+
+	void explorationTelemetry::setMap(const std::shared_ptr<mapManager::occMap>& map){
+		this->map_ = map;
+		this->region_.setResolution(this->map_->getRes());
+		this->state_.assign(this->region_.getNumVoxels(), 0);
+		this->numFree_ = 0;
+		this->numOccupied_ = 0;
+	}
+
+	void explorationTelemetry::updateMotion(const Eigen::Vector3d& pos, const Eigen::Vector3d& vel){
+		ros::Time currTime = ros::Time::now();
+		if (this->motionInit_){
+			double dt = (currTime - this->prevMotionTime_).toSec();
+			this->distance_ += (pos - this->prevPos_).norm();
+			if (vel.norm() < this->hoverSpeed_){
+				this->hoverTime_ += dt;
+			}
+			else{
+				this->moveTime_ += dt;
+			}
+		}
+		this->prevPos_ = pos;
+		this->prevMotionTime_ = currTime;
+		this->motionInit_ = true;
+		this->region_.addPosition(pos);
+	}
+
+	void explorationTelemetry::addDwellTime(double dwellTime){
+		++this->numDwell_;
+		this->totalDwell_ += dwellTime;
+		this->maxDwell_ = std::max(this->maxDwell_, dwellTime);
+	}
+
+	void explorationTelemetry::addPlanTime(double planTime){
+		std::lock_guard<std::mutex> lock (this->planMutex_);
+		size_t bin = 0;
+		while (bin < this->planTimeBins_.size() and planTime > this->planTimeBins_[bin]){
+			++bin;
+		}
+		++this->planTimeHist_[bin];
+		++this->numPlans_;
+		this->totalPlanTime_ += planTime;
+		this->maxPlanTime_ = std::max(this->maxPlanTime_, planTime);
+	}
+
+	void explorationTelemetry::addSnapshotTime(double snapshotTime){
+		++this->numSnapshots_;
+		this->totalSnapshotTime_ += snapshotTime;
+		this->maxSnapshotTime_ = std::max(this->maxSnapshotTime_, snapshotTime);
+	}
+
+	void explorationTelemetry::addReplanRequest(const std::string& reason){
+		++this->replanRequests_[reason];
+	}
+
+	void explorationTelemetry::publish(){
+		ros::Time currTime = ros::Time::now();
+		double pubTime = (currTime - this->lastPubTime_).toSec();
+		if (not this->lastPubTime_.isZero() and pubTime < 1.0){
+			return;
+		}
+
+		this->updateVolume();
+		double voxelVolume = pow(this->region_.getRes(), 3);
+		double freeVolume = this->numFree_ * voxelVolume;
+		double occupiedVolume = this->numOccupied_ * voxelVolume;
+		double knownVolume = freeVolume + occupiedVolume;
+		double exploredRate = this->lastPubTime_.isZero() ? 0.0 : (knownVolume - this->prevKnownVolume_) / pubTime * 60.0;
+		if (this->startTime_.isZero()){
+			this->startTime_ = currTime;
+			this->startKnownVolume_ = knownVolume;
+		}
+		double missionTime = (currTime - this->startTime_).toSec();
+		double avgExploredRate = missionTime > 0.0 ? (knownVolume - this->startKnownVolume_) / missionTime * 60.0 : 0.0;
+		double motionTime = this->hoverTime_ + this->moveTime_;
+		double hoverFraction = motionTime > 0.0 ? this->hoverTime_ / motionTime : 0.0;
+		double avgDwell = this->numDwell_ > 0 ? this->totalDwell_ / this->numDwell_ : 0.0;
+		double avgSnapshot = this->numSnapshots_ > 0 ? this->totalSnapshotTime_ / this->numSnapshots_ : 0.0;
+		this->prevKnownVolume_ = knownVolume;
+		this->lastPubTime_ = currTime;
+
+		std::vector<int> planTimeHist;
+		int numPlans;
+		double avgPlanTime, maxPlanTime;
+		{
+			std::lock_guard<std::mutex> lock (this->planMutex_);
+			planTimeHist = this->planTimeHist_;
+			numPlans = this->numPlans_;
+			avgPlanTime = numPlans > 0 ? this->totalPlanTime_ / numPlans : 0.0;
+			maxPlanTime = this->maxPlanTime_;
+		}
+
+		this->telemetryMsg_.layout.dim.resize(1);
+		this->telemetryMsg_.layout.dim[0].label = "known,free,occupied,explored_rate,explored_rate_avg,distance,hover_fraction,dwell_avg,dwell_max,plans,plan_avg,plan_max,snapshot_avg,snapshot_max,plan_hist";
+		this->telemetryMsg_.data = {knownVolume, freeVolume, occupiedVolume, exploredRate, avgExploredRate, this->distance_, hoverFraction,
+		                            avgDwell, this->maxDwell_, double(numPlans), avgPlanTime, maxPlanTime, avgSnapshot, this->maxSnapshotTime_};
+		for (int count : planTimeHist){
+			this->telemetryMsg_.data.push_back(count);
+		}
+		this->telemetryMsg_.layout.dim[0].size = this->telemetryMsg_.data.size();
+		this->telemetryMsg_.layout.dim[0].stride = this->telemetryMsg_.data.size();
+		this->telemetryPub_.publish(this->telemetryMsg_);
+
+		cout << "[ExplorationTelemetry]: Known " << knownVolume << "m^3 (free " << freeVolume << ", occupied " << occupiedVolume << "), "
+		     << exploredRate << "m^3/min (avg " << avgExploredRate << " over " << missionTime << "s), flown " << this->distance_ << "m, hover " << 100.0 * hoverFraction << "%, dwell avg "
+		     << avgDwell << "s max " << this->maxDwell_ << "s, DEP " << numPlans << " plans avg " << avgPlanTime << "s max " << maxPlanTime << "s hist [";
+		for (size_t i=0; i<planTimeHist.size(); ++i){
+			cout << (i == 0 ? "" : " ") << planTimeHist[i];
+		}
+		cout << "], map snapshot avg " << 1000.0 * avgSnapshot << "ms max " << 1000.0 * this->maxSnapshotTime_ << "ms, replan requests:";
+		for (const std::pair<const std::string, int>& request : this->replanRequests_){
+			cout << " " << request.first << " " << request.second;
+		}
+		cout << "." << endl;
+	}
+
+	void explorationTelemetry::updateVolume(){
+		if (not this->map_){
+			return;
+		}
+
+		Eigen::Vector3i idxMin, idxMax;
+		if (this->region_.getDirtyRange(idxMin, idxMax)){
+			this->updateVoxels(idxMin, idxMax);
+		}
+	}
+
+	void explorationTelemetry::updateVoxels(const Eigen::Vector3i& idxMin, const Eigen::Vector3i& idxMax){
+		for (int x=idxMin(0); x<=idxMax(0); ++x){
+			for (int y=idxMin(1); y<=idxMax(1); ++y){
+				for (int z=idxMin(2); z<=idxMax(2); ++z){
+					Eigen::Vector3i idx (x, y, z);
+					Eigen::Vector3d p = this->region_.toPos(idx);
+					uint8_t state = 0;
+					if (this->map_->isInMap(p) and not this->map_->isUnknown(p)){
+						state = this->map_->isOccupied(p) ? 2 : 1;
+					}
+
+					uint8_t& prevState = this->state_[this->region_.toIndex(idx)];
+					if (state != prevState){
+						this->numFree_ += (state == 1) - (prevState == 1);
+						this->numOccupied_ += (state == 2) - (prevState == 2);
+						prevState = state;
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,95 @@
+/*
+	FILE: explorationTelemetry.h
+	------------------------
+	exploration progress and planner metrics
+*/
+
+#ifndef AUTOFLIGHT_EXPLORATION_TELEMETRY_H
+#define AUTOFLIGHT_EXPLORATION_TELEMETRY_H
+#include <ros/ros.h>
+#include <std_msgs/Float64MultiArray.h>
+#include <map_manager/occupancyMap.h>
+#include <autonomous_flight/px4/dirtyRegionTracker.h>
+#include <Eigen/Dense>
+#include <vector>
+#include <map>
+#include <string>
+#include <mutex>
+#include <memory>
+
+using std::cout; using std::endl;
+namespace AutoFlight{
+	/*
+		The voxel states (unknown, free, occupied) inside the global region are cached, and the
+		volumes are counted incrementally in the dirty region of each update.
+		Published at 1 Hz as [known, free, occupied (m^3), explored rate, mission average rate (m^3/min), distance (m),
+		hover fraction, dwell avg, dwell max (s), plans, plan avg, plan max (s), map snapshot avg,
+		snapshot max (s), plan time histogram].
+	*/
+	class explorationTelemetry{
+	private:
+		ros::NodeHandle nh_;
+		ros::Publisher telemetryPub_;
+		std::shared_ptr<mapManager::occMap> map_;
+
+		// parameters
+		double hoverSpeed_;
+		std::vector<double> planTimeBins_ {0.1, 0.2, 0.5, 1.0, 2.0}; // s, upper bounds of the histogram bins
+
+		// voxel states in the global region
+		AutoFlight::dirtyRegionTracker region_;
+		std::vector<uint8_t> state_; // 0 unknown, 1 free, 2 occupied
+		int numFree_ = 0;
+		int numOccupied_ = 0;
+
+		// motion
+		bool motionInit_ = false;
+		Eigen::Vector3d prevPos_;
+		ros::Time prevMotionTime_;
+		double distance_ = 0.0;
+		double hoverTime_ = 0.0;
+		double moveTime_ = 0.0;
+
+		// dwell at waypoints and exploration planning (the planning is timed in the exploration thread)
+		int numDwell_ = 0;
+		double totalDwell_ = 0.0;
+		double maxDwell_ = 0.0;
+		std::mutex planMutex_;
+		std::vector<int> planTimeHist_;
+		int numPlans_ = 0;
+		double totalPlanTime_ = 0.0;
+		double maxPlanTime_ = 0.0;
+		int numSnapshots_ = 0; // map copies for the exploration planner (taken in the exploration callback)
+		double totalSnapshotTime_ = 0.0;
+		double maxSnapshotTime_ = 0.0;
+		std::map<std::string, int> replanRequests_;
+
+		ros::Time lastPubTime_;
+		double prevKnownVolume_ = 0.0;
+		ros::Time startTime_; // first publish. The average rate compares whole flights (e.g. with and without manual_confirm)
+		double startKnownVolume_ = 0.0;
+		std_msgs::Float64MultiArray telemetryMsg_;
+
+	public:
+		explorationTelemetry(const ros::NodeHandle& nh);
+		void initParam();
+		void registerPub();
+		void setMap(const std::shared_ptr<mapManager::occMap>& map);
+
+		// robot state, called at the rate of the exploration callback
+		void updateMotion(const Eigen::Vector3d& pos, const Eigen::Vector3d& vel);
+		void addDwellTime(double dwellTime);
+		void addPlanTime(double planTime);
+		void addSnapshotTime(double snapshotTime);
+		void addReplanRequest(const std::string& reason);
+
+		// update the volumes, publish and log at 1 Hz
+		void publish();
+
+	private:
+		void updateVolume();
+		void updateVoxels(const Eigen::Vector3i& idxMin, const Eigen::Vector3i& idxMax);
+	};
+}
+
+#endif
@@ -15,6 +15,15 @@ namespace AutoFlight{
 			cout << "[AutoFlight]: Takeoff Height: " << this->takeoffHgt_ << "m." << endl;
 		}
 
+		// height of the goal received from the click
+		if (not this->nh_.getParam("autonomous_flight/goal_height", this->goalHgt_)){
+			this->goalHgt_ = 1.0;
+			cout << "[AutoFlight]: No goal height param found. Use default: 1.0 m." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Goal Height: " << this->goalHgt_ << "m." << endl;
+		}
+
 		// Subscriber
 		this->stateSub_ = this->nh_.subscribe<mavros_msgs::State>("/mavros/state", 1000, &flightBase::stateCB, this);
 		this->odomSub_ = this->nh_.subscribe<nav_msgs::Odometry>("/mavros/local_position/odom", 1000, &flightBase::odomCB, this);
@@ -108,7 +117,7 @@ namespace AutoFlight{
 
 	void flightBase::clickCB(const geometry_msgs::PoseStamped::ConstPtr& cp){
 		this->goal_ = *cp;
-		this->goal_.pose.position.z = 1.0;
+		this->goal_.pose.position.z = this->goalHgt_;
 		if (not this->firstGoal_){
 			this->firstGoal_ = true;
 		}
@@ -46,6 +46,7 @@ namespace AutoFlight{
 		
 		// parameters
 		double takeoffHgt_;
+		double goalHgt_;
 		bool yawControl_;
 		int timeStep_;
 		double radius_;
@@ -0,0 +1,102 @@
+/*
+	FILE: freeRegionUpdater.cpp
+	------------------------
+	free region updater implementation
+*/
+#include <autonomous_flight/px4/freeRegionUpdater.h>
+
+namespace AutoFlight{
+	freeRegionUpdater::freeRegionUpdater(){}
+
+	void freeRegionUpdater::setMap(const std::shared_ptr<mapManager::occMap>& map){
+		this->map_ = map;
+	}
+
+	void freeRegionUpdater::update(const std::vector<freeBox>& regions){
+		for (const freeBox& region : regions){
+			this->numVoxelsFull_ += this->getNumVoxels(region);
+		}
+
+		// nothing moved since the last detection
+		if (regions == this->prevRegions_){
+			this->reportStat();
+			return;
+		}
+
+		this->deltaRegions_.clear();
+		for (const freeBox& region : regions){
+			int bestIdx = -1;
+			double bestOverlap = 0.0;
+			for (size_t i=0; i<this->prevRegions_.size(); ++i){
+				double overlap = this->getOverlapVolume(region, this->prevRegions_[i]);
+				if (overlap > bestOverlap){
+					bestOverlap = overlap;
+					bestIdx = i;
+				}
+			}
+			if (bestIdx == -1){
+				this->deltaRegions_.push_back(region);
+			}
+			else{
+				this->subtractBox(region, this->prevRegions_[bestIdx], this->deltaRegions_);
+			}
+		}
+		for (const freeBox& region : this->deltaRegions_){
+			this->numVoxelsWritten_ += this->getNumVoxels(region);
+		}
+
+		this->map_->updateFreeRegions(regions);
+		if (this->deltaRegions_.size() != 0){
+			this->map_->freeRegions(this->deltaRegions_);
+		}
+		this->prevRegions_ = regions;
+		this->reportStat();
+	}
+
+	void freeRegionUpdater::subtractBox(const freeBox& box, const freeBox& other, std::vector<freeBox>& result){
+		// slabs of box outside of other along x, then y, then z
+		Eigen::Vector3d lower = box.first;
+		Eigen::Vector3d upper = box.second;
+		for (int axis=0; axis<3; ++axis){
+			if (other.first(axis) > lower(axis)){
+				Eigen::Vector3d sliceUpper = upper;
+				sliceUpper(axis) = other.first(axis);
+				result.push_back(std::make_pair(lower, sliceUpper));
+				lower(axis) = other.first(axis);
+			}
+			if (other.second(axis) < upper(axis)){
+				Eigen::Vector3d sliceLower = lower;
+				sliceLower(axis) = other.second(axis);
+				result.push_back(std::make_pair(sliceLower, upper));
+				upper(axis) = other.second(axis);
+			}
+		}
+	}
+
+	double freeRegionUpdater::getOverlapVolume(const freeBox& box1, const freeBox& box2){
+		Eigen::Vector3d diff = box1.second.cwiseMin(box2.second) - box1.first.cwiseMax(box2.first);
+		if (diff(0) <= 0 or diff(1) <= 0 or diff(2) <= 0){
+			return 0.0;
+		}
+		return diff(0) * diff(1) * diff(2);
+	}
+
+	double freeRegionUpdater::getNumVoxels(const freeBox& box){
+		double res = this->map_->getRes();
+		Eigen::Vector3d diff = box.second - box.first;
+		return (floor(diff(0)/res) + 1) * (floor(diff(1)/res) + 1) * (floor(diff(2)/res) + 1);
+	}
+
+	void freeRegionUpdater::reportStat(){
+		ros::Time currTime = ros::Time::now();
+		double statTime = (currTime - this->statTime_).toSec();
+		if (statTime >= 10.0){
+			if (not this->statTime_.isZero()){
+				cout << "[AutoFlight]: Free map voxels written: " << this->numVoxelsWritten_/statTime << "/s (" << this->numVoxelsFull_/statTime << "/s when clearing all boxes)." << endl;
+			}
+			this->numVoxelsWritten_ = 0.0;
+			this->numVoxelsFull_ = 0.0;
+			this->statTime_ = currTime;
+		}
+	}
+}
@@ -0,0 +1,48 @@
+/*
+	FILE: freeRegionUpdater.h
+	------------------------
+	keep the map free inside dynamic obstacle boxes by clearing only the changed voxels
+*/
+
+#ifndef AUTOFLIGHT_FREE_REGION_UPDATER_H
+#define AUTOFLIGHT_FREE_REGION_UPDATER_H
+#include <ros/ros.h>
+#include <map_manager/occupancyMap.h>
+#include <Eigen/Dense>
+#include <vector>
+#include <memory>
+
+using std::cout; using std::endl;
+namespace AutoFlight{
+	typedef std::pair<Eigen::Vector3d, Eigen::Vector3d> freeBox; // lower bound, upper bound
+
+	/*
+		The map keeps the regions given by updateFreeRegions free on its own updates,
+		so a box only needs to be cleared once. Each new box is matched with the
+		previous box it overlaps most and only the part outside of it is cleared.
+	*/
+	class freeRegionUpdater{
+	private:
+		std::shared_ptr<mapManager::occMap> map_;
+		std::vector<freeBox> prevRegions_;
+		std::vector<freeBox> deltaRegions_;
+
+		// statistics
+		double numVoxelsWritten_ = 0.0;
+		double numVoxelsFull_ = 0.0; // voxels written when all boxes are cleared every call
+		ros::Time statTime_;
+
+	public:
+		freeRegionUpdater();
+		void setMap(const std::shared_ptr<mapManager::occMap>& map);
+		void update(const std::vector<freeBox>& regions);
+
+	private:
+		void subtractBox(const freeBox& box, const freeBox& other, std::vector<freeBox>& result);
+		double getOverlapVolume(const freeBox& box1, const freeBox& box2);
+		double getNumVoxels(const freeBox& box);
+		void reportStat();
+	};
+}
+
+#endif
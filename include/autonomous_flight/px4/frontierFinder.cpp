@@ -0,0 +1,182 @@
+/*
+	FILE: frontierFinder.cpp
+	------------------------
+	frontier finder implementation
+*/
+#include <autonomous_flight/px4/frontierFinder.h>
+#include <algorithm>
+#include <limits>
+
+namespace AutoFlight{
+	frontierFinder::frontierFinder(const ros::NodeHandle& nh) : nh_(nh), region_(nh){
+		this->initParam();
+	}
+
+	void frontierFinder::initParam(){
+		// update period
+		if (not this->nh_.getParam("frontier_finder/update_period", this->updatePeriod_)){
+			this->updatePeriod_ = 1.0;
+			cout << "[FrontierFinder]: No update period param found. Use default: 1.0s." << endl;
+		}
+		else{
+			cout << "[FrontierFinder]: Update period is set to: " << this->updatePeriod_ << "s." << endl;
+		}
+
+		// smaller clusters are noise of the map
+		if (not this->nh_.getParam("frontier_finder/min_cluster_size", this->minClusterSize_)){
+			this->minClusterSize_ = 10;
+			cout << "[FrontierFinder]: No min cluster size param found. Use default: 10." << endl;
+		}
+		else{
+			cout << "[FrontierFinder]: Min cluster size is set to: " << this->minClusterSize_ << "." << endl;
+		}
+	}
+
+	void frontierFinder::setMap(const std::shared_ptr<mapManager::occMap>& map){
+		this->map_ = map;
+		this->region_.setResolution(this->map_->getRes());
+		this->frontier_.assign(this->region_.getNumVoxels(), 0);
+		this->frontierSet_.clear();
+	}
+
+	void frontierFinder::update(const Eigen::Vector3d& pos){
+		// the dirty box is only used here
+		this->region_.addPosition(pos);
+
+		ros::Time currTime = ros::Time::now();
+		if (this->lastUpdateTime_.isZero() or (currTime - this->lastUpdateTime_).toSec() >= this->updatePeriod_){
+			// the callback does not wait for the clustering. The update is done in the next call
+			std::unique_lock<std::mutex> lock (this->frontierMutex_, std::try_to_lock);
+			if (not lock.owns_lock()){
+				return;
+			}
+			this->updateFrontiers();
+			this->lastUpdateTime_ = currTime;
+		}
+	}
+
+	void frontierFinder::getClusters(const Eigen::Vector3d& pos, const std::shared_ptr<mapManager::occMap>& map, std::vector<AutoFlight::frontierCluster>& clusters){
+		clusters.clear();
+		std::lock_guard<std::mutex> lock (this->frontierMutex_);
+
+		std::unordered_set<int> visited;
+		std::vector<int> queue;
+		for (int seed : this->frontierSet_){
+			if (visited.count(seed)){
+				continue;
+			}
+
+			// flood fill the connected frontier voxels
+			visited.insert(seed);
+			queue.clear();
+			queue.push_back(seed);
+			for (size_t q=0; q<queue.size(); ++q){
+				Eigen::Vector3i idx = this->region_.toVoxel(queue[q]);
+				for (int dx=-1; dx<=1; ++dx){
+					for (int dy=-1; dy<=1; ++dy){
+						for (int dz=-1; dz<=1; ++dz){
+							Eigen::Vector3i nIdx = idx + Eigen::Vector3i (dx, dy, dz);
+							if (not this->region_.isInRegion(nIdx)){
+								continue;
+							}
+							int n = this->region_.toIndex(nIdx);
+							if (this->frontier_[n] and not visited.count(n)){
+								visited.insert(n);
+								queue.push_back(n);
+							}
+						}
+					}
+				}
+			}
+			if (int(queue.size()) < this->minClusterSize_){
+				continue;
+			}
+
+			AutoFlight::frontierCluster cluster;
+			cluster.size = queue.size();
+			cluster.centroid.setZero();
+			for (int i : queue){
+				cluster.centroid += this->region_.toPos(this->region_.toVoxel(i));
+			}
+			cluster.centroid /= double(cluster.size);
+
+			// the goal is the reachable voxel closest to the centroid (the centroid of a curved frontier can be off the frontier)
+			double minDist = std::numeric_limits<double>::infinity();
+			bool hasGoal = false;
+			for (int i : queue){
+				Eigen::Vector3d p = this->region_.toPos(this->region_.toVoxel(i));
+				double dist = (p - cluster.centroid).norm();
+				if (dist < minDist and map->isInMap(p) and map->isFree(p) and not map->isInflatedOccupied(p)){
+					minDist = dist;
+					cluster.goal = p;
+					hasGoal = true;
+				}
+			}
+			if (hasGoal){
+				clusters.push_back(cluster);
+			}
+		}
+
+		std::sort(clusters.begin(), clusters.end(), [&pos](const AutoFlight::frontierCluster& c1, const AutoFlight::frontierCluster& c2){
+			return (c1.centroid - pos).norm() < (c2.centroid - pos).norm();
+		});
+	}
+
+	int frontierFinder::getNumFrontiers(){
+		std::lock_guard<std::mutex> lock (this->frontierMutex_);
+		return this->frontierSet_.size();
+	}
+
+	void frontierFinder::updateFrontiers(){
+		if (not this->map_){
+			return;
+		}
+
+		// one more voxel for the frontiers next to the changed voxels
+		Eigen::Vector3i idxMin, idxMax;
+		if (not this->region_.getDirtyRange(idxMin, idxMax, this->region_.getRes())){
+			return;
+		}
+
+		for (int x=idxMin(0); x<=idxMax(0); ++x){
+			for (int y=idxMin(1); y<=idxMax(1); ++y){
+				for (int z=idxMin(2); z<=idxMax(2); ++z){
+					Eigen::Vector3i idx (x, y, z);
+					int i = this->region_.toIndex(idx);
+					uint8_t frontier = this->isFrontier(idx);
+					if (frontier != this->frontier_[i]){
+						this->frontier_[i] = frontier;
+						if (frontier){
+							this->frontierSet_.insert(i);
+						}
+						else{
+							this->frontierSet_.erase(i);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	bool frontierFinder::isFrontier(const Eigen::Vector3i& idx){
+		Eigen::Vector3d p = this->region_.toPos(idx);
+		if (not this->map_->isInMap(p) or not this->map_->isFree(p)){
+			return false;
+		}
+
+		// unknown neighbors outside the region are not explored
+		static const Eigen::Vector3i neighbors[6] = {Eigen::Vector3i (1, 0, 0), Eigen::Vector3i (-1, 0, 0), Eigen::Vector3i (0, 1, 0),
+		                                             Eigen::Vector3i (0, -1, 0), Eigen::Vector3i (0, 0, 1), Eigen::Vector3i (0, 0, -1)};
+		for (const Eigen::Vector3i& n : neighbors){
+			Eigen::Vector3i nIdx = idx + n;
+			if (not this->region_.isInRegion(nIdx)){
+				continue;
+			}
+			Eigen::Vector3d pn = this->region_.toPos(nIdx);
+			if (this->map_->isInMap(pn) and this->map_->isUnknown(pn)){
+				return true;
+			}
+		}
+		return false;
+	}
+}
@@ -0,0 +1,67 @@
+/*
+	FILE: frontierFinder.h
+	------------------------
+	frontier voxels of the exploration region and their clusters
+*/
+
+#ifndef AUTOFLIGHT_FRONTIER_FINDER_H
+#define AUTOFLIGHT_FRONTIER_FINDER_H
+#include <ros/ros.h>
+#include <map_manager/occupancyMap.h>
+#include <autonomous_flight/px4/dirtyRegionTracker.h>
+#include <Eigen/Dense>
+#include <vector>
+#include <unordered_set>
+#include <memory>
+#include <mutex>
+
+using std::cout; using std::endl;
+namespace AutoFlight{
+	struct frontierCluster{
+		Eigen::Vector3d centroid;
+		Eigen::Vector3d goal; // free frontier voxel closest to the centroid
+		int size = 0;
+	};
+
+	/*
+		A frontier voxel is a free voxel next to an unknown voxel of the global region. The frontier
+		flags are kept incrementally, each update only rechecks the dirty region since the last update.
+		The clusters (26-connected frontier voxels) are built from the frontier set on request. The
+		frontiers are updated in the ROS callbacks and the clusters can be built in another thread on a
+		map snapshot, so the frontier data is locked.
+	*/
+	class frontierFinder{
+	private:
+		ros::NodeHandle nh_;
+		std::shared_ptr<mapManager::occMap> map_;
+
+		// parameters
+		double updatePeriod_;
+		int minClusterSize_;
+
+		// frontier data
+		AutoFlight::dirtyRegionTracker region_;
+		std::vector<uint8_t> frontier_;
+		std::unordered_set<int> frontierSet_;
+		std::mutex frontierMutex_;
+		ros::Time lastUpdateTime_;
+
+	public:
+		frontierFinder(const ros::NodeHandle& nh);
+		void initParam();
+		void setMap(const std::shared_ptr<mapManager::occMap>& map);
+
+		// robot position at the rate of the caller. The frontiers are rechecked every update period
+		void update(const Eigen::Vector3d& pos);
+
+		// clusters of the last update with the goals free in the given map. Sorted by the distance of the centroid to the position
+		void getClusters(const Eigen::Vector3d& pos, const std::shared_ptr<mapManager::occMap>& map, std::vector<AutoFlight::frontierCluster>& clusters);
+		int getNumFrontiers();
+
+	private:
+		void updateFrontiers();
+		bool isFrontier(const Eigen::Vector3i& idx);
+	};
+}
+
+#endif
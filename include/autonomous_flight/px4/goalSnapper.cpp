@@ -0,0 +1,159 @@
+/*
+	FILE: goalSnapper.cpp
+	------------------------
+	goal snapping implementation
+*/
+#include <autonomous_flight/px4/goalSnapper.h>
+#include <limits>
+
+namespace AutoFlight{
+	goalSnapper::goalSnapper(){}
+
+	void goalSnapper::setMap(const std::shared_ptr<mapManager::occMap>& map){
+		this->map_ = map;
+		this->res_ = this->map_->getRes();
+		this->allocate();
+	}
+
+	void goalSnapper::setRadius(double radius){
+		this->radius_ = radius;
+		if (this->map_ != NULL){
+			this->allocate();
+		}
+	}
+
+	void goalSnapper::allocate(){
+		this->halfSize_ = int(std::ceil(this->radius_/this->res_));
+		this->windowSize_ = 2 * this->halfSize_ + 1;
+		this->visited_.assign(this->windowSize_ * this->windowSize_, 0);
+		this->queue_.clear();
+		this->queue_.reserve(this->windowSize_ * this->windowSize_);
+		this->reachHalfSize_ = 2 * this->halfSize_;
+		this->reachWindowSize_ = 2 * this->reachHalfSize_ + 1;
+		this->reachVisited_.assign(this->reachWindowSize_ * this->reachWindowSize_, 0);
+		this->reachable_.assign(this->reachWindowSize_ * this->reachWindowSize_, 0);
+		this->reachQueue_.clear();
+		this->reachQueue_.reserve(this->reachWindowSize_ * this->reachWindowSize_);
+		this->stamp_ = 0;
+	}
+
+	bool goalSnapper::isValid(const Eigen::Vector3d& pos){
+		return this->map_->isInMap(pos) and not this->map_->isInflatedOccupied(pos) and not this->map_->isUnknown(pos);
+	}
+
+	bool goalSnapper::snap(const Eigen::Vector3d& start, const Eigen::Vector3d& goal, Eigen::Vector3d& goalSnapped){
+		goalSnapped = goal;
+		++this->stamp_;
+		if (this->stamp_ == 0){
+			std::fill(this->visited_.begin(), this->visited_.end(), 0);
+			std::fill(this->reachVisited_.begin(), this->reachVisited_.end(), 0);
+			this->stamp_ = 1;
+		}
+
+		// the start projected to the slice of the goal
+		Eigen::Vector2i startCell (int(std::round((start(0) - goal(0))/this->res_)), int(std::round((start(1) - goal(1))/this->res_)));
+		if (this->isValid(goal) and this->isReachable(Eigen::Vector2i (0, 0), startCell, goal)){
+			return true;
+		}
+
+		// cells are offsets from the goal in the search window. the queue is a flat array reused between calls
+		this->queue_.clear();
+		this->queue_.push_back(Eigen::Vector2i (0, 0));
+		this->visited_[this->halfSize_ * this->windowSize_ + this->halfSize_] = this->stamp_;
+		const int dx[4] = {1, -1, 0, 0};
+		const int dy[4] = {0, 0, 1, -1};
+		double radiusSqr = std::pow(this->radius_/this->res_, 2);
+		double bestDistSqr = std::numeric_limits<double>::infinity();
+		bool found = false;
+		size_t head = 0;
+		size_t levelEnd = 1;
+		while (head < this->queue_.size()){
+			Eigen::Vector2i cell = this->queue_[head];
+			++head;
+
+			Eigen::Vector3d p (goal(0) + cell(0) * this->res_, goal(1) + cell(1) * this->res_, goal(2));
+			double distSqr = cell.squaredNorm();
+			bool valid = this->isValid(p);
+			if (valid and this->isReachable(cell, startCell, goal)){
+				// a free cell grown from the goal region borders free space. keep the closest one of this BFS level
+				if (distSqr < bestDistSqr){
+					bestDistSqr = distSqr;
+					goalSnapped = p;
+					found = true;
+				}
+			}
+			else if (this->map_->isInMap(p)){ // obstacles, unknown space and free pockets cut off from the start
+				for (int i=0; i<4; ++i){
+					Eigen::Vector2i next (cell(0) + dx[i], cell(1) + dy[i]);
+					if (std::abs(next(0)) > this->halfSize_ or std::abs(next(1)) > this->halfSize_) continue;
+					if (next.squaredNorm() > radiusSqr) continue;
+					int idx = (next(1) + this->halfSize_) * this->windowSize_ + (next(0) + this->halfSize_);
+					if (this->visited_[idx] == this->stamp_) continue;
+					this->visited_[idx] = this->stamp_;
+					this->queue_.push_back(next);
+				}
+			}
+
+			if (head == levelEnd){
+				if (found){
+					return true;
+				}
+				levelEnd = this->queue_.size();
+			}
+		}
+		return found;
+	}
+
+	bool goalSnapper::isReachable(const Eigen::Vector2i& cell, const Eigen::Vector2i& startCell, const Eigen::Vector3d& goal){
+		/*
+			Flood fill the free component of the cell on the slice. It is connected to the start if it
+			contains the start or leaves the window (the way from there is left to the planner).
+			A free pocket enclosed by obstacles or unknown space is rejected
+		*/
+		int rIdx = (cell(1) + this->reachHalfSize_) * this->reachWindowSize_ + (cell(0) + this->reachHalfSize_);
+		if (this->reachVisited_[rIdx] == this->stamp_){ // the component is already checked in this search
+			return this->reachable_[rIdx];
+		}
+
+		const int dx[4] = {1, -1, 0, 0};
+		const int dy[4] = {0, 0, 1, -1};
+		bool reachable = false;
+		this->reachQueue_.clear();
+		this->componentCells_.clear();
+		this->reachQueue_.push_back(cell);
+		this->reachVisited_[rIdx] = this->stamp_;
+		size_t head = 0;
+		while (head < this->reachQueue_.size() and not reachable){
+			Eigen::Vector2i c = this->reachQueue_[head];
+			++head;
+			this->componentCells_.push_back((c(1) + this->reachHalfSize_) * this->reachWindowSize_ + (c(0) + this->reachHalfSize_));
+			if (c == startCell){
+				reachable = true;
+				break;
+			}
+			for (int i=0; i<4; ++i){
+				Eigen::Vector2i next (c(0) + dx[i], c(1) + dy[i]);
+				Eigen::Vector3d p (goal(0) + next(0) * this->res_, goal(1) + next(1) * this->res_, goal(2));
+				if (not this->isValid(p)) continue;
+				if (std::abs(next(0)) > this->reachHalfSize_ or std::abs(next(1)) > this->reachHalfSize_){
+					reachable = true;
+					break;
+				}
+				int idx = (next(1) + this->reachHalfSize_) * this->reachWindowSize_ + (next(0) + this->reachHalfSize_);
+				if (this->reachVisited_[idx] == this->stamp_) continue;
+				this->reachVisited_[idx] = this->stamp_;
+				this->reachQueue_.push_back(next);
+			}
+		}
+
+		// the queued cells of an interrupted fill belong to the same component
+		for (size_t i=head; i<this->reachQueue_.size(); ++i){
+			Eigen::Vector2i c = this->reachQueue_[i];
+			this->componentCells_.push_back((c(1) + this->reachHalfSize_) * this->reachWindowSize_ + (c(0) + this->reachHalfSize_));
+		}
+		for (int idx : this->componentCells_){
+			this->reachable_[idx] = reachable;
+		}
+		return reachable;
+	}
+}
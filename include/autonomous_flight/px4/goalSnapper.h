@@ -0,0 +1,52 @@
+/*
+	FILE: goalSnapper.h
+	------------------------
+	snap a goal inside obstacles to the nearest free and reachable position
+*/
+
+#ifndef AUTOFLIGHT_GOAL_SNAPPER_H
+#define AUTOFLIGHT_GOAL_SNAPPER_H
+#include <map_manager/occupancyMap.h>
+#include <Eigen/Dense>
+#include <vector>
+#include <memory>
+
+namespace AutoFlight{
+	class goalSnapper{
+	private:
+		std::shared_ptr<mapManager::occMap> map_;
+		double res_ = 0.1;
+		double radius_ = 1.0;
+		int halfSize_ = 0; // search window half size in cells
+		int windowSize_ = 0;
+
+		// the visited sets are allocated once and invalidated by bumping the stamp
+		unsigned int stamp_ = 0;
+		std::vector<unsigned int> visited_;
+		std::vector<Eigen::Vector2i> queue_;
+
+		// free components of the slice checked for the connection to the start (twice the search window)
+		int reachHalfSize_ = 0;
+		int reachWindowSize_ = 0;
+		std::vector<unsigned int> reachVisited_;
+		std::vector<uint8_t> reachable_; // result of the component, valid for the cells of this stamp
+		std::vector<Eigen::Vector2i> reachQueue_;
+		std::vector<int> componentCells_;
+
+	public:
+		goalSnapper();
+		void setMap(const std::shared_ptr<mapManager::occMap>& map);
+		void setRadius(double radius);
+
+		// known free and not inflated occupied. unknown space is treated as occupied
+		bool isValid(const Eigen::Vector3d& pos);
+		// breadth first search on the horizontal slice of the goal. return false if no free position connected to the start within the radius
+		bool snap(const Eigen::Vector3d& start, const Eigen::Vector3d& goal, Eigen::Vector3d& goalSnapped);
+
+	private:
+		void allocate();
+		bool isReachable(const Eigen::Vector2i& cell, const Eigen::Vector2i& startCell, const Eigen::Vector3d& goal);
+	};
+}
+
+#endif
@@ -0,0 +1,494 @@
+/*
+	FILE: gridPlanner.cpp
+	------------------------
+	grid planner implementation
+*/
+#include <autonomous_flight/px4/gridPlanner.h>
+#include <queue>
+#include <algorithm>
+#include <limits>
+
+namespace AutoFlight{
+	gridPlanner::gridPlanner(const ros::NodeHandle& nh) : nh_(nh){
+		this->initParam();
+	}
+
+	void gridPlanner::initParam(){
+		// planning height of the 2D slice
+		if (not this->nh_.getParam("grid_planner/height", this->height_)){
+			this->height_ = 1.0;
+			cout << "[GridPlanner]: No height param found. Use default: 1.0 m." << endl;
+		}
+		else{
+			cout << "[GridPlanner]: Height is set to: " << this->height_ << "m." << endl;
+		}
+
+		// environment box (x, y). It is clipped by the map range
+		std::vector<double> envBoxDefault {-100, 100, -100, 100};
+		if (not this->nh_.getParam("grid_planner/env_box", this->envBox_)){
+			this->envBox_ = envBoxDefault;
+			cout << "[GridPlanner]: No env box param found. Use default: [-100, 100, -100, 100]." << endl;
+		}
+		else{
+			if (this->envBox_.size() < 4){
+				this->envBox_ = envBoxDefault;
+				cout << "[GridPlanner]: Invalid env box param. Use default: [-100, 100, -100, 100]." << endl;
+			}
+			else{
+				cout << "[GridPlanner]: Env box is set to: [" << this->envBox_[0] << ", " << this->envBox_[1] << ", " << this->envBox_[2] << ", " << this->envBox_[3] << "]." << endl;
+			}
+		}
+
+		// ignore unknown
+		if (not this->nh_.getParam("grid_planner/ignore_unknown", this->ignoreUnknown_)){
+			this->ignoreUnknown_ = true;
+			cout << "[GridPlanner]: No ignore unknown param found. Use default: true." << endl;
+		}
+		else{
+			cout << "[GridPlanner]: Ignore unknown is set to: " << this->ignoreUnknown_ << "." << endl;
+		}
+
+		// use jump point search (plain A* otherwise)
+		if (not this->nh_.getParam("grid_planner/use_jps", this->useJPS_)){
+			this->useJPS_ = true;
+			cout << "[GridPlanner]: No use JPS param found. Use default: true." << endl;
+		}
+		else{
+			cout << "[GridPlanner]: Use JPS is set to: " << this->useJPS_ << "." << endl;
+		}
+
+		// maximum shortcut distance
+		if (not this->nh_.getParam("grid_planner/max_shortcut_dist", this->maxShortcutDist_)){
+			this->maxShortcutDist_ = 5.0;
+			cout << "[GridPlanner]: No max shortcut dist param found. Use default: 5.0 m." << endl;
+		}
+		else{
+			cout << "[GridPlanner]: Max shortcut dist is set to: " << this->maxShortcutDist_ << "m." << endl;
+		}
+
+		// timeout
+		if (not this->nh_.getParam("grid_planner/timeout", this->timeout_)){
+			this->timeout_ = 0.1;
+			cout << "[GridPlanner]: No timeout param found. Use default: 0.1 s." << endl;
+		}
+		else{
+			cout << "[GridPlanner]: Timeout is set to: " << this->timeout_ << "s." << endl;
+		}
+	}
+
+	void gridPlanner::setMap(const std::shared_ptr<mapManager::occMap>& map){
+		this->map_ = map;
+		this->res_ = this->map_->getRes();
+		this->resetGrid();
+	}
+
+	void gridPlanner::resetGrid(){
+		Eigen::Vector3d mapMin, mapMax;
+		this->map_->getMapRange(mapMin, mapMax);
+		this->envBox_[0] = std::max(this->envBox_[0], mapMin(0));
+		this->envBox_[1] = std::min(this->envBox_[1], mapMax(0));
+		this->envBox_[2] = std::max(this->envBox_[2], mapMin(1));
+		this->envBox_[3] = std::min(this->envBox_[3], mapMax(1));
+
+		this->sizeX_ = std::max(int(std::ceil((this->envBox_[1] - this->envBox_[0])/this->res_)), 0);
+		this->sizeY_ = std::max(int(std::ceil((this->envBox_[3] - this->envBox_[2])/this->res_)), 0);
+		int numCells = this->sizeX_ * this->sizeY_;
+		this->cellStamp_.assign(numCells, 0);
+		this->cellFree_.assign(numCells, 0);
+		this->nodeStamp_.assign(numCells, 0);
+		this->gScore_.assign(numCells, 0.0);
+		this->parent_.assign(numCells, -1);
+		this->closed_.assign(numCells, false);
+		this->searchId_ = 0;
+		cout << "[GridPlanner]: Grid size: " << this->sizeX_ << "x" << this->sizeY_ << "." << endl;
+	}
+
+	void gridPlanner::updateStart(const geometry_msgs::Pose& start){
+		this->start_(0) = start.position.x;
+		this->start_(1) = start.position.y;
+		this->start_(2) = start.position.z;
+	}
+
+	void gridPlanner::updateGoal(const geometry_msgs::Pose& goal){
+		this->goal_(0) = goal.position.x;
+		this->goal_(1) = goal.position.y;
+		this->goal_(2) = this->height_;
+	}
+
+	void gridPlanner::makePlan(nav_msgs::Path& path){
+		std::vector<Eigen::Vector3d> plan;
+		path.poses.clear();
+		path.header.frame_id = "map";
+		path.header.stamp = ros::Time::now();
+		if (not this->makePlan(plan)){
+			return;
+		}
+
+		for (const Eigen::Vector3d& p : plan){
+			geometry_msgs::PoseStamped ps;
+			ps.header = path.header;
+			ps.pose.position.x = p(0);
+			ps.pose.position.y = p(1);
+			ps.pose.position.z = p(2);
+			ps.pose.orientation.w = 1.0;
+			path.poses.push_back(ps);
+		}
+	}
+
+	bool gridPlanner::makePlan(std::vector<Eigen::Vector3d>& path){
+		path.clear();
+		if (this->map_ == NULL){
+			cout << "[GridPlanner]: No map is set." << endl;
+			return false;
+		}
+
+		ros::Time startTime = ros::Time::now();
+		++this->searchId_;
+		if (this->searchId_ == 0){ // stamp wrapped around. clear all stamps once
+			std::fill(this->cellStamp_.begin(), this->cellStamp_.end(), 0);
+			std::fill(this->nodeStamp_.begin(), this->nodeStamp_.end(), 0);
+			this->searchId_ = 1;
+		}
+
+		int sx, sy;
+		Eigen::Vector3d startSlice (this->start_(0), this->start_(1), this->height_);
+		if (not this->posToGrid(startSlice, sx, sy)){
+			cout << "[GridPlanner]: Start is out of the planning range." << endl;
+			return false;
+		}
+		if (not this->posToGrid(this->goal_, this->goalX_, this->goalY_)){
+			cout << "[GridPlanner]: Goal is out of the planning range." << endl;
+			return false;
+		}
+
+		// the robot may sit inside the inflated region. always allow leaving the start cell
+		int startIdx = this->toIndex(sx, sy);
+		this->cellStamp_[startIdx] = this->searchId_;
+		this->cellFree_[startIdx] = 1;
+
+		if (not this->isFree(this->goalX_, this->goalY_)){
+			cout << "[GridPlanner]: Goal is not free." << endl;
+			return false;
+		}
+
+		std::vector<Eigen::Vector2i> gridPath;
+		bool success = this->search(sx, sy, gridPath);
+		this->lastPlanTime_ = (ros::Time::now() - startTime).toSec();
+		if (not success){
+			cout << "[GridPlanner]: No path found. Time: " << this->lastPlanTime_ << "s, expanded: " << this->numExpanded_ << "." << endl;
+			return false;
+		}
+
+		std::vector<Eigen::Vector3d> rawPath;
+		rawPath.push_back(this->start_);
+		for (size_t i=1; i<gridPath.size(); ++i){
+			rawPath.push_back(this->gridToPos(gridPath[i](0), gridPath[i](1)));
+		}
+		if (rawPath.size() == 1){
+			rawPath.push_back(this->goal_);
+		}
+		else{
+			rawPath.back() = this->goal_;
+		}
+		this->shortcutPath(rawPath, path);
+		this->lastPlanTime_ = (ros::Time::now() - startTime).toSec();
+		cout << "[GridPlanner]: Path found. Time: " << this->lastPlanTime_ << "s, expanded: " << this->numExpanded_ << ", waypoints: " << path.size() << "." << endl;
+		return true;
+	}
+
+	int gridPlanner::getNumExpanded(){
+		return this->numExpanded_;
+	}
+
+	double gridPlanner::getLastPlanTime(){
+		return this->lastPlanTime_;
+	}
+
+	bool gridPlanner::isInGrid(int x, int y){
+		return x >= 0 and x < this->sizeX_ and y >= 0 and y < this->sizeY_;
+	}
+
+	int gridPlanner::toIndex(int x, int y){
+		return y * this->sizeX_ + x;
+	}
+
+	bool gridPlanner::isFree(int x, int y){
+		if (not this->isInGrid(x, y)){
+			return false;
+		}
+		int idx = this->toIndex(x, y);
+		if (this->cellStamp_[idx] != this->searchId_){
+			// evaluate the cell from the occupancy map only when the search touches it
+			Eigen::Vector3d p = this->gridToPos(x, y);
+			bool free = this->map_->isInMap(p) and not this->map_->isInflatedOccupied(p);
+			if (free and not this->ignoreUnknown_){
+				free = not this->map_->isUnknown(p);
+			}
+			this->cellFree_[idx] = free;
+			this->cellStamp_[idx] = this->searchId_;
+		}
+		return this->cellFree_[idx];
+	}
+
+	bool gridPlanner::posToGrid(const Eigen::Vector3d& pos, int& x, int& y){
+		x = int(std::floor((pos(0) - this->envBox_[0])/this->res_));
+		y = int(std::floor((pos(1) - this->envBox_[2])/this->res_));
+		return this->isInGrid(x, y);
+	}
+
+	Eigen::Vector3d gridPlanner::gridToPos(int x, int y){
+		Eigen::Vector3d pos;
+		pos(0) = this->envBox_[0] + (x + 0.5) * this->res_;
+		pos(1) = this->envBox_[2] + (y + 0.5) * this->res_;
+		pos(2) = this->height_;
+		return pos;
+	}
+
+	double gridPlanner::heuristic(int x, int y){
+		// octile distance
+		int dx = std::abs(x - this->goalX_);
+		int dy = std::abs(y - this->goalY_);
+		return ((std::max(dx, dy) - std::min(dx, dy)) + std::sqrt(2.0) * std::min(dx, dy)) * this->res_;
+	}
+
+	bool gridPlanner::search(int sx, int sy, std::vector<Eigen::Vector2i>& gridPath){
+		typedef std::pair<double, int> queueNode; // (f score, cell index)
+		std::priority_queue<queueNode, std::vector<queueNode>, std::greater<queueNode>> open;
+
+		int startIdx = this->toIndex(sx, sy);
+		int goalIdx = this->toIndex(this->goalX_, this->goalY_);
+		this->nodeStamp_[startIdx] = this->searchId_;
+		this->gScore_[startIdx] = 0.0;
+		this->parent_[startIdx] = -1;
+		this->closed_[startIdx] = false;
+		open.push(queueNode(this->heuristic(sx, sy), startIdx));
+
+		ros::Time startTime = ros::Time::now();
+		this->numExpanded_ = 0;
+		std::vector<Eigen::Vector2i> successors;
+		while (not open.empty()){
+			int idx = open.top().second;
+			open.pop();
+			if (this->closed_[idx]){
+				continue;
+			}
+			this->closed_[idx] = true;
+
+			if (idx == goalIdx){
+				gridPath.clear();
+				for (int i=idx; i!=-1; i=this->parent_[i]){
+					gridPath.push_back(Eigen::Vector2i (i % this->sizeX_, i / this->sizeX_));
+				}
+				std::reverse(gridPath.begin(), gridPath.end());
+				return true;
+			}
+
+			++this->numExpanded_;
+			if (this->numExpanded_ % 1000 == 0 and (ros::Time::now() - startTime).toSec() > this->timeout_){
+				return false;
+			}
+
+			int x = idx % this->sizeX_;
+			int y = idx / this->sizeX_;
+			int px = -1, py = -1;
+			if (this->parent_[idx] != -1){
+				px = this->parent_[idx] % this->sizeX_;
+				py = this->parent_[idx] / this->sizeX_;
+			}
+
+			if (this->useJPS_){
+				this->getSuccessors(x, y, px, py, successors);
+			}
+			else{
+				this->getNeighbors(x, y, -1, -1, successors);
+			}
+
+			for (const Eigen::Vector2i& s : successors){
+				int sIdx = this->toIndex(s(0), s(1));
+				double g = this->gScore_[idx] + (s - Eigen::Vector2i (x, y)).cast<double>().norm() * this->res_;
+				if (this->nodeStamp_[sIdx] != this->searchId_){
+					this->nodeStamp_[sIdx] = this->searchId_;
+					this->closed_[sIdx] = false;
+				}
+				else if (this->closed_[sIdx] or g >= this->gScore_[sIdx]){
+					continue;
+				}
+				this->gScore_[sIdx] = g;
+				this->parent_[sIdx] = idx;
+				open.push(queueNode(g + this->heuristic(s(0), s(1)), sIdx));
+			}
+		}
+		return false;
+	}
+
+	void gridPlanner::getSuccessors(int x, int y, int px, int py, std::vector<Eigen::Vector2i>& successors){
+		std::vector<Eigen::Vector2i> neighbors;
+		this->getNeighbors(x, y, px, py, neighbors);
+		successors.clear();
+		for (const Eigen::Vector2i& n : neighbors){
+			int jx, jy;
+			int dx = n(0) - x;
+			int dy = n(1) - y;
+			if (this->jump(n(0), n(1), dx, dy, jx, jy)){
+				successors.push_back(Eigen::Vector2i (jx, jy));
+			}
+		}
+	}
+
+	void gridPlanner::getNeighbors(int x, int y, int px, int py, std::vector<Eigen::Vector2i>& neighbors){
+		// diagonal moves are only allowed when both adjacent straight cells are free (no corner cutting)
+		neighbors.clear();
+		if (px == -1){
+			bool freeXp = this->isFree(x+1, y);
+			bool freeXn = this->isFree(x-1, y);
+			bool freeYp = this->isFree(x, y+1);
+			bool freeYn = this->isFree(x, y-1);
+			if (freeXp) neighbors.push_back(Eigen::Vector2i (x+1, y));
+			if (freeXn) neighbors.push_back(Eigen::Vector2i (x-1, y));
+			if (freeYp) neighbors.push_back(Eigen::Vector2i (x, y+1));
+			if (freeYn) neighbors.push_back(Eigen::Vector2i (x, y-1));
+			if (freeXp and freeYp and this->isFree(x+1, y+1)) neighbors.push_back(Eigen::Vector2i (x+1, y+1));
+			if (freeXp and freeYn and this->isFree(x+1, y-1)) neighbors.push_back(Eigen::Vector2i (x+1, y-1));
+			if (freeXn and freeYp and this->isFree(x-1, y+1)) neighbors.push_back(Eigen::Vector2i (x-1, y+1));
+			if (freeXn and freeYn and this->isFree(x-1, y-1)) neighbors.push_back(Eigen::Vector2i (x-1, y-1));
+			return;
+		}
+
+		// pruned neighbors according to the travel direction
+		int dx = (x > px) - (x < px);
+		int dy = (y > py) - (y < py);
+		if (dx != 0 and dy != 0){
+			bool freeX = this->isFree(x+dx, y);
+			bool freeY = this->isFree(x, y+dy);
+			if (freeY) neighbors.push_back(Eigen::Vector2i (x, y+dy));
+			if (freeX) neighbors.push_back(Eigen::Vector2i (x+dx, y));
+			if (freeX and freeY and this->isFree(x+dx, y+dy)) neighbors.push_back(Eigen::Vector2i (x+dx, y+dy));
+		}
+		else if (dx != 0){
+			bool freeNext = this->isFree(x+dx, y);
+			bool freeUp = this->isFree(x, y+1);
+			bool freeDown = this->isFree(x, y-1);
+			if (freeNext){
+				neighbors.push_back(Eigen::Vector2i (x+dx, y));
+				if (freeUp and this->isFree(x+dx, y+1)) neighbors.push_back(Eigen::Vector2i (x+dx, y+1));
+				if (freeDown and this->isFree(x+dx, y-1)) neighbors.push_back(Eigen::Vector2i (x+dx, y-1));
+			}
+			if (freeUp) neighbors.push_back(Eigen::Vector2i (x, y+1));
+			if (freeDown) neighbors.push_back(Eigen::Vector2i (x, y-1));
+		}
+		else{
+			bool freeNext = this->isFree(x, y+dy);
+			bool freeRight = this->isFree(x+1, y);
+			bool freeLeft = this->isFree(x-1, y);
+			if (freeNext){
+				neighbors.push_back(Eigen::Vector2i (x, y+dy));
+				if (freeRight and this->isFree(x+1, y+dy)) neighbors.push_back(Eigen::Vector2i (x+1, y+dy));
+				if (freeLeft and this->isFree(x-1, y+dy)) neighbors.push_back(Eigen::Vector2i (x-1, y+dy));
+			}
+			if (freeRight) neighbors.push_back(Eigen::Vector2i (x+1, y));
+			if (freeLeft) neighbors.push_back(Eigen::Vector2i (x-1, y));
+		}
+	}
+
+	bool gridPlanner::jump(int x, int y, int dx, int dy, int& jx, int& jy){
+		// iterative jump. diagonal jumps only recurse one level into straight jumps
+		while (true){
+			if (not this->isFree(x, y)){
+				return false;
+			}
+			if (x == this->goalX_ and y == this->goalY_){
+				jx = x; jy = y;
+				return true;
+			}
+
+			if (dx != 0 and dy != 0){
+				int tx, ty;
+				if (this->jump(x+dx, y, dx, 0, tx, ty) or this->jump(x, y+dy, 0, dy, tx, ty)){
+					jx = x; jy = y;
+					return true;
+				}
+			}
+			else if (dx != 0){
+				if ((this->isFree(x, y-1) and not this->isFree(x-dx, y-1)) or (this->isFree(x, y+1) and not this->isFree(x-dx, y+1))){
+					jx = x; jy = y;
+					return true;
+				}
+			}
+			else{
+				if ((this->isFree(x-1, y) and not this->isFree(x-1, y-dy)) or (this->isFree(x+1, y) and not this->isFree(x+1, y-dy))){
+					jx = x; jy = y;
+					return true;
+				}
+			}
+
+			if (not (this->isFree(x+dx, y) and this->isFree(x, y+dy))){
+				return false;
+			}
+			x += dx;
+			y += dy;
+		}
+	}
+
+	bool gridPlanner::isLineFree(const Eigen::Vector3d& p1, const Eigen::Vector3d& p2){
+		// walk through every grid cell crossed by the segment. passing exactly through a corner requires both side cells
+		int x, y, ex, ey;
+		if (not this->posToGrid(p1, x, y) or not this->posToGrid(p2, ex, ey)){
+			return false;
+		}
+		double dx = p2(0) - p1(0);
+		double dy = p2(1) - p1(1);
+		int stepX = (dx > 0) - (dx < 0);
+		int stepY = (dy > 0) - (dy < 0);
+		double inf = std::numeric_limits<double>::infinity();
+		double tMaxX = (stepX != 0) ? (this->envBox_[0] + (x + (stepX > 0)) * this->res_ - p1(0))/dx : inf;
+		double tMaxY = (stepY != 0) ? (this->envBox_[2] + (y + (stepY > 0)) * this->res_ - p1(1))/dy : inf;
+		double tDeltaX = (stepX != 0) ? this->res_/std::abs(dx) : inf;
+		double tDeltaY = (stepY != 0) ? this->res_/std::abs(dy) : inf;
+		const double eps = 1e-9;
+		int maxStep = std::abs(ex - x) + std::abs(ey - y);
+		for (int i=0; i<maxStep and (x != ex or y != ey); ++i){
+			if (tMaxX < tMaxY - eps){
+				x += stepX;
+				tMaxX += tDeltaX;
+			}
+			else if (tMaxY < tMaxX - eps){
+				y += stepY;
+				tMaxY += tDeltaY;
+			}
+			else{
+				if (not this->isFree(x+stepX, y) or not this->isFree(x, y+stepY)){
+					return false;
+				}
+				x += stepX;
+				y += stepY;
+				tMaxX += tDeltaX;
+				tMaxY += tDeltaY;
+			}
+			if (not this->isFree(x, y)){
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void gridPlanner::shortcutPath(const std::vector<Eigen::Vector3d>& path, std::vector<Eigen::Vector3d>& pathSc){
+		// greedy line-of-sight shortcut. the next raw waypoint is always kept as fallback since the grid path is valid
+		pathSc.clear();
+		if (path.size() == 0){
+			return;
+		}
+		size_t currIdx = 0;
+		pathSc.push_back(path[0]);
+		while (currIdx < path.size()-1){
+			size_t nextIdx = currIdx + 1;
+			for (size_t i=path.size()-1; i>currIdx+1; --i){
+				if ((path[i] - path[currIdx]).norm() <= this->maxShortcutDist_ and this->isLineFree(path[currIdx], path[i])){
+					nextIdx = i;
+					break;
+				}
+			}
+			pathSc.push_back(path[nextIdx]);
+			currIdx = nextIdx;
+		}
+	}
+}
@@ -0,0 +1,81 @@
+/*
+	FILE: gridPlanner.h
+	------------------------
+	deterministic A* / jump point search global planner on the 2D occupancy slice
+*/
+
+#ifndef AUTOFLIGHT_GRID_PLANNER_H
+#define AUTOFLIGHT_GRID_PLANNER_H
+#include <ros/ros.h>
+#include <map_manager/occupancyMap.h>
+#include <nav_msgs/Path.h>
+#include <geometry_msgs/Pose.h>
+#include <Eigen/Dense>
+#include <vector>
+#include <memory>
+
+using std::cout; using std::endl;
+namespace AutoFlight{
+	class gridPlanner{
+	private:
+		ros::NodeHandle nh_;
+		std::shared_ptr<mapManager::occMap> map_;
+
+		// parameters
+		double res_;
+		double height_;
+		std::vector<double> envBox_; // xmin, xmax, ymin, ymax
+		bool ignoreUnknown_;
+		bool useJPS_;
+		double maxShortcutDist_;
+		double timeout_;
+
+		// grid data
+		int sizeX_ = 0;
+		int sizeY_ = 0;
+		unsigned int searchId_ = 0; // stamp of the current search. cells with an old stamp are untouched
+		std::vector<unsigned int> cellStamp_;
+		std::vector<unsigned char> cellFree_; // lazily evaluated occupancy of the slice
+		std::vector<unsigned int> nodeStamp_;
+		std::vector<double> gScore_;
+		std::vector<int> parent_;
+		std::vector<bool> closed_;
+
+		Eigen::Vector3d start_;
+		Eigen::Vector3d goal_;
+		int goalX_, goalY_;
+		int numExpanded_ = 0;
+		double lastPlanTime_ = 0.0;
+
+	public:
+		gridPlanner(const ros::NodeHandle& nh);
+		void initParam();
+		void setMap(const std::shared_ptr<mapManager::occMap>& map);
+		void updateStart(const geometry_msgs::Pose& start);
+		void updateGoal(const geometry_msgs::Pose& goal);
+		void makePlan(nav_msgs::Path& path);
+		bool makePlan(std::vector<Eigen::Vector3d>& path);
+
+		int getNumExpanded();
+		double getLastPlanTime();
+
+	private:
+		void resetGrid();
+		bool isFree(int x, int y);
+		bool isInGrid(int x, int y);
+		int toIndex(int x, int y);
+		bool posToGrid(const Eigen::Vector3d& pos, int& x, int& y);
+		Eigen::Vector3d gridToPos(int x, int y);
+		double heuristic(int x, int y);
+
+		bool search(int sx, int sy, std::vector<Eigen::Vector2i>& gridPath);
+		void getSuccessors(int x, int y, int px, int py, std::vector<Eigen::Vector2i>& successors);
+		void getNeighbors(int x, int y, int px, int py, std::vector<Eigen::Vector2i>& neighbors);
+		bool jump(int x, int y, int dx, int dy, int& jx, int& jy);
+
+		bool isLineFree(const Eigen::Vector3d& p1, const Eigen::Vector3d& p2);
+		void shortcutPath(const std::vector<Eigen::Vector3d>& path, std::vector<Eigen::Vector3d>& pathSc);
+	};
+}
+
+#endif
@@ -0,0 +1,272 @@
+/*
+	FILE: motionPrimitiveLibrary.cpp
+	------------------------
+	motion primitive library implementation
+*/
+#include <autonomous_flight/px4/motionPrimitiveLibrary.h>
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+namespace AutoFlight{
+	static const char primitiveFileMagic[4] = {'A', 'F', 'M', 'P'};
+	static const uint32_t primitiveFileVersion = 1;
+
+	motionPrimitiveLibrary::motionPrimitiveLibrary(){}
+
+	void motionPrimitiveLibrary::setMap(const std::shared_ptr<mapManager::occMap>& map){
+		this->map_ = map;
+	}
+
+	void motionPrimitiveLibrary::generate(double maxVel, double maxAcc, double speedRes, int numAccSamples, double duration, double sampleDt){
+		this->maxVel_ = maxVel;
+		this->maxAcc_ = maxAcc;
+		this->speedRes_ = speedRes;
+		this->sampleDt_ = sampleDt;
+		this->primitives_.clear();
+
+		numAccSamples = std::max(numAccSamples, 2);
+		int numSpeedBins = int(std::round(maxVel/speedRes)) + 1;
+		for (int s=0; s<numSpeedBins; ++s){
+			double speed = s * speedRes;
+			std::vector<motionPrimitive> prims;
+			for (int i=0; i<numAccSamples; ++i){
+				for (int j=0; j<numAccSamples; ++j){
+					motionPrimitive prim;
+					prim.acc(0) = -maxAcc + 2.0 * maxAcc * i/(numAccSamples-1);
+					prim.acc(1) = -maxAcc + 2.0 * maxAcc * j/(numAccSamples-1);
+					prim.duration = duration;
+					Eigen::Vector2d velEnd = Eigen::Vector2d (speed, 0.0) + prim.acc.cast<double>() * duration;
+					if (velEnd.norm() > maxVel + 1e-6){
+						continue;
+					}
+					this->samplePrimitive(prim, speed);
+					prims.push_back(prim);
+				}
+			}
+			this->primitives_.push_back(prims);
+		}
+	}
+
+	void motionPrimitiveLibrary::samplePrimitive(motionPrimitive& prim, double speed){
+		prim.samples.clear();
+		double totalDuration = this->getTotalDuration(prim, speed);
+		Eigen::Vector2d pos, vel, acc;
+		for (double t=this->sampleDt_; t<totalDuration; t+=this->sampleDt_){
+			this->getState(prim, speed, t, pos, vel, acc);
+			prim.samples.push_back(pos.cast<float>());
+		}
+		this->getState(prim, speed, totalDuration, pos, vel, acc);
+		prim.samples.push_back(pos.cast<float>());
+	}
+
+	bool motionPrimitiveLibrary::save(const std::string& filename){
+		std::ofstream file (filename, std::ios::binary);
+		if (not file.is_open()){
+			return false;
+		}
+		uint32_t numSpeedBins = this->primitives_.size();
+		file.write(primitiveFileMagic, 4);
+		file.write((const char*)&primitiveFileVersion, sizeof(uint32_t));
+		file.write((const char*)&this->maxVel_, sizeof(float));
+		file.write((const char*)&this->maxAcc_, sizeof(float));
+		file.write((const char*)&this->speedRes_, sizeof(float));
+		file.write((const char*)&this->sampleDt_, sizeof(float));
+		file.write((const char*)&numSpeedBins, sizeof(uint32_t));
+		for (const std::vector<motionPrimitive>& prims : this->primitives_){
+			uint32_t numPrims = prims.size();
+			file.write((const char*)&numPrims, sizeof(uint32_t));
+			for (const motionPrimitive& prim : prims){
+				uint32_t numSamples = prim.samples.size();
+				file.write((const char*)prim.acc.data(), 2 * sizeof(float));
+				file.write((const char*)&prim.duration, sizeof(float));
+				file.write((const char*)&numSamples, sizeof(uint32_t));
+				file.write((const char*)prim.samples.data(), numSamples * 2 * sizeof(float));
+			}
+		}
+		return file.good();
+	}
+
+	bool motionPrimitiveLibrary::load(const std::string& filename, double maxVel, double maxAcc){
+		std::ifstream file (filename, std::ios::binary | std::ios::ate);
+		if (not file.is_open()){
+			return false;
+		}
+
+		// every count is checked against the bytes left, so a truncated or foreign file is rejected before the allocation
+		std::streamoff remain = file.tellg();
+		file.seekg(0);
+		auto readBytes = [&file, &remain](void* data, std::streamoff size){
+			if (size > remain){
+				return false;
+			}
+			file.read((char*)data, size);
+			remain -= size;
+			return file.good();
+		};
+		char magic[4];
+		uint32_t version, numSpeedBins;
+		float libMaxVel, libMaxAcc, speedRes, sampleDt;
+		if (not readBytes(magic, 4) or not readBytes(&version, sizeof(uint32_t)) or std::memcmp(magic, primitiveFileMagic, 4) != 0 or version != primitiveFileVersion){
+			return false;
+		}
+		if (not readBytes(&libMaxVel, sizeof(float)) or not readBytes(&libMaxAcc, sizeof(float)) or not readBytes(&speedRes, sizeof(float))
+		    or not readBytes(&sampleDt, sizeof(float)) or not readBytes(&numSpeedBins, sizeof(uint32_t))){
+			return false;
+		}
+
+		// the library has to be generated for the flight limits
+		if (std::abs(libMaxVel - maxVel) > 1e-3 or std::abs(libMaxAcc - maxAcc) > 1e-3 or not (speedRes > 0.0) or not (sampleDt > 0.0)
+		    or numSpeedBins != uint32_t(std::round(libMaxVel/speedRes)) + 1){
+			return false;
+		}
+
+		std::vector<std::vector<motionPrimitive>> primitives;
+		for (uint32_t s=0; s<numSpeedBins; ++s){
+			uint32_t numPrims;
+			if (not readBytes(&numPrims, sizeof(uint32_t)) or numPrims * std::streamoff(2 * sizeof(float) + sizeof(float) + sizeof(uint32_t)) > remain){
+				return false;
+			}
+			std::vector<motionPrimitive> prims (numPrims);
+			for (motionPrimitive& prim : prims){
+				uint32_t numSamples;
+				if (not readBytes(prim.acc.data(), 2 * sizeof(float)) or not readBytes(&prim.duration, sizeof(float)) or not readBytes(&numSamples, sizeof(uint32_t))){
+					return false;
+				}
+				if (numSamples == 0 or numSamples * std::streamoff(2 * sizeof(float)) > remain){
+					return false;
+				}
+				prim.samples.resize(numSamples);
+				if (not readBytes(prim.samples.data(), numSamples * 2 * sizeof(float))){
+					return false;
+				}
+			}
+			primitives.push_back(prims);
+		}
+		if (remain != 0){
+			return false;
+		}
+		this->maxVel_ = libMaxVel;
+		this->maxAcc_ = libMaxAcc;
+		this->speedRes_ = speedRes;
+		this->sampleDt_ = sampleDt;
+		this->primitives_.swap(primitives);
+		return true;
+	}
+
+	bool motionPrimitiveLibrary::isInit(){
+		return this->primitives_.size() != 0;
+	}
+
+	int motionPrimitiveLibrary::getNumPrimitives(){
+		int num = 0;
+		for (const std::vector<motionPrimitive>& prims : this->primitives_){
+			num += prims.size();
+		}
+		return num;
+	}
+
+	int motionPrimitiveLibrary::getSpeedBin(double speed){
+		int bin = int(std::round(speed/this->speedRes_));
+		return std::min(std::max(bin, 0), int(this->primitives_.size())-1);
+	}
+
+	double motionPrimitiveLibrary::getBinSpeed(int speedBin){
+		return speedBin * this->speedRes_;
+	}
+
+	const motionPrimitive& motionPrimitiveLibrary::getPrimitive(int speedBin, int idx){
+		return this->primitives_[speedBin][idx];
+	}
+
+	bool motionPrimitiveLibrary::query(const Eigen::Vector3d& pos, const Eigen::Vector3d& vel, double yaw, const Eigen::Vector3d& goal,
+	                                   const std::vector<Eigen::Vector3d>& obstaclesPos, const std::vector<Eigen::Vector3d>& obstaclesVel, const std::vector<Eigen::Vector3d>& obstaclesSize,
+	                                   int& speedBin, int& idx){
+		if (not this->isInit() or this->map_ == NULL){
+			return false;
+		}
+		double speed = vel.head<2>().norm();
+		double heading = (speed > 0.1) ? atan2(vel(1), vel(0)) : yaw;
+		Eigen::Matrix2d rot;
+		rot << cos(heading), -sin(heading), sin(heading), cos(heading);
+		speedBin = this->getSpeedBin(speed);
+
+		// sort by the distance between the stop position and the goal, then take the first safe one
+		const std::vector<motionPrimitive>& prims = this->primitives_[speedBin];
+		this->candidates_.clear();
+		for (size_t i=0; i<prims.size(); ++i){
+			Eigen::Vector2d end = pos.head<2>() + rot * prims[i].samples.back().cast<double>();
+			this->candidates_.push_back(std::make_pair((end - goal.head<2>()).norm(), int(i)));
+		}
+		std::sort(this->candidates_.begin(), this->candidates_.end());
+		for (const std::pair<double, int>& candidate : this->candidates_){
+			if (this->isPrimitiveValid(prims[candidate.second], this->getBinSpeed(speedBin), pos, rot, obstaclesPos, obstaclesVel, obstaclesSize)){
+				idx = candidate.second;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool motionPrimitiveLibrary::isPrimitiveValid(const motionPrimitive& prim, double speed, const Eigen::Vector3d& pos, const Eigen::Matrix2d& rot,
+	                                              const std::vector<Eigen::Vector3d>& obstaclesPos, const std::vector<Eigen::Vector3d>& obstaclesVel, const std::vector<Eigen::Vector3d>& obstaclesSize){
+		Eigen::Vector3d robotSize = this->map_->getRobotSize();
+		double totalDuration = this->getTotalDuration(prim, speed);
+		for (size_t i=0; i<prim.samples.size(); ++i){
+			Eigen::Vector3d p;
+			p.head<2>() = pos.head<2>() + rot * prim.samples[i].cast<double>();
+			p(2) = pos(2);
+			if (this->map_->isInflatedOccupied(p)){
+				return false;
+			}
+
+			// dynamic obstacles are predicted with constant velocity. the last sample is the stop position at the total duration
+			double t = (i+1 < prim.samples.size()) ? (i+1) * this->sampleDt_ : totalDuration;
+			for (size_t j=0; j<obstaclesPos.size(); ++j){
+				Eigen::Vector3d obPos = obstaclesPos[j] + obstaclesVel[j] * t;
+				Eigen::Vector3d diff = (p - obPos).cwiseAbs();
+				Eigen::Vector3d bound = (obstaclesSize[j] + robotSize)/2.0;
+				if (diff(0) <= bound(0) and diff(1) <= bound(1) and diff(2) <= bound(2)){
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	double motionPrimitiveLibrary::getTotalDuration(const motionPrimitive& prim, double speed){
+		Eigen::Vector2d velEnd = Eigen::Vector2d (speed, 0.0) + prim.acc.cast<double>() * prim.duration;
+		return prim.duration + velEnd.norm()/this->maxAcc_;
+	}
+
+	void motionPrimitiveLibrary::getState(const motionPrimitive& prim, double speed, double t, Eigen::Vector2d& pos, Eigen::Vector2d& vel, Eigen::Vector2d& acc){
+		Eigen::Vector2d v0 (speed, 0.0);
+		Eigen::Vector2d a = prim.acc.cast<double>();
+		double t1 = std::min(t, double(prim.duration));
+		pos = v0 * t1 + 0.5 * a * t1 * t1;
+		vel = v0 + a * t1;
+		acc = a;
+		if (t <= prim.duration){
+			return;
+		}
+
+		// braking phase
+		double speedEnd = vel.norm();
+		if (speedEnd < 1e-6){
+			vel.setZero();
+			acc.setZero();
+			return;
+		}
+		Eigen::Vector2d brakeAcc = -vel/speedEnd * this->maxAcc_;
+		double t2 = std::min(t - prim.duration, speedEnd/this->maxAcc_);
+		pos += vel * t2 + 0.5 * brakeAcc * t2 * t2;
+		vel += brakeAcc * t2;
+		acc = brakeAcc;
+		if (t - prim.duration >= speedEnd/this->maxAcc_){
+			vel.setZero();
+			acc.setZero();
+		}
+	}
+}
@@ -0,0 +1,71 @@
+/*
+	FILE: motionPrimitiveLibrary.h
+	------------------------
+	precomputed motion primitives used as the fallback when trajectory generation fails
+*/
+
+#ifndef AUTOFLIGHT_MOTION_PRIMITIVE_LIBRARY_H
+#define AUTOFLIGHT_MOTION_PRIMITIVE_LIBRARY_H
+#include <map_manager/occupancyMap.h>
+#include <Eigen/Dense>
+#include <vector>
+#include <string>
+#include <memory>
+
+namespace AutoFlight{
+	/*
+		A primitive is defined in the heading frame (initial velocity along +x):
+		constant acceleration acc for duration, then braking with the maximum
+		acceleration until it stops. samples are positions every sampleDt.
+	*/
+	struct motionPrimitive{
+		Eigen::Vector2f acc;
+		float duration;
+		std::vector<Eigen::Vector2f> samples;
+	};
+
+	class motionPrimitiveLibrary{
+	private:
+		std::shared_ptr<mapManager::occMap> map_;
+
+		// library data
+		float maxVel_ = 0.0;
+		float maxAcc_ = 0.0;
+		float speedRes_ = 0.0;
+		float sampleDt_ = 0.0;
+		std::vector<std::vector<motionPrimitive>> primitives_; // indexed by initial speed bin
+
+		// query buffer
+		std::vector<std::pair<double, int>> candidates_;
+
+	public:
+		motionPrimitiveLibrary();
+		void setMap(const std::shared_ptr<mapManager::occMap>& map);
+
+		void generate(double maxVel, double maxAcc, double speedRes, int numAccSamples, double duration, double sampleDt);
+		bool save(const std::string& filename);
+		bool load(const std::string& filename, double maxVel, double maxAcc); // rejects truncated files and libraries of other limits
+		bool isInit();
+		int getNumPrimitives();
+
+		int getSpeedBin(double speed);
+		double getBinSpeed(int speedBin);
+		const motionPrimitive& getPrimitive(int speedBin, int idx);
+
+		// pick the collision-free primitive of the current speed bin which ends closest to the goal
+		bool query(const Eigen::Vector3d& pos, const Eigen::Vector3d& vel, double yaw, const Eigen::Vector3d& goal,
+		           const std::vector<Eigen::Vector3d>& obstaclesPos, const std::vector<Eigen::Vector3d>& obstaclesVel, const std::vector<Eigen::Vector3d>& obstaclesSize,
+		           int& speedBin, int& idx);
+
+		// state of the primitive at time t in the heading frame. the samples are checked with the bin speed, so execute with it too
+		double getTotalDuration(const motionPrimitive& prim, double speed);
+		void getState(const motionPrimitive& prim, double speed, double t, Eigen::Vector2d& pos, Eigen::Vector2d& vel, Eigen::Vector2d& acc);
+
+	private:
+		void samplePrimitive(motionPrimitive& prim, double speed);
+		bool isPrimitiveValid(const motionPrimitive& prim, double speed, const Eigen::Vector3d& pos, const Eigen::Matrix2d& rot,
+		                      const std::vector<Eigen::Vector3d>& obstaclesPos, const std::vector<Eigen::Vector3d>& obstaclesVel, const std::vector<Eigen::Vector3d>& obstaclesSize);
+	};
+}
+
+#endif
@@ -69,6 +69,22 @@ namespace AutoFlight{
 			cout << "[AutoFlight]: Desired angular velocity is set to: " << this->desiredAngularVel_ << "rad/s." << endl;
 		}	
 
+		// yaw planned along the trajectory: velocity, goal or waypoint
+		if (not this->nh_.getParam("autonomous_flight/yaw_mode", this->yawMode_)){
+			this->yawMode_ = "velocity";
+			cout << "[AutoFlight]: No yaw mode param found. Use default: velocity." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Yaw mode is set to: " << this->yawMode_ << "." << endl;
+		}
+		AutoFlight::YAW_MODE yawMode;
+		if (not AutoFlight::yawPlanner::getMode(this->yawMode_, yawMode)){
+			yawMode = AutoFlight::YAW_MODE::FACE_VELOCITY;
+			cout << "[AutoFlight]: Invalid yaw mode " << this->yawMode_ << ". Use velocity." << endl;
+		}
+		this->yawPlanner_.setMode(yawMode);
+		this->yawPlanner_.setMaxAngularVel(this->desiredAngularVel_);
+
     	// trajectory data save path   	
 		if (not this->nh_.getParam("autonomous_flight/trajectory_info_save_path", this->trajSavePath_)){
 			this->trajSavePath_ = "No";
@@ -86,15 +102,84 @@ namespace AutoFlight{
 		else{
 			cout << "[AutoFlight]: Use time optimizer is set to: " << this->useTimeOptimizer_ << "." << endl;
 		}			
+
+		// global planner type
+		if (not this->nh_.getParam("grid_planner/use_grid_planner", this->useGridPlanner_)){
+			this->useGridPlanner_ = false;
+			cout << "[AutoFlight]: No use grid planner param found. Use default: false (RRT)." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Use grid planner is set to: " << this->useGridPlanner_ << "." << endl;
+		}
+		// goal snapping radius
+		if (not this->nh_.getParam("autonomous_flight/goal_snap_radius", this->goalSnapRadius_)){
+			this->goalSnapRadius_ = 1.0;
+			cout << "[AutoFlight]: No goal snap radius param found. Use default: 1.0 m." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Goal snap radius is set to: " << this->goalSnapRadius_ << "m." << endl;
+		}
+
+		// mission waypoints [x1, y1, z1, x2, y2, z2, ...]
+		std::vector<double> missionWaypointsVec;
+		if (not this->nh_.getParam("autonomous_flight/mission_waypoints", missionWaypointsVec)){
+			cout << "[AutoFlight]: No mission waypoints param found. Wait for goal or mission topic." << endl;
+		}
+		else{
+			if (missionWaypointsVec.size() % 3 != 0){
+				cout << "[AutoFlight]: Invalid mission waypoints param. Ignore." << endl;
+			}
+			else{
+				for (size_t i=0; i<missionWaypointsVec.size(); i+=3){
+					geometry_msgs::PoseStamped ps;
+					ps.header.frame_id = "map";
+					ps.pose.position.x = missionWaypointsVec[i];
+					ps.pose.position.y = missionWaypointsVec[i+1];
+					ps.pose.position.z = missionWaypointsVec[i+2];
+					ps.pose.orientation.w = 1.0;
+					this->missionWaypointsParam_.poses.push_back(ps);
+				}
+				cout << "[AutoFlight]: Mission waypoints number: " << this->missionWaypointsParam_.poses.size() << "." << endl;
+			}
+		}
+
+		// number of mission waypoints planned ahead
+		if (not this->nh_.getParam("autonomous_flight/mission_horizon", this->missionHorizon_)){
+			this->missionHorizon_ = 2;
+			cout << "[AutoFlight]: No mission horizon param found. Use default: 2." << endl;
+		}
+		else{
+			this->missionHorizon_ = std::max(this->missionHorizon_, 1);
+			cout << "[AutoFlight]: Mission horizon is set to: " << this->missionHorizon_ << "." << endl;
+		}
+
+		// distance to consider a mission waypoint passed
+		if (not this->nh_.getParam("autonomous_flight/mission_reach_distance", this->missionReachDist_)){
+			this->missionReachDist_ = 1.0;
+			cout << "[AutoFlight]: No mission reach distance param found. Use default: 1.0 m." << endl;
+		}
+		else{
+			cout << "[AutoFlight]: Mission reach distance is set to: " << this->missionReachDist_ << "m." << endl;
+		}
 	}
 
 	void navigation::initModules(){
 		// initialize map
 		this->map_.reset(new mapManager::occMap (this->nh_));
 
-		// initialize rrt planner
-		this->rrtPlanner_.reset(new globalPlanner::rrtOccMap<3> (this->nh_));
-		this->rrtPlanner_->setMap(this->map_);
+		// initialize global planner
+		if (this->useGridPlanner_){
+			this->gridPlanner_.reset(new AutoFlight::gridPlanner (this->nh_));
+			this->gridPlanner_->setMap(this->map_);
+		}
+		else{
+			this->rrtPlanner_.reset(new globalPlanner::rrtOccMap<3> (this->nh_));
+			this->rrtPlanner_->setMap(this->map_);
+		}
+
+		// initialize goal snapper
+		this->goalSnapper_.setMap(this->map_);
+		this->goalSnapper_.setRadius(this->goalSnapRadius_);
 
 		// initialize polynomial trajectory planner
 		this->polyTraj_.reset(new trajPlanner::polyTrajOccMap (this->nh_));
@@ -130,6 +215,9 @@ namespace AutoFlight{
 	}
 
 	void navigation::registerCallback(){
+		// mission subscriber
+		this->missionSub_ = this->nh_.subscribe("navigation/mission", 10, &navigation::missionCB, this);
+
 		// planner callback
 		this->plannerTimer_ = this->nh_.createTimer(ros::Duration(0.1), &navigation::plannerCB, this);
 		
@@ -156,12 +244,11 @@ namespace AutoFlight{
 			double initTs = this->bsplineTraj_->getInitTs();
 			if (this->useGlobalPlanner_){
 				if (this->needGlobalPlan_){
-					this->rrtPlanner_->updateStart(this->odom_.pose.pose);
-					this->rrtPlanner_->updateGoal(this->goal_.pose);
 					nav_msgs::Path rrtPathMsgTemp;
-					this->rrtPlanner_->makePlan(rrtPathMsgTemp);
+					this->makeGlobalPlan(this->odom_.pose.pose, this->goal_.pose, rrtPathMsgTemp);
 					if (rrtPathMsgTemp.poses.size() >= 2){
 						this->rrtPathMsg_ = rrtPathMsgTemp;
+						this->globalPathTracker_.setPath(this->rrtPathMsg_);
 						this->globalPlanReady_ = true;
 					}
 					this->needGlobalPlan_ = false;
@@ -170,7 +257,7 @@ namespace AutoFlight{
 				else{
 					if (this->globalPlanReady_){
 						// get rest of global plan
-						nav_msgs::Path restPath = this->getRestGlobalPath();
+						const nav_msgs::Path& restPath = this->getRestGlobalPath();
 						this->polyTraj_->updatePath(restPath, startEndConditions);
 						this->polyTraj_->makePlan(this->polyTrajMsg_); // no corridor constraint		
 						nav_msgs::Path adjustedInputPolyTraj;
@@ -204,11 +291,15 @@ namespace AutoFlight{
 				}				
 			}
 			else{
-				if (not this->trajectoryReady_){ // use polynomial trajectory as input
+				if (not this->trajectoryReady_ or this->missionActive_){ // use polynomial trajectory as input
 					nav_msgs::Path waypoints, polyTrajTemp;
 					geometry_msgs::PoseStamped start, goal;
 					start.pose = this->odom_.pose.pose; goal = this->goal_;
 					waypoints.poses = std::vector<geometry_msgs::PoseStamped> {start, goal};					
+					if (this->missionActive_){
+						// plan through the next waypoints so the intermediate ones are passed with non-zero velocity
+						this->getMissionWaypoints(waypoints);
+					}
 					
 					this->polyTraj_->updatePath(waypoints, startEndConditions);
 					this->polyTraj_->makePlan(false); // no corridor constraint
@@ -335,6 +426,11 @@ namespace AutoFlight{
 						ros::Time timeOptEndTime = ros::Time::now();
 						cout << "[AutoFlight]: Time optimizatoin spends: " << (timeOptEndTime - timeOptStartTime).toSec() << "s." << endl;
 					}
+
+					// the yaw follows the timing the trajectory is executed with
+					if (this->useYawControl_ and not this->noYawTurning_){
+						this->planYaw();
+					}
 					this->trajectoryReady_ = true;
 					this->replan_ = false;
 					cout << "\033[1;32m[AutoFlight]: Trajectory generated successfully.\033[0m " << endl;
@@ -382,6 +478,13 @@ namespace AutoFlight{
 			3. fixed distance
 		*/
 		if (this->goalReceived_){
+			if (this->newMission_){
+				this->newMission_ = false;
+			}
+			else{
+				this->missionActive_ = false; // a clicked goal cancels the mission
+			}
+			this->snapGoal();
 			this->replan_ = false;
 			this->trajectoryReady_ = false;
 			if (not this->noYawTurning_ and not this->useYawControl_){
@@ -404,6 +507,15 @@ namespace AutoFlight{
 
 		// return;
 		if (this->trajectoryReady_){
+			if (this->missionActive_ and this->updateMission()){
+				this->replan_ = true;
+				if (this->useGlobalPlanner_){
+					this->needGlobalPlan_ = true;
+				}
+				cout << "[AutoFlight]: Replan for next mission waypoint." << endl;
+				return;
+			}
+
 			if (this->hasCollision()){ // if trajectory not ready, do not replan
 				this->replan_ = true;
 				cout << "[AutoFlight]: Replan for collision." << endl;
@@ -462,8 +574,9 @@ namespace AutoFlight{
 					target.yaw = AutoFlight::rpy_from_quaternion(this->odom_.pose.pose.orientation);
 				}
 				else{
-					target.yaw = atan2(vel(1), vel(0));
-				}				
+					target.yaw = this->yawPlanner_.at(this->trajTime_);
+				}
+				this->targetYaw_ = target.yaw;				
 				target.position.x = pos(0);
 				target.position.y = pos(1);
 				target.position.z = pos(2);
@@ -478,6 +591,29 @@ namespace AutoFlight{
 		}
 	}
 
+	void navigation::planYaw(){
+		// continue from the commanded yaw in flight
+		double startYaw = this->trajectoryReady_ ? this->targetYaw_ : AutoFlight::rpy_from_quaternion(this->odom_.pose.pose.orientation);
+		nav_msgs::Path waypoints;
+		if (this->useGlobalPlanner_ and this->globalPlanReady_){
+			waypoints = this->getRestGlobalPath();
+		}
+		else{
+			geometry_msgs::PoseStamped pStart;
+			pStart.pose = this->odom_.pose.pose;
+			waypoints.poses = {pStart, this->goal_};
+		}
+		if (this->useTimeOptimizer_){
+			auto trajTimeAt = [this](double realTime){
+				Eigen::Vector3d pos, vel, acc;
+				return this->timeOptimizer_->getStates(realTime, pos, vel, acc);
+			};
+			this->yawPlanner_.plan(this->trajectory_, trajTimeAt, this->timeOptimizer_->getDuration(), startYaw, waypoints);
+		}
+		else{
+			this->yawPlanner_.plan(this->trajectory_, this->bsplineTraj_->getLinearFactor(), startYaw, waypoints);
+		}
+	}
 
 	void navigation::visCB(const ros::TimerEvent&){
 		if (this->rrtPathMsg_.poses.size() != 0){
@@ -500,6 +636,11 @@ namespace AutoFlight{
 		// take off the drone
 		this->takeoff();
 
+		// start the mission from the parameter file if provided
+		if (this->missionWaypointsParam_.poses.size() != 0){
+			this->startMission(this->missionWaypointsParam_);
+		}
+
 		int temp1 = system("mkdir ~/rosbag_navigation_info &");
 		int temp2 = system("mv ~/rosbag_navigation_info/exploration_info.bag ~/rosbag_navigation_info/previous.bag &");
 		int temp3 = system("rosbag record -O ~/rosbag_navigation_info/navigation_info.bag /camera/color/image_raw /occupancy_map/inflated_voxel_map /navigation/bspline_trajectory /mavros/local_position/pose /mavros/setpoint_position/local /tracking_controller/vel_and_acc_info /tracking_controller/target_pose /tracking_controller/trajectory_history /trajDivider/braking_zone /trajDivider/kdtree_range __name:=navigation_bag_info &");
@@ -512,6 +653,60 @@ namespace AutoFlight{
 	}
 
 
+	void navigation::missionCB(const nav_msgs::Path::ConstPtr& mission){
+		this->startMission(*mission);
+	}
+
+	void navigation::startMission(const nav_msgs::Path& mission){
+		if (mission.poses.size() == 0){
+			cout << "[AutoFlight]: Empty mission. Ignore." << endl;
+			return;
+		}
+		this->missionWaypoints_ = mission;
+		this->missionIdx_ = 0;
+		this->missionActive_ = true;
+		this->newMission_ = true;
+		this->goal_ = this->missionWaypoints_.poses[this->getMissionWindowEnd()];
+		this->firstGoal_ = true;
+		this->goalReceived_ = true;
+		cout << "[AutoFlight]: Start mission with " << this->missionWaypoints_.poses.size() << " waypoints." << endl;
+	}
+
+	int navigation::getMissionWindowEnd(){
+		// the global planner only knows the goal, so it is given one waypoint at a time
+		int horizon = this->useGlobalPlanner_ ? 1 : this->missionHorizon_;
+		return std::min(this->missionIdx_ + horizon, int(this->missionWaypoints_.poses.size())) - 1;
+	}
+
+	void navigation::getMissionWaypoints(nav_msgs::Path& waypoints){
+		waypoints.poses.resize(1); // keep the start
+		for (int i=this->missionIdx_; i<=this->getMissionWindowEnd(); ++i){
+			waypoints.poses.push_back(this->missionWaypoints_.poses[i]);
+		}
+	}
+
+	bool navigation::updateMission(){
+		const geometry_msgs::PoseStamped& currWaypoint = this->missionWaypoints_.poses[this->missionIdx_];
+		if (AutoFlight::getPoseDistance(this->odom_.pose.pose, currWaypoint.pose) > this->missionReachDist_){
+			return false;
+		}
+
+		if (this->missionIdx_ == int(this->missionWaypoints_.poses.size())-1){
+			// the last waypoint is the end of the current trajectory
+			this->missionActive_ = false;
+			cout << "[AutoFlight]: Mission finished." << endl;
+			return false;
+		}
+
+		int prevWindowEnd = this->getMissionWindowEnd();
+		++this->missionIdx_;
+		this->goal_ = this->missionWaypoints_.poses[this->getMissionWindowEnd()];
+		cout << "[AutoFlight]: Mission waypoint " << this->missionIdx_ << "/" << this->missionWaypoints_.poses.size() << " passed." << endl;
+
+		// the trajectory already covers the new window when its end does not move
+		return this->getMissionWindowEnd() != prevWindowEnd;
+	}
+
 	void navigation::getStartEndConditions(std::vector<Eigen::Vector3d>& startEndConditions){
 		/*	
 			1. start velocity
@@ -592,37 +787,42 @@ namespace AutoFlight{
 		return currentTraj;
 	}
 
-	nav_msgs::Path navigation::getRestGlobalPath(){
-		nav_msgs::Path currPath;
-
-		int nextIdx = this->rrtPathMsg_.poses.size()-1;
-		Eigen::Vector3d pCurr (this->odom_.pose.pose.position.x, this->odom_.pose.pose.position.y, this->odom_.pose.pose.position.z);
-		double minDist = std::numeric_limits<double>::infinity();
-		for (size_t i=0; i<this->rrtPathMsg_.poses.size()-1; ++i){
-			geometry_msgs::PoseStamped ps = this->rrtPathMsg_.poses[i];
-			Eigen::Vector3d pEig (ps.pose.position.x, ps.pose.position.y, ps.pose.position.z);
-			Eigen::Vector3d pDiff = pCurr - pEig;
-
-			geometry_msgs::PoseStamped psNext = this->rrtPathMsg_.poses[i+1];
-			Eigen::Vector3d pEigNext (psNext.pose.position.x, psNext.pose.position.y, psNext.pose.position.z);
-			Eigen::Vector3d diffToNext = pEigNext - pEig;
-			double dist = (pEig - pCurr).norm();
-			if (trajPlanner::angleBetweenVectors(diffToNext, pDiff) > PI_const*3.0/4.0){
-				if (dist < minDist){
-					nextIdx = i;
-					minDist = dist;
-				}
-			}
+	void navigation::snapGoal(){
+		Eigen::Vector3d goal (this->goal_.pose.position.x, this->goal_.pose.position.y, this->goal_.pose.position.z);
+		Eigen::Vector3d currPos (this->odom_.pose.pose.position.x, this->odom_.pose.pose.position.y, this->odom_.pose.pose.position.z);
+		Eigen::Vector3d goalSnapped;
+		ros::Time startTime = ros::Time::now();
+		bool success = this->goalSnapper_.snap(currPos, goal, goalSnapped);
+		double snapTime = (ros::Time::now() - startTime).toSec();
+		if (not success){
+			cout << "[AutoFlight]: No free goal connected to the robot found within " << this->goalSnapRadius_ << "m. Use the original goal." << endl;
+			return;
 		}
+		if ((goalSnapped - goal).norm() > 0){
+			this->goal_.pose.position.x = goalSnapped(0);
+			this->goal_.pose.position.y = goalSnapped(1);
+			this->goal_.pose.position.z = goalSnapped(2);
+			cout << "[AutoFlight]: Goal snapped by " << (goalSnapped - goal).norm() << "m to a free position in " << snapTime * 1000.0 << "ms." << endl;
+		}
+	}
 
-
-		geometry_msgs::PoseStamped psCurr;
-		psCurr.pose = this->odom_.pose.pose;
-		currPath.poses.push_back(psCurr);
-		for (size_t i=nextIdx; i<this->rrtPathMsg_.poses.size(); ++i){
-			currPath.poses.push_back(this->rrtPathMsg_.poses[i]);
+	void navigation::makeGlobalPlan(const geometry_msgs::Pose& start, const geometry_msgs::Pose& goal, nav_msgs::Path& path){
+		if (this->useGridPlanner_){
+			this->gridPlanner_->updateStart(start);
+			this->gridPlanner_->updateGoal(goal);
+			this->gridPlanner_->makePlan(path);
 		}
-		return currPath;		
+		else{
+			this->rrtPlanner_->updateStart(start);
+			this->rrtPlanner_->updateGoal(goal);
+			this->rrtPlanner_->makePlan(path);
+		}
+	}
+
+	const nav_msgs::Path& navigation::getRestGlobalPath(){
+		Eigen::Vector3d pCurr (this->odom_.pose.pose.position.x, this->odom_.pose.pose.position.y, this->odom_.pose.pose.position.z);
+		this->globalPathTracker_.update(pCurr);
+		return this->globalPathTracker_.getRestPath(this->odom_.pose.pose);
 	}
 
 
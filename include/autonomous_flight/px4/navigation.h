@@ -8,6 +8,10 @@
 #define AUTOFLIGHT_NAVIGATION_H
 
 #include <autonomous_flight/px4/flightBase.h>
+#include <autonomous_flight/px4/pathTracker.h>
+#include <autonomous_flight/px4/gridPlanner.h>
+#include <autonomous_flight/px4/goalSnapper.h>
+#include <autonomous_flight/px4/yawPlanner.h>
 #include <map_manager/occupancyMap.h>
 #include <global_planner/rrtOccMap.h>
 #include <trajectory_planner/polyTrajOccMap.h>
@@ -21,6 +25,7 @@ namespace AutoFlight{
 	private:
 		std::shared_ptr<mapManager::occMap> map_;
 		std::shared_ptr<globalPlanner::rrtOccMap<3>> rrtPlanner_;
+		std::shared_ptr<AutoFlight::gridPlanner> gridPlanner_;
 		std::shared_ptr<trajPlanner::polyTrajOccMap> polyTraj_;
 		std::shared_ptr<trajPlanner::pwlTraj> pwlTraj_;
 		std::shared_ptr<trajPlanner::bsplineTraj> bsplineTraj_;
@@ -34,6 +39,8 @@ namespace AutoFlight{
 		ros::Timer trajExeTimer_;
 		ros::Timer visTimer_;
 
+		ros::Subscriber missionSub_;
+
 		ros::Publisher rrtPathPub_;
 		ros::Publisher polyTrajPub_;
 		ros::Publisher pwlTrajPub_;
@@ -43,11 +50,17 @@ namespace AutoFlight{
 
 		// parameters
 		bool useGlobalPlanner_;
+		bool useGridPlanner_;
+		double goalSnapRadius_;
+		nav_msgs::Path missionWaypointsParam_;
+		int missionHorizon_;
+		double missionReachDist_;
 		bool noYawTurning_;
 		bool useYawControl_;
 		double desiredVel_;
 		double desiredAcc_;
 		double desiredAngularVel_;
+		std::string yawMode_;
 		std::string trajSavePath_;
 		bool useTimeOptimizer_;
 
@@ -56,6 +69,8 @@ namespace AutoFlight{
 		bool needGlobalPlan_ = false;
 		bool globalPlanReady_ = false;
 		nav_msgs::Path rrtPathMsg_;
+		AutoFlight::pathTracker globalPathTracker_; // progress along the global path
+		AutoFlight::goalSnapper goalSnapper_;
 		nav_msgs::Path polyTrajMsg_;
 		nav_msgs::Path pwlTrajMsg_;
 		nav_msgs::Path bsplineTrajMsg_;
@@ -65,8 +80,16 @@ namespace AutoFlight{
 		double trajTime_; // current trajectory time
 		double prevInputTrajTime_ = 0.0;
 		double facingYaw_;
+		AutoFlight::yawPlanner yawPlanner_; // yaw along the trajectory with yaw control
+		double targetYaw_ = 0.0; // last commanded yaw
 		trajPlanner::bspline trajectory_; // trajectory data for tracking
 		bool firstTimeSave_ = false;
+
+		// mission data
+		nav_msgs::Path missionWaypoints_;
+		int missionIdx_ = 0; // next waypoint to pass
+		bool missionActive_ = false;
+		bool newMission_ = false;
 		
 
 
@@ -81,13 +104,21 @@ namespace AutoFlight{
 		void replanCheckCB(const ros::TimerEvent&);
 		void trajExeCB(const ros::TimerEvent&);
 		void visCB(const ros::TimerEvent&);
+		void planYaw();
+		void missionCB(const nav_msgs::Path::ConstPtr& mission);
 
 		void run();	
 		void getStartEndConditions(std::vector<Eigen::Vector3d>& startEndConditions);	
 		bool hasCollision();
 		double computeExecutionDistance();
 		nav_msgs::Path getCurrentTraj(double dt);
-		nav_msgs::Path getRestGlobalPath();
+		void startMission(const nav_msgs::Path& mission);
+		int getMissionWindowEnd();
+		void getMissionWaypoints(nav_msgs::Path& waypoints);
+		bool updateMission();
+		void snapGoal();
+		void makeGlobalPlan(const geometry_msgs::Pose& start, const geometry_msgs::Pose& goal, nav_msgs::Path& path);
+		const nav_msgs::Path& getRestGlobalPath();
 		void publishInputTraj();
 	};
 }
@@ -0,0 +1,104 @@
+/*
+	FILE: obstacleIndex.cpp
+	------------------------
+	obstacle index implementation
+*/
+#include <autonomous_flight/px4/obstacleIndex.h>
+#include <algorithm>
+#include <cmath>
+
+namespace AutoFlight{
+	obstacleIndex::obstacleIndex(){}
+
+	void obstacleIndex::setCellSize(double cellSize){
+		this->cellSize_ = cellSize;
+	}
+
+	void obstacleIndex::build(const std::vector<Eigen::Vector3d>& lowerBounds, const std::vector<Eigen::Vector3d>& upperBounds){
+		int numItems = lowerBounds.size();
+		this->itemCells_.resize(numItems);
+		this->itemStamp_.assign(numItems, 0);
+		this->queryId_ = 0;
+
+		// table size is the next power of two above twice the number of items
+		int tableSize = 16;
+		while (tableSize < 2 * numItems){
+			tableSize *= 2;
+		}
+		this->tableMask_ = tableSize - 1;
+		this->cellStart_.assign(tableSize + 1, 0);
+
+		// count the items of each bucket
+		for (int i=0; i<numItems; ++i){
+			Eigen::Vector4i& cells = this->itemCells_[i];
+			cells << this->toCell(lowerBounds[i](0)), this->toCell(upperBounds[i](0)), this->toCell(lowerBounds[i](1)), this->toCell(upperBounds[i](1));
+			for (int cx=cells(0); cx<=cells(1); ++cx){
+				for (int cy=cells(2); cy<=cells(3); ++cy){
+					++this->cellStart_[this->toBucket(cx, cy) + 1];
+				}
+			}
+		}
+		for (int b=0; b<tableSize; ++b){
+			this->cellStart_[b+1] += this->cellStart_[b];
+		}
+
+		// fill the buckets
+		this->cellItems_.resize(this->cellStart_[tableSize]);
+		std::vector<int> fill (this->cellStart_.begin(), this->cellStart_.end() - 1);
+		for (int i=0; i<numItems; ++i){
+			const Eigen::Vector4i& cells = this->itemCells_[i];
+			for (int cx=cells(0); cx<=cells(1); ++cx){
+				for (int cy=cells(2); cy<=cells(3); ++cy){
+					this->cellItems_[fill[this->toBucket(cx, cy)]++] = i;
+				}
+			}
+		}
+	}
+
+	void obstacleIndex::beginQuery(){
+		++this->queryId_;
+		if (this->queryId_ == 0){ // wrapped around
+			std::fill(this->itemStamp_.begin(), this->itemStamp_.end(), 0);
+			this->queryId_ = 1;
+		}
+	}
+
+	void obstacleIndex::query(const Eigen::Vector3d& lowerBound, const Eigen::Vector3d& upperBound, std::vector<int>& items){
+		if (this->itemCells_.size() == 0){
+			return;
+		}
+		int cxMin = this->toCell(lowerBound(0)), cxMax = this->toCell(upperBound(0));
+		int cyMin = this->toCell(lowerBound(1)), cyMax = this->toCell(upperBound(1));
+		for (int cx=cxMin; cx<=cxMax; ++cx){
+			for (int cy=cyMin; cy<=cyMax; ++cy){
+				int bucket = this->toBucket(cx, cy);
+				for (int k=this->cellStart_[bucket]; k<this->cellStart_[bucket+1]; ++k){
+					int item = this->cellItems_[k];
+					if (this->itemStamp_[item] == this->queryId_){
+						continue;
+					}
+
+					// skip items of other cells sharing the bucket
+					const Eigen::Vector4i& cells = this->itemCells_[item];
+					if (cells(0) > cxMax or cells(1) < cxMin or cells(2) > cyMax or cells(3) < cyMin){
+						continue;
+					}
+					this->itemStamp_[item] = this->queryId_;
+					items.push_back(item);
+				}
+			}
+		}
+	}
+
+	int obstacleIndex::getNumItems(){
+		return this->itemCells_.size();
+	}
+
+	int obstacleIndex::toCell(double x){
+		return int(std::floor(x/this->cellSize_));
+	}
+
+	int obstacleIndex::toBucket(int cx, int cy){
+		return ((unsigned int)(cx) * 73856093u ^ (unsigned int)(cy) * 19349663u) & this->tableMask_;
+	}
+}
@@ -0,0 +1,44 @@
+/*
+	FILE: obstacleIndex.h
+	------------------------
+	spatial hash over obstacle boxes on the xy plane
+*/
+
+#ifndef AUTOFLIGHT_OBSTACLE_INDEX_H
+#define AUTOFLIGHT_OBSTACLE_INDEX_H
+#include <Eigen/Dense>
+#include <vector>
+
+namespace AutoFlight{
+	/*
+		Each box is inserted into all hash cells it overlaps. The table is
+		rebuilt from scratch with a counting sort, so a build is O(n) in the
+		number of inserted cells. Hash collisions only add false candidates.
+	*/
+	class obstacleIndex{
+	private:
+		double cellSize_ = 2.0;
+		int tableMask_ = 0;
+		std::vector<int> cellStart_; // items of bucket b are cellItems_[cellStart_[b], cellStart_[b+1])
+		std::vector<int> cellItems_;
+		std::vector<Eigen::Vector4i> itemCells_; // xmin, xmax, ymin, ymax cell of each item
+		std::vector<unsigned int> itemStamp_;
+		unsigned int queryId_ = 0;
+
+	public:
+		obstacleIndex();
+		void setCellSize(double cellSize);
+		void build(const std::vector<Eigen::Vector3d>& lowerBounds, const std::vector<Eigen::Vector3d>& upperBounds);
+
+		// items found by the query calls after beginQuery are reported only once
+		void beginQuery();
+		void query(const Eigen::Vector3d& lowerBound, const Eigen::Vector3d& upperBound, std::vector<int>& items);
+		int getNumItems();
+
+	private:
+		int toCell(double x);
+		int toBucket(int cx, int cy);
+	};
+}
+
+#endif
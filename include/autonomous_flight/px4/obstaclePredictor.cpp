@@ -0,0 +1,458 @@
+/*
+	FILE: obstaclePredictor.cpp
+	------------------------
+	obstacle predictor implementation
+*/
+#include <autonomous_flight/px4/obstaclePredictor.h>
+#include <algorithm>
+
+namespace AutoFlight{
+	obstaclePredictor::obstaclePredictor(const ros::NodeHandle& nh) : nh_(nh){
+		this->initParam();
+	}
+
+	void obstaclePredictor::initParam(){
+		// prediction mode
+		if (not this->nh_.getParam("obstacle_predictor/mode", this->mode_)){
+			this->mode_ = 0;
+			cout << "[ObstaclePredictor]: No mode param found. Use default: 0 (constant velocity)." << endl;
+		}
+		else{
+			cout << "[ObstaclePredictor]: Mode is set to: " << this->mode_ << (this->mode_ == 1 ? " (Kalman constant acceleration)." : " (constant velocity).") << endl;
+		}
+
+		// prediction horizon. Later samples are checked against the box at the horizon
+		if (not this->nh_.getParam("obstacle_predictor/horizon", this->horizon_)){
+			this->horizon_ = 3.0;
+			cout << "[ObstaclePredictor]: No horizon param found. Use default: 3.0 s." << endl;
+		}
+		else{
+			cout << "[ObstaclePredictor]: Horizon is set to: " << this->horizon_ << "s." << endl;
+		}
+
+		// growth of the box per second of prediction
+		if (not this->nh_.getParam("obstacle_predictor/uncertainty_rate", this->uncertaintyRate_)){
+			this->uncertaintyRate_ = 0.2;
+			cout << "[ObstaclePredictor]: No uncertainty rate param found. Use default: 0.2 m/s." << endl;
+		}
+		else{
+			cout << "[ObstaclePredictor]: Uncertainty rate is set to: " << this->uncertaintyRate_ << "m/s." << endl;
+		}
+
+		// maximum growth of the box on each side
+		if (not this->nh_.getParam("obstacle_predictor/max_uncertainty", this->maxUncertainty_)){
+			this->maxUncertainty_ = 0.5;
+			cout << "[ObstaclePredictor]: No max uncertainty param found. Use default: 0.5 m." << endl;
+		}
+		else{
+			cout << "[ObstaclePredictor]: Max uncertainty is set to: " << this->maxUncertainty_ << "m." << endl;
+		}
+
+		// maximum estimated acceleration (Kalman mode)
+		if (not this->nh_.getParam("obstacle_predictor/max_acc", this->maxAcc_)){
+			this->maxAcc_ = 1.0;
+			cout << "[ObstaclePredictor]: No max acc param found. Use default: 1.0 m/s^2." << endl;
+		}
+		else{
+			cout << "[ObstaclePredictor]: Max acc is set to: " << this->maxAcc_ << "m/s^2." << endl;
+		}
+
+		// distance to associate a detection with a track (Kalman mode)
+		if (not this->nh_.getParam("obstacle_predictor/association_distance", this->associationDist_)){
+			this->associationDist_ = 0.5;
+			cout << "[ObstaclePredictor]: No association distance param found. Use default: 0.5 m." << endl;
+		}
+		else{
+			cout << "[ObstaclePredictor]: Association distance is set to: " << this->associationDist_ << "m." << endl;
+		}
+
+		// tracks without detections are removed after the timeout (Kalman mode)
+		if (not this->nh_.getParam("obstacle_predictor/track_timeout", this->trackTimeout_)){
+			this->trackTimeout_ = 1.0;
+			cout << "[ObstaclePredictor]: No track timeout param found. Use default: 1.0 s." << endl;
+		}
+		else{
+			cout << "[ObstaclePredictor]: Track timeout is set to: " << this->trackTimeout_ << "s." << endl;
+		}
+
+		// noise (Kalman mode)
+		if (not this->nh_.getParam("obstacle_predictor/process_noise", this->processNoise_)){
+			this->processNoise_ = 1.0;
+		}
+		if (not this->nh_.getParam("obstacle_predictor/position_noise", this->posNoise_)){
+			this->posNoise_ = 0.05;
+		}
+		if (not this->nh_.getParam("obstacle_predictor/velocity_noise", this->velNoise_)){
+			this->velNoise_ = 0.2;
+		}
+
+		// cell size of the obstacle spatial index
+		if (not this->nh_.getParam("obstacle_predictor/index_cell_size", this->indexCellSize_)){
+			this->indexCellSize_ = 2.0;
+			cout << "[ObstaclePredictor]: No index cell size param found. Use default: 2.0 m." << endl;
+		}
+		else{
+			cout << "[ObstaclePredictor]: Index cell size is set to: " << this->indexCellSize_ << "m." << endl;
+		}
+		this->index_.setCellSize(this->indexCellSize_);
+
+		// obstacles within this distance to the input path are used by the trajectory optimization
+		if (not this->nh_.getParam("obstacle_predictor/corridor_margin", this->corridorMargin_)){
+			this->corridorMargin_ = 2.0;
+			cout << "[ObstaclePredictor]: No corridor margin param found. Use default: 2.0 m." << endl;
+		}
+		else{
+			cout << "[ObstaclePredictor]: Corridor margin is set to: " << this->corridorMargin_ << "m." << endl;
+		}
+
+		// older obstacle data is only extrapolated up to this age
+		if (not this->nh_.getParam("obstacle_predictor/max_extrapolation", this->maxExtrapolation_)){
+			this->maxExtrapolation_ = 0.5;
+			cout << "[ObstaclePredictor]: No max extrapolation param found. Use default: 0.5 s." << endl;
+		}
+		else{
+			cout << "[ObstaclePredictor]: Max extrapolation is set to: " << this->maxExtrapolation_ << "s." << endl;
+		}
+	}
+
+	void obstaclePredictor::setRobotSize(const Eigen::Vector3d& robotSize){
+		this->robotSize_ = robotSize;
+		if (this->snapshot_ != NULL){
+			this->updateBatchData();
+		}
+	}
+
+	void obstaclePredictor::update(const AutoFlight::obstacleSnapshotPtr& snapshot){
+		if (snapshot == this->snapshot_){
+			return;
+		}
+		this->snapshot_ = snapshot;
+		if (this->mode_ == 1){
+			this->updateTracks();
+		}
+		this->updateBatchData();
+	}
+
+	void obstaclePredictor::predict(int idx, double t, Eigen::Vector3d& pos, Eigen::Vector3d& size){
+		double age = this->getDataAge();
+		t = std::min(std::max(t, 0.0), this->horizon_) + age;
+		if (this->mode_ == 1){
+			pos = this->filteredPos_[idx] + this->filteredVel_[idx] * t + 0.5 * this->filteredAcc_[idx] * t * t;
+		}
+		else{
+			pos = this->snapshot_->pos[idx] + this->snapshot_->vel[idx] * t;
+		}
+		double uncertainty = std::min(this->uncertaintyRate_ * t, this->maxUncertainty_);
+		size = this->snapshot_->size[idx] + Eigen::Vector3d (2.0 * uncertainty, 2.0 * uncertainty, 2.0 * uncertainty);
+	}
+
+	int obstaclePredictor::getNumObstacles(){
+		if (this->snapshot_ == NULL){
+			return 0;
+		}
+		return this->snapshot_->getNumObstacles();
+	}
+
+	bool obstaclePredictor::getEarliestConflict(const std::vector<Eigen::Vector3d>& points, const std::vector<double>& times, double& conflictTime){
+		double minClearance;
+		return this->sweepTest(points, times, 0.0, true, conflictTime, minClearance);
+	}
+
+	bool obstaclePredictor::getClearance(const std::vector<Eigen::Vector3d>& points, const std::vector<double>& times, double maxClearance, double& conflictTime, double& minClearance){
+		return this->sweepTest(points, times, maxClearance, false, conflictTime, minClearance);
+	}
+
+	bool obstaclePredictor::sweepTest(const std::vector<Eigen::Vector3d>& points, const std::vector<double>& times, double margin, bool stopAtConflict, double& conflictTime, double& minClearance){
+		minClearance = margin;
+		if (this->getNumObstacles() == 0 or points.size() == 0){
+			return false;
+		}
+
+		// only the obstacles whose swept boxes touch the trajectory corridor (expanded by the margin) are tested
+		size_t numSegments = std::max(points.size(), size_t(2)) - 1; // a single point is a zero length segment
+		Eigen::Vector3d marginVec (margin, margin, margin);
+		this->candidates_.clear();
+		this->index_.beginQuery();
+		for (size_t i=0; i<numSegments; ++i){
+			size_t j = std::min(i+1, points.size()-1);
+			this->index_.query(points[i].cwiseMin(points[j]) - marginVec, points[i].cwiseMax(points[j]) + marginVec, this->candidates_);
+		}
+		if (this->candidates_.size() == 0){
+			return false;
+		}
+		this->gatherCandidates();
+		double age = this->getDataAge();
+
+		const Eigen::ArrayXf& px = this->activePos_[0];
+		const Eigen::ArrayXf& py = this->activePos_[1];
+		const Eigen::ArrayXf& pz = this->activePos_[2];
+		const Eigen::ArrayXf& vx = this->activeVel_[0];
+		const Eigen::ArrayXf& vy = this->activeVel_[1];
+		const Eigen::ArrayXf& vz = this->activeVel_[2];
+		const Eigen::ArrayXf& ax = this->activeHalfAcc_[0];
+		const Eigen::ArrayXf& ay = this->activeHalfAcc_[1];
+		const Eigen::ArrayXf& az = this->activeHalfAcc_[2];
+		const Eigen::ArrayXf& hx = this->activeHalfSize_[0];
+		const Eigen::ArrayXf& hy = this->activeHalfSize_[1];
+		const Eigen::ArrayXf& hz = this->activeHalfSize_[2];
+		this->gap_.resize(this->candidates_.size());
+		bool hasConflict = false;
+		for (size_t i=0; i<numSegments; ++i){
+			size_t j = std::min(i+1, points.size()-1);
+			float t0 = std::min(std::max(times[i], 0.0), this->horizon_) + age;
+			float t1 = std::min(std::max(times[j], 0.0), this->horizon_) + age;
+			float uncertainty = std::min(this->uncertaintyRate_ * t1, this->maxUncertainty_);
+
+			/*
+				The obstacle box swept from t0 to t1 is centered at (c(t0) + c(t1))/2 with the
+				half width |c(t1) - c(t0)|/2 + halfSize. On each axis the separation to the segment
+				box is |center difference| - both half widths. The boxes overlap if all are <= 0,
+				otherwise the largest separation is the (Chebyshev) clearance.
+			*/
+			float tm = (t0 + t1)/2.0, km = (t0*t0 + t1*t1)/2.0;
+			float dt = (t1 - t0)/2.0, dk = (t1*t1 - t0*t0)/2.0;
+			Eigen::Vector3f segMid = ((points[i] + points[j])/2.0).cast<float>();
+			Eigen::Vector3f segHalf = ((points[j] - points[i]).cwiseAbs()/2.0).cast<float>() + Eigen::Vector3f (uncertainty, uncertainty, uncertainty);
+			this->gap_ = ((px + vx * tm + ax * km - segMid(0)).abs() - (vx * dt + ax * dk).abs() - hx - segHalf(0))
+			        .max((py + vy * tm + ay * km - segMid(1)).abs() - (vy * dt + ay * dk).abs() - hy - segHalf(1))
+			        .max((pz + vz * tm + az * km - segMid(2)).abs() - (vz * dt + az * dk).abs() - hz - segHalf(2));
+			double gap = this->gap_.minCoeff();
+			minClearance = std::min(minClearance, std::max(gap, 0.0));
+			if (gap <= 0.0 and not hasConflict){
+				hasConflict = true;
+				conflictTime = times[i];
+				if (stopAtConflict){
+					return true;
+				}
+			}
+		}
+		return hasConflict;
+	}
+
+	void obstaclePredictor::updateBatchData(){
+		int numObstacles = this->getNumObstacles();
+		for (int axis=0; axis<3; ++axis){
+			this->batchPos_[axis].resize(numObstacles);
+			this->batchVel_[axis].resize(numObstacles);
+			this->batchHalfAcc_[axis].resize(numObstacles);
+			this->batchHalfSize_[axis].resize(numObstacles);
+			for (int i=0; i<numObstacles; ++i){
+				if (this->mode_ == 1){
+					this->batchPos_[axis](i) = this->filteredPos_[i](axis);
+					this->batchVel_[axis](i) = this->filteredVel_[i](axis);
+					this->batchHalfAcc_[axis](i) = 0.5 * this->filteredAcc_[i](axis);
+				}
+				else{
+					this->batchPos_[axis](i) = this->snapshot_->pos[i](axis);
+					this->batchVel_[axis](i) = this->snapshot_->vel[i](axis);
+					this->batchHalfAcc_[axis](i) = 0.0;
+				}
+				this->batchHalfSize_[axis](i) = (this->snapshot_->size[i](axis) + this->robotSize_(axis))/2.0;
+			}
+		}
+
+		// box covered by each obstacle within the horizon after the oldest extrapolated query (the extreme of the parabola is included)
+		double sweptTime = this->horizon_ + this->maxExtrapolation_;
+		this->sweptLower_.resize(numObstacles);
+		this->sweptUpper_.resize(numObstacles);
+		for (int i=0; i<numObstacles; ++i){
+			for (int axis=0; axis<3; ++axis){
+				double p = this->batchPos_[axis](i), v = this->batchVel_[axis](i), a = this->batchHalfAcc_[axis](i);
+				double pEnd = p + v * sweptTime + a * pow(sweptTime, 2);
+				double lower = std::min(p, pEnd), upper = std::max(p, pEnd);
+				if (a != 0.0){
+					double tExtreme = -v/(2.0 * a);
+					if (tExtreme > 0.0 and tExtreme < sweptTime){
+						double pExtreme = p + v * tExtreme + a * pow(tExtreme, 2);
+						lower = std::min(lower, pExtreme);
+						upper = std::max(upper, pExtreme);
+					}
+				}
+				double halfSize = this->batchHalfSize_[axis](i) + this->maxUncertainty_;
+				this->sweptLower_[i](axis) = lower - halfSize;
+				this->sweptUpper_[i](axis) = upper + halfSize;
+			}
+		}
+		this->index_.build(this->sweptLower_, this->sweptUpper_);
+	}
+
+	void obstaclePredictor::gatherCandidates(){
+		int numCandidates = this->candidates_.size();
+		for (int axis=0; axis<3; ++axis){
+			this->activePos_[axis].resize(numCandidates);
+			this->activeVel_[axis].resize(numCandidates);
+			this->activeHalfAcc_[axis].resize(numCandidates);
+			this->activeHalfSize_[axis].resize(numCandidates);
+			for (int k=0; k<numCandidates; ++k){
+				int i = this->candidates_[k];
+				this->activePos_[axis](k) = this->batchPos_[axis](i);
+				this->activeVel_[axis](k) = this->batchVel_[axis](i);
+				this->activeHalfAcc_[axis](k) = this->batchHalfAcc_[axis](i);
+				this->activeHalfSize_[axis](k) = this->batchHalfSize_[axis](i);
+			}
+		}
+	}
+
+	void obstaclePredictor::getObstaclesNearPath(const nav_msgs::Path& path, std::vector<Eigen::Vector3d>& obstaclesPos, std::vector<Eigen::Vector3d>& obstaclesVel, std::vector<Eigen::Vector3d>& obstaclesSize){
+		if (this->getNumObstacles() == 0 or path.poses.size() == 0){
+			return;
+		}
+		Eigen::Vector3d margin (this->corridorMargin_, this->corridorMargin_, this->corridorMargin_);
+		this->candidates_.clear();
+		this->index_.beginQuery();
+		for (size_t i=0; i<path.poses.size(); ++i){
+			size_t j = std::min(i+1, path.poses.size()-1);
+			Eigen::Vector3d p1 (path.poses[i].pose.position.x, path.poses[i].pose.position.y, path.poses[i].pose.position.z);
+			Eigen::Vector3d p2 (path.poses[j].pose.position.x, path.poses[j].pose.position.y, path.poses[j].pose.position.z);
+			this->index_.query(p1.cwiseMin(p2) - margin, p1.cwiseMax(p2) + margin, this->candidates_);
+		}
+		std::sort(this->candidates_.begin(), this->candidates_.end()); // keep the snapshot order
+		double age = this->getDataAge();
+		for (int i : this->candidates_){
+			Eigen::Vector3d pos, vel;
+			if (this->mode_ == 1){
+				pos = this->filteredPos_[i] + this->filteredVel_[i] * age + 0.5 * this->filteredAcc_[i] * age * age;
+				vel = this->filteredVel_[i] + this->filteredAcc_[i] * age;
+			}
+			else{
+				pos = this->snapshot_->pos[i] + this->snapshot_->vel[i] * age;
+				vel = this->snapshot_->vel[i];
+			}
+			obstaclesPos.push_back(pos);
+			obstaclesVel.push_back(vel);
+			obstaclesSize.push_back(this->snapshot_->size[i]);
+		}
+	}
+
+	double obstaclePredictor::getDataAge(){
+		double age = (ros::Time::now() - this->snapshot_->stamp).toSec();
+		this->reportLatency(age);
+		return std::min(std::max(age, 0.0), this->maxExtrapolation_);
+	}
+
+	void obstaclePredictor::reportLatency(double age){
+		this->latencySum_ += age;
+		this->latencyMax_ = std::max(this->latencyMax_, age);
+		++this->numLatency_;
+
+		ros::Time currTime = ros::Time::now();
+		double statTime = (currTime - this->latencyStatTime_).toSec();
+		if (statTime >= 10.0){
+			if (not this->latencyStatTime_.isZero()){
+				cout << "[ObstaclePredictor]: Obstacle latency from measurement to use: " << 1000.0 * this->latencySum_/this->numLatency_ << "ms avg, " << 1000.0 * this->latencyMax_ << "ms max." << endl;
+			}
+			this->latencySum_ = 0.0;
+			this->latencyMax_ = 0.0;
+			this->numLatency_ = 0;
+			this->latencyStatTime_ = currTime;
+		}
+	}
+
+	void obstaclePredictor::updateTracks(){
+		const std::vector<Eigen::Vector3d>& obstaclesPos = this->snapshot_->pos;
+		const std::vector<Eigen::Vector3d>& obstaclesVel = this->snapshot_->vel;
+		const std::vector<Eigen::Vector3d>& obstaclesSize = this->snapshot_->size;
+		ros::Time currTime = this->snapshot_->stamp;
+
+		// propagate all tracks to the current time and drop the ones not detected within the timeout
+		std::vector<obstacleTrack> tracks;
+		for (obstacleTrack& track : this->tracks_){
+			if ((currTime - track.lastMatched).toSec() > this->trackTimeout_){
+				continue;
+			}
+			this->predictTrack(track, (currTime - track.stamp).toSec());
+			track.stamp = currTime;
+			track.matched = false;
+			tracks.push_back(track);
+		}
+		this->tracks_ = tracks;
+
+		// greedy nearest neighbor association. The output keeps the order of the detections
+		this->filteredPos_.resize(obstaclesPos.size());
+		this->filteredVel_.resize(obstaclesPos.size());
+		this->filteredAcc_.resize(obstaclesPos.size());
+		for (size_t i=0; i<obstaclesPos.size(); ++i){
+			int bestIdx = -1;
+			double bestDist = this->associationDist_;
+			for (size_t j=0; j<this->tracks_.size(); ++j){
+				if (this->tracks_[j].matched){
+					continue;
+				}
+				double dist = (this->tracks_[j].state.col(0) - obstaclesPos[i]).norm();
+				if (dist <= bestDist){
+					bestDist = dist;
+					bestIdx = j;
+				}
+			}
+
+			if (bestIdx == -1){
+				obstacleTrack track;
+				this->initTrack(track, obstaclesPos[i], obstaclesVel[i], obstaclesSize[i]);
+				track.stamp = currTime;
+				track.lastMatched = currTime;
+				this->tracks_.push_back(track);
+				bestIdx = this->tracks_.size() - 1;
+			}
+			else{
+				this->correctTrack(this->tracks_[bestIdx], obstaclesPos[i], obstaclesVel[i]);
+				this->tracks_[bestIdx].size = obstaclesSize[i];
+				this->tracks_[bestIdx].lastMatched = currTime;
+			}
+			obstacleTrack& track = this->tracks_[bestIdx];
+			track.matched = true;
+			this->filteredPos_[i] = track.state.col(0);
+			this->filteredVel_[i] = track.state.col(1);
+			Eigen::Vector3d acc = track.state.col(2);
+			if (acc.norm() > this->maxAcc_){
+				acc *= this->maxAcc_/acc.norm();
+			}
+			this->filteredAcc_[i] = acc;
+		}
+	}
+
+	void obstaclePredictor::predictTrack(obstacleTrack& track, double dt){
+		if (dt <= 0.0){
+			return;
+		}
+		Eigen::Matrix3d F;
+		F << 1.0, dt, 0.5*dt*dt,
+		     0.0, 1.0, dt,
+		     0.0, 0.0, 1.0;
+		Eigen::Vector3d G (dt*dt*dt/6.0, dt*dt/2.0, dt);
+		Eigen::Matrix3d Q = this->processNoise_ * G * G.transpose();
+		for (int axis=0; axis<3; ++axis){
+			Eigen::Vector3d x = track.state.row(axis).transpose();
+			track.state.row(axis) = (F * x).transpose();
+			track.cov[axis] = F * track.cov[axis] * F.transpose() + Q;
+		}
+	}
+
+	void obstaclePredictor::correctTrack(obstacleTrack& track, const Eigen::Vector3d& pos, const Eigen::Vector3d& vel){
+		Eigen::Matrix<double, 2, 3> H;
+		H << 1.0, 0.0, 0.0,
+		     0.0, 1.0, 0.0;
+		Eigen::Matrix2d R;
+		R << pow(this->posNoise_, 2), 0.0,
+		     0.0, pow(this->velNoise_, 2);
+		for (int axis=0; axis<3; ++axis){
+			Eigen::Vector3d x = track.state.row(axis).transpose();
+			Eigen::Vector2d z (pos(axis), vel(axis));
+			Eigen::Matrix2d S = H * track.cov[axis] * H.transpose() + R;
+			Eigen::Matrix<double, 3, 2> K = track.cov[axis] * H.transpose() * S.inverse();
+			x += K * (z - H * x);
+			track.state.row(axis) = x.transpose();
+			track.cov[axis] = (Eigen::Matrix3d::Identity() - K * H) * track.cov[axis];
+		}
+	}
+
+	void obstaclePredictor::initTrack(obstacleTrack& track, const Eigen::Vector3d& pos, const Eigen::Vector3d& vel, const Eigen::Vector3d& size){
+		track.state.col(0) = pos;
+		track.state.col(1) = vel;
+		track.state.col(2).setZero();
+		for (int axis=0; axis<3; ++axis){
+			track.cov[axis] = Eigen::Vector3d (pow(this->posNoise_, 2), pow(this->velNoise_, 2), pow(this->maxAcc_, 2)).asDiagonal();
+		}
+		track.size = size;
+		track.matched = false;
+	}
+}
@@ -0,0 +1,126 @@
+/*
+	FILE: obstaclePredictor.h
+	------------------------
+	predict the boxes of dynamic obstacles at future times for collision checking
+*/
+
+#ifndef AUTOFLIGHT_OBSTACLE_PREDICTOR_H
+#define AUTOFLIGHT_OBSTACLE_PREDICTOR_H
+#include <ros/ros.h>
+#include <autonomous_flight/px4/obstacleSnapshot.h>
+#include <autonomous_flight/px4/obstacleIndex.h>
+#include <nav_msgs/Path.h>
+#include <Eigen/Dense>
+#include <vector>
+
+using std::cout; using std::endl;
+namespace AutoFlight{
+	/*
+		Kalman track of one obstacle. Each axis has the state [p, v, a]
+		and is filtered independently with position and velocity measurements.
+	*/
+	struct obstacleTrack{
+		Eigen::Matrix3d state; // row: axis, col: p, v, a
+		Eigen::Matrix3d cov[3]; // covariance of each axis
+		Eigen::Vector3d size;
+		ros::Time stamp; // time of the state
+		ros::Time lastMatched; // time of the last detection of the obstacle
+		bool matched;
+	};
+
+	class obstaclePredictor{
+	private:
+		ros::NodeHandle nh_;
+
+		// parameters
+		int mode_; // 0: constant velocity, 1: Kalman filter with constant acceleration
+		double horizon_;
+		double uncertaintyRate_;
+		double maxUncertainty_;
+		double maxAcc_;
+		double associationDist_;
+		double trackTimeout_;
+		double processNoise_;
+		double posNoise_;
+		double velNoise_;
+		double indexCellSize_;
+		double corridorMargin_;
+		double maxExtrapolation_;
+
+		// latest obstacles used by the prediction
+		AutoFlight::obstacleSnapshotPtr snapshot_;
+		std::vector<Eigen::Vector3d> filteredPos_;
+		std::vector<Eigen::Vector3d> filteredVel_;
+		std::vector<Eigen::Vector3d> filteredAcc_;
+		std::vector<obstacleTrack> tracks_;
+		Eigen::Vector3d robotSize_ = Eigen::Vector3d (0.0, 0.0, 0.0);
+
+		// structure of arrays for the batch collision check (one entry per obstacle)
+		Eigen::ArrayXf batchPos_[3];
+		Eigen::ArrayXf batchVel_[3];
+		Eigen::ArrayXf batchHalfAcc_[3]; // 0.5 * acc
+		Eigen::ArrayXf batchHalfSize_[3]; // inflated by the robot size
+
+		// spatial index over the boxes swept within the horizon
+		AutoFlight::obstacleIndex index_;
+		std::vector<Eigen::Vector3d> sweptLower_;
+		std::vector<Eigen::Vector3d> sweptUpper_;
+		std::vector<int> candidates_;
+
+		// obstacles near the queried trajectory, gathered from the batch arrays
+		Eigen::ArrayXf activePos_[3];
+		Eigen::ArrayXf activeVel_[3];
+		Eigen::ArrayXf activeHalfAcc_[3];
+		Eigen::ArrayXf activeHalfSize_[3];
+		Eigen::ArrayXf gap_;
+
+		// latency from the measurement to the use of the obstacle data
+		double latencySum_ = 0.0;
+		double latencyMax_ = 0.0;
+		int numLatency_ = 0;
+		ros::Time latencyStatTime_;
+
+	public:
+		obstaclePredictor(const ros::NodeHandle& nh);
+		void initParam();
+		void setRobotSize(const Eigen::Vector3d& robotSize);
+
+		// update with the latest snapshot. An already used snapshot is ignored
+		void update(const AutoFlight::obstacleSnapshotPtr& snapshot);
+
+		/*
+			All times are relative to the query time (now). The snapshot is extrapolated
+			from its measurement time, so the age of the data is added to the prediction time.
+		*/
+
+		// box of the obstacle t seconds after the query time. The size grows with the prediction uncertainty
+		void predict(int idx, double t, Eigen::Vector3d& pos, Eigen::Vector3d& size);
+		int getNumObstacles();
+
+		/*
+			Swept AABB test of the polyline points (reached at times, seconds after the query time)
+			against all predicted obstacle boxes. Each segment is tested at once against all
+			obstacles with Eigen packets. Returns the start time of the first conflicting segment.
+		*/
+		bool getEarliestConflict(const std::vector<Eigen::Vector3d>& points, const std::vector<double>& times, double& conflictTime);
+
+		// the same test over the whole polyline. Also returns the smallest clearance to the predicted boxes (at most maxClearance)
+		bool getClearance(const std::vector<Eigen::Vector3d>& points, const std::vector<double>& times, double maxClearance, double& conflictTime, double& minClearance);
+
+		// obstacles whose predicted boxes come within the corridor margin of the path, extrapolated to the query time
+		void getObstaclesNearPath(const nav_msgs::Path& path, std::vector<Eigen::Vector3d>& obstaclesPos, std::vector<Eigen::Vector3d>& obstaclesVel, std::vector<Eigen::Vector3d>& obstaclesSize);
+
+	private:
+		bool sweepTest(const std::vector<Eigen::Vector3d>& points, const std::vector<double>& times, double margin, bool stopAtConflict, double& conflictTime, double& minClearance);
+		void updateTracks();
+		void updateBatchData();
+		void gatherCandidates();
+		double getDataAge();
+		void reportLatency(double age);
+		void predictTrack(obstacleTrack& track, double dt);
+		void correctTrack(obstacleTrack& track, const Eigen::Vector3d& pos, const Eigen::Vector3d& vel);
+		void initTrack(obstacleTrack& track, const Eigen::Vector3d& pos, const Eigen::Vector3d& vel, const Eigen::Vector3d& size);
+	};
+}
+
+#endif
@@ -0,0 +1,212 @@
+/*
+	FILE: obstacleScenario.cpp
+	------------------------
+	obstacle scenario implementation
+*/
+#include <autonomous_flight/px4/obstacleScenario.h>
+#include <algorithm>
+#include <random>
+#include <cmath>
+
+namespace AutoFlight{
+	obstacleScenario::obstacleScenario(const ros::NodeHandle& nh) : nh_(nh){
+		this->initParam();
+		this->loadScriptedObstacles();
+		this->generateRandomObstacles();
+		this->registerCallback();
+		this->startTime_ = ros::Time::now();
+		cout << "[ObstacleScenario]: " << this->obstacles_.size() << " obstacles loaded." << endl;
+	}
+
+	void obstacleScenario::initParam(){
+		// odom topic for the sensor range
+		if (not this->nh_.getParam("obstacle_scenario/odom_topic", this->odomTopic_)){
+			this->odomTopic_ = "/mavros/local_position/odom";
+			cout << "[ObstacleScenario]: No odom topic param found. Use default: /mavros/local_position/odom." << endl;
+		}
+		else{
+			cout << "[ObstacleScenario]: Odom topic is set to: " << this->odomTopic_ << "." << endl;
+		}
+
+		// obstacles within this distance are detected
+		if (not this->nh_.getParam("obstacle_scenario/sensor_range", this->sensorRange_)){
+			this->sensorRange_ = 5.0;
+			cout << "[ObstacleScenario]: No sensor range param found. Use default: 5.0 m." << endl;
+		}
+		else{
+			cout << "[ObstacleScenario]: Sensor range is set to: " << this->sensorRange_ << "m." << endl;
+		}
+
+		// seed of the random obstacles
+		if (not this->nh_.getParam("obstacle_scenario/seed", this->seed_)){
+			this->seed_ = 0;
+			cout << "[ObstacleScenario]: No seed param found. Use default: 0." << endl;
+		}
+		else{
+			cout << "[ObstacleScenario]: Seed is set to: " << this->seed_ << "." << endl;
+		}
+	}
+
+	void obstacleScenario::registerCallback(){
+		this->odomSub_ = this->nh_.subscribe<nav_msgs::Odometry>(this->odomTopic_, 10, &obstacleScenario::odomCB, this);
+	}
+
+	void obstacleScenario::odomCB(const nav_msgs::Odometry::ConstPtr& odom){
+		this->odom_ = *odom;
+		this->odomReceived_ = true;
+	}
+
+	void obstacleScenario::getObstacles(std::vector<onboardDetector::box3D>& obstacles){
+		this->getObstacles((ros::Time::now() - this->startTime_).toSec(), obstacles);
+	}
+
+	void obstacleScenario::getObstaclesInSensorRange(double fov, std::vector<onboardDetector::box3D>& obstacles){
+		std::vector<onboardDetector::box3D> allObstacles;
+		this->getObstacles(allObstacles);
+		for (const onboardDetector::box3D& ob : allObstacles){
+			if (this->isObstacleInSensorRange(ob, fov)){
+				obstacles.push_back(ob);
+			}
+		}
+	}
+
+	bool obstacleScenario::isObstacleInSensorRange(const onboardDetector::box3D& ob, double fov){
+		if (not this->odomReceived_){
+			return false;
+		}
+		Eigen::Vector3d robotPos (this->odom_.pose.pose.position.x, this->odom_.pose.pose.position.y, this->odom_.pose.pose.position.z);
+		Eigen::Vector3d diff = Eigen::Vector3d (ob.x, ob.y, ob.z) - robotPos;
+		if (diff.norm() > this->sensorRange_){
+			return false;
+		}
+
+		// horizontal angle to the heading of the robot
+		const geometry_msgs::Quaternion& quat = this->odom_.pose.pose.orientation;
+		double yaw = atan2(2.0 * (quat.w * quat.z + quat.x * quat.y), 1.0 - 2.0 * (quat.y * quat.y + quat.z * quat.z));
+		double angle = atan2(diff(1), diff(0)) - yaw;
+		angle = atan2(sin(angle), cos(angle));
+		return std::abs(angle) <= fov/2.0;
+	}
+
+	void obstacleScenario::getObstacles(double t, std::vector<onboardDetector::box3D>& obstacles){
+		for (const scriptedObstacle& ob : this->obstacles_){
+			obstacles.push_back(this->getBox(ob, t));
+		}
+	}
+
+	int obstacleScenario::getNumObstacles(){
+		return this->obstacles_.size();
+	}
+
+	void obstacleScenario::loadScriptedObstacles(){
+		int numObstacles;
+		if (not this->nh_.getParam("obstacle_scenario/num_obstacles", numObstacles)){
+			numObstacles = 0;
+		}
+		for (int i=0; i<numObstacles; ++i){
+			std::string prefix = "obstacle_scenario/obstacle" + std::to_string(i) + "/";
+			std::vector<double> waypointsTemp, sizeTemp;
+			double speed, phase;
+			if (not this->nh_.getParam(prefix + "waypoints", waypointsTemp) or waypointsTemp.size() < 3 or waypointsTemp.size() % 3 != 0){
+				cout << "[ObstacleScenario]: Invalid waypoints of obstacle " << i << ". Skip." << endl;
+				continue;
+			}
+			if (not this->nh_.getParam(prefix + "speed", speed)){
+				speed = 1.0;
+			}
+			if (not this->nh_.getParam(prefix + "phase", phase)){
+				phase = 0.0;
+			}
+			if (not this->nh_.getParam(prefix + "size", sizeTemp) or sizeTemp.size() != 3){
+				sizeTemp = {0.5, 0.5, 1.8};
+			}
+			std::vector<Eigen::Vector3d> waypoints;
+			for (size_t j=0; j<waypointsTemp.size(); j+=3){
+				waypoints.push_back(Eigen::Vector3d (waypointsTemp[j], waypointsTemp[j+1], waypointsTemp[j+2]));
+			}
+			this->addObstacle(waypoints, speed, phase, Eigen::Vector3d (sizeTemp[0], sizeTemp[1], sizeTemp[2]));
+		}
+	}
+
+	void obstacleScenario::generateRandomObstacles(){
+		int numObstacles, numWaypoints;
+		std::vector<double> range, speedRange, size;
+		if (not this->nh_.getParam("obstacle_scenario/num_random_obstacles", numObstacles)){
+			numObstacles = 0;
+		}
+		if (not this->nh_.getParam("obstacle_scenario/random_num_waypoints", numWaypoints)){
+			numWaypoints = 2;
+		}
+		if (not this->nh_.getParam("obstacle_scenario/random_range", range) or range.size() != 6){
+			range = {-10.0, 10.0, -10.0, 10.0, 0.9, 0.9}; // xmin, xmax, ymin, ymax, zmin, zmax
+		}
+		if (not this->nh_.getParam("obstacle_scenario/random_speed", speedRange) or speedRange.size() != 2){
+			speedRange = {0.3, 1.0};
+		}
+		if (not this->nh_.getParam("obstacle_scenario/random_size", size) or size.size() != 3){
+			size = {0.5, 0.5, 1.8};
+		}
+
+		// one generator for all obstacles so the scenario only depends on the seed
+		std::mt19937 gen (this->seed_);
+		std::uniform_real_distribution<double> distX (range[0], range[1]);
+		std::uniform_real_distribution<double> distY (range[2], range[3]);
+		std::uniform_real_distribution<double> distZ (range[4], range[5]);
+		std::uniform_real_distribution<double> distSpeed (speedRange[0], speedRange[1]);
+		std::uniform_real_distribution<double> distPhase (0.0, 1.0);
+		for (int i=0; i<numObstacles; ++i){
+			std::vector<Eigen::Vector3d> waypoints;
+			for (int j=0; j<std::max(numWaypoints, 2); ++j){
+				waypoints.push_back(Eigen::Vector3d (distX(gen), distY(gen), distZ(gen)));
+			}
+			double speed = distSpeed(gen);
+			double phaseRatio = distPhase(gen); // start at a random point of the loop
+			this->addObstacle(waypoints, speed, 0.0, Eigen::Vector3d (size[0], size[1], size[2]));
+			this->obstacles_.back().phase = phaseRatio * this->obstacles_.back().cumLength.back();
+		}
+	}
+
+	void obstacleScenario::addObstacle(const std::vector<Eigen::Vector3d>& waypoints, double speed, double phase, const Eigen::Vector3d& size){
+		scriptedObstacle ob;
+		ob.waypoints = waypoints;
+		ob.speed = speed;
+		ob.phase = phase;
+		ob.size = size;
+		ob.cumLength.push_back(0.0);
+		for (size_t i=0; i<waypoints.size(); ++i){
+			const Eigen::Vector3d& next = waypoints[(i+1) % waypoints.size()];
+			ob.cumLength.push_back(ob.cumLength.back() + (next - waypoints[i]).norm());
+		}
+		this->obstacles_.push_back(ob);
+	}
+
+	onboardDetector::box3D obstacleScenario::getBox(const scriptedObstacle& ob, double t){
+		Eigen::Vector3d pos = ob.waypoints[0];
+		Eigen::Vector3d vel (0.0, 0.0, 0.0);
+		double loopLength = ob.cumLength.back();
+		if (loopLength > 0.0){
+			double s = fmod(ob.phase + ob.speed * std::max(t, 0.0), loopLength);
+			size_t seg = std::upper_bound(ob.cumLength.begin(), ob.cumLength.end(), s) - ob.cumLength.begin() - 1;
+			seg = std::min(seg, ob.waypoints.size() - 1);
+			const Eigen::Vector3d& p1 = ob.waypoints[seg];
+			const Eigen::Vector3d& p2 = ob.waypoints[(seg+1) % ob.waypoints.size()];
+			double segLength = ob.cumLength[seg+1] - ob.cumLength[seg];
+			if (segLength > 0.0){
+				Eigen::Vector3d direction = (p2 - p1)/segLength;
+				pos = p1 + direction * (s - ob.cumLength[seg]);
+				vel = direction * ob.speed;
+			}
+		}
+
+		onboardDetector::box3D box {};
+		box.x = pos(0);
+		box.y = pos(1);
+		box.z = pos(2);
+		box.x_width = ob.size(0);
+		box.y_width = ob.size(1);
+		box.z_width = ob.size(2);
+		box.Vx = vel(0);
+		box.Vy = vel(1);
+		return box;
+	}
+}
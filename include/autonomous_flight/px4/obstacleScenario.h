@@ -0,0 +1,73 @@
+/*
+	FILE: obstacleScenario.h
+	------------------------
+	scripted dynamic obstacles with the interface of the fake detector
+*/
+
+#ifndef AUTOFLIGHT_OBSTACLE_SCENARIO_H
+#define AUTOFLIGHT_OBSTACLE_SCENARIO_H
+#include <ros/ros.h>
+#include <onboard_detector/fakeDetector.h>
+#include <nav_msgs/Odometry.h>
+#include <Eigen/Dense>
+#include <vector>
+#include <string>
+
+using std::cout; using std::endl;
+namespace AutoFlight{
+	/*
+		Box moving at constant speed along a closed polyline of waypoints.
+		With two waypoints the box moves back and forth.
+	*/
+	struct scriptedObstacle{
+		std::vector<Eigen::Vector3d> waypoints;
+		std::vector<double> cumLength; // distance along the loop at each waypoint (last entry: loop length)
+		double speed;
+		double phase; // distance along the loop at time zero
+		Eigen::Vector3d size;
+	};
+
+	/*
+		In-process replacement of the Gazebo based fake detector. The obstacles are
+		loaded from params (scripted waypoints and seeded random obstacles), so the
+		same params always give the same obstacle motion.
+	*/
+	class obstacleScenario{
+	private:
+		ros::NodeHandle nh_;
+		ros::Subscriber odomSub_;
+
+		// parameters
+		std::string odomTopic_;
+		double sensorRange_;
+		int seed_;
+
+		std::vector<scriptedObstacle> obstacles_;
+		ros::Time startTime_;
+		nav_msgs::Odometry odom_;
+		bool odomReceived_ = false;
+
+	public:
+		obstacleScenario(const ros::NodeHandle& nh);
+		void initParam();
+		void registerCallback();
+		void odomCB(const nav_msgs::Odometry::ConstPtr& odom);
+
+		// same interface as onboardDetector::fakeDetector
+		void getObstacles(std::vector<onboardDetector::box3D>& obstacles);
+		void getObstaclesInSensorRange(double fov, std::vector<onboardDetector::box3D>& obstacles);
+		bool isObstacleInSensorRange(const onboardDetector::box3D& ob, double fov);
+
+		// obstacles t seconds after the scenario start (independent of the clock)
+		void getObstacles(double t, std::vector<onboardDetector::box3D>& obstacles);
+		int getNumObstacles();
+
+	private:
+		void loadScriptedObstacles();
+		void generateRandomObstacles();
+		void addObstacle(const std::vector<Eigen::Vector3d>& waypoints, double speed, double phase, const Eigen::Vector3d& size);
+		onboardDetector::box3D getBox(const scriptedObstacle& ob, double t);
+	};
+}
+
+#endif
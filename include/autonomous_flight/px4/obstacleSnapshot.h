@@ -0,0 +1,37 @@
+/*
+	FILE: obstacleSnapshot.h
+	------------------------
+	immutable dynamic obstacle snapshot shared by all checks of one cycle
+*/
+
+#ifndef AUTOFLIGHT_OBSTACLE_SNAPSHOT_H
+#define AUTOFLIGHT_OBSTACLE_SNAPSHOT_H
+#include <ros/ros.h>
+#include <Eigen/Dense>
+#include <vector>
+#include <memory>
+
+namespace AutoFlight{
+	/*
+		Obstacles are stored as structure of arrays. seq only increases when
+		the obstacle data changes, so consumers can skip unchanged snapshots.
+	*/
+	struct obstacleSnapshot{
+		ros::Time stamp;
+		unsigned int seq = 0;
+		std::vector<Eigen::Vector3d> pos;
+		std::vector<Eigen::Vector3d> vel;
+		std::vector<Eigen::Vector3d> size;
+
+		int getNumObstacles() const{
+			return this->pos.size();
+		}
+
+		bool hasSameObstacles(const obstacleSnapshot& other) const{
+			return this->pos == other.pos and this->vel == other.vel and this->size == other.size;
+		}
+	};
+	typedef std::shared_ptr<const obstacleSnapshot> obstacleSnapshotPtr;
+}
+
+#endif
@@ -0,0 +1,116 @@
+/*
+	FILE: pathTracker.cpp
+	------------------------
+	progress tracking implementation
+*/
+#include <autonomous_flight/px4/pathTracker.h>
+#include <algorithm>
+#include <limits>
+
+namespace AutoFlight{
+	pathTracker::pathTracker() : searchWindow_(3){}
+
+	pathTracker::pathTracker(int searchWindow) : searchWindow_(searchWindow){}
+
+	void pathTracker::setPath(const nav_msgs::Path& path){
+		this->waypoints_.clear();
+		this->accLength_.clear();
+		double length = 0.0;
+		for (size_t i=0; i<path.poses.size(); ++i){
+			Eigen::Vector3d p (path.poses[i].pose.position.x, path.poses[i].pose.position.y, path.poses[i].pose.position.z);
+			if (i != 0){
+				length += (p - this->waypoints_.back()).norm();
+			}
+			this->waypoints_.push_back(p);
+			this->accLength_.push_back(length);
+		}
+
+		// the rest path is built once here and only shrinks from the front when the segment advances
+		this->restPath_.header = path.header;
+		this->restPath_.poses.clear();
+		this->restPath_.poses.push_back(geometry_msgs::PoseStamped()); // placeholder of the robot pose
+		for (size_t i=1; i<path.poses.size(); ++i){
+			this->restPath_.poses.push_back(path.poses[i]);
+		}
+		if (path.poses.size() == 1){
+			this->restPath_.poses.push_back(path.poses[0]);
+		}
+		this->segIdx_ = 0;
+		this->numConsumed_ = 0;
+		this->init_ = true;
+	}
+
+	void pathTracker::reset(){
+		this->waypoints_.clear();
+		this->accLength_.clear();
+		this->restPath_.poses.clear();
+		this->segIdx_ = 0;
+		this->numConsumed_ = 0;
+		this->init_ = false;
+	}
+
+	bool pathTracker::isInit(){
+		return this->init_;
+	}
+
+	int pathTracker::update(const Eigen::Vector3d& pos){
+		int numSeg = int(this->waypoints_.size()) - 1;
+		if (numSeg <= 0){
+			return this->segIdx_;
+		}
+
+		int bestIdx = this->segIdx_;
+		double minDist = std::numeric_limits<double>::infinity();
+		int endIdx = std::min(this->segIdx_ + this->searchWindow_, numSeg);
+		for (int i=this->segIdx_; i<endIdx; ++i){
+			const Eigen::Vector3d& pStart = this->waypoints_[i];
+			Eigen::Vector3d seg = this->waypoints_[i+1] - pStart;
+			double segLengthSqr = seg.squaredNorm();
+			double t = 0.0;
+			if (segLengthSqr > 1e-12){
+				t = std::min(std::max((pos - pStart).dot(seg)/segLengthSqr, 0.0), 1.0);
+			}
+			double dist = (pos - (pStart + t * seg)).squaredNorm();
+			if (dist <= minDist){ // prefer the later segment on ties (robot has passed the shared waypoint)
+				minDist = dist;
+				bestIdx = i;
+			}
+		}
+
+		// the passed waypoints are only counted here and removed at once by the next rest path request
+		if (bestIdx > this->segIdx_){
+			this->numConsumed_ += bestIdx - this->segIdx_;
+			this->segIdx_ = bestIdx;
+		}
+		return this->segIdx_;
+	}
+
+	int pathTracker::getSegmentIdx(){
+		return this->segIdx_;
+	}
+
+	int pathTracker::getNextIdx(){
+		return std::min(this->segIdx_ + 1, int(this->waypoints_.size()) - 1);
+	}
+
+	const nav_msgs::Path& pathTracker::getRestPath(const geometry_msgs::Pose& psCurr){
+		if (this->restPath_.poses.size() == 0){
+			this->restPath_.poses.push_back(geometry_msgs::PoseStamped());
+		}
+		int numErase = std::min(this->numConsumed_, int(this->restPath_.poses.size()) - 2); // the last waypoint stays
+		if (numErase > 0){
+			this->restPath_.poses.erase(this->restPath_.poses.begin()+1, this->restPath_.poses.begin()+1+numErase);
+		}
+		this->numConsumed_ = 0;
+		this->restPath_.poses[0].pose = psCurr;
+		return this->restPath_;
+	}
+
+	double pathTracker::getRemainLength(const Eigen::Vector3d& pos){
+		if (this->waypoints_.size() == 0){
+			return 0.0;
+		}
+		int nextIdx = this->getNextIdx();
+		return (this->accLength_.back() - this->accLength_[nextIdx]) + (this->waypoints_[nextIdx] - pos).norm();
+	}
+}
@@ -0,0 +1,41 @@
+/*
+	FILE: pathTracker.h
+	------------------------
+	progress tracking along the global waypoint path
+*/
+
+#ifndef AUTOFLIGHT_PATH_TRACKER_H
+#define AUTOFLIGHT_PATH_TRACKER_H
+#include <nav_msgs/Path.h>
+#include <Eigen/Dense>
+#include <vector>
+
+namespace AutoFlight{
+	class pathTracker{
+	private:
+		std::vector<Eigen::Vector3d> waypoints_;
+		std::vector<double> accLength_; // accumulated path length at each waypoint
+		nav_msgs::Path restPath_; // first pose is the robot pose, then the waypoints after the current segment
+		int numConsumed_ = 0; // waypoints passed since the rest path was last requested (removed on the request)
+		int segIdx_ = 0; // current segment: waypoints_[segIdx_] -> waypoints_[segIdx_+1]
+		int searchWindow_;
+		bool init_ = false;
+
+	public:
+		pathTracker();
+		pathTracker(int searchWindow);
+
+		void setPath(const nav_msgs::Path& path);
+		void reset();
+		bool isInit();
+
+		// project the position onto the next few segments and advance (never go back)
+		int update(const Eigen::Vector3d& pos);
+		int getSegmentIdx();
+		int getNextIdx();
+		const nav_msgs::Path& getRestPath(const geometry_msgs::Pose& psCurr);
+		double getRemainLength(const Eigen::Vector3d& pos);
+	};
+}
+
+#endif
@@ -0,0 +1,164 @@
+/*
+	FILE: replanEngine.cpp
+	------------------------
+	replan engine implementation
+*/
+#include <autonomous_flight/px4/replanEngine.h>
+#include <algorithm>
+
+namespace AutoFlight{
+	replanEngine::replanEngine(const ros::NodeHandle& nh) : nh_(nh){
+		this->initParam();
+		this->registerPub();
+	}
+
+	void replanEngine::initParam(){
+		// time budget of the triggers in each check
+		if (not this->nh_.getParam("replan_engine/budget", this->budget_)){
+			this->budget_ = 0.002;
+			cout << "[ReplanEngine]: No budget param found. Use default: 0.002 s." << endl;
+		}
+		else{
+			cout << "[ReplanEngine]: Budget is set to: " << this->budget_ << "s." << endl;
+		}
+
+		// non urgent triggers are suppressed for this time after a trigger fired
+		if (not this->nh_.getParam("replan_engine/hold_time", this->holdTime_)){
+			this->holdTime_ = 0.2;
+			cout << "[ReplanEngine]: No hold time param found. Use default: 0.2 s." << endl;
+		}
+		else{
+			cout << "[ReplanEngine]: Hold time is set to: " << this->holdTime_ << "s." << endl;
+		}
+
+		// a trigger deferred by the budget this many times in a row runs anyway
+		if (not this->nh_.getParam("replan_engine/max_deferral", this->maxDeferral_)){
+			this->maxDeferral_ = 5;
+			cout << "[ReplanEngine]: No max deferral param found. Use default: 5." << endl;
+		}
+		else{
+			cout << "[ReplanEngine]: Max deferral is set to: " << this->maxDeferral_ << "." << endl;
+		}
+	}
+
+	void replanEngine::registerPub(){
+		this->statPub_ = this->nh_.advertise<std_msgs::Float64MultiArray>("autonomous_flight/replan_triggers", 10);
+	}
+
+	void replanEngine::addTrigger(const std::string& name, int priority, double cost, double minPeriod, bool urgent, const std::function<bool()>& check){
+		replanTrigger trigger;
+		trigger.name = name;
+		trigger.check = check;
+		trigger.priority = priority;
+		trigger.cost = cost;
+		trigger.minPeriod = minPeriod;
+		trigger.urgent = urgent;
+		this->triggers_.push_back(trigger);
+
+		// triggers of the same priority keep the order of registration
+		std::stable_sort(this->triggers_.begin(), this->triggers_.end(), [](const replanTrigger& t1, const replanTrigger& t2){
+			return t1.priority < t2.priority;
+		});
+	}
+
+	int replanEngine::run(){
+		ros::Time currTime = ros::Time::now();
+		ros::WallTime startTime = ros::WallTime::now();
+		bool hold = not this->lastFireTime_.isZero() and (currTime - this->lastFireTime_).toSec() < this->holdTime_;
+		int firedIdx = -1;
+		for (size_t i=0; i<this->triggers_.size(); ++i){
+			replanTrigger& trigger = this->triggers_[i];
+			if (not trigger.lastRun.isZero() and (currTime - trigger.lastRun).toSec() < trigger.minPeriod){
+				continue;
+			}
+
+			if (not trigger.urgent){
+				if (hold){
+					++trigger.numSkipped;
+					continue;
+				}
+				double spentTime = (ros::WallTime::now() - startTime).toSec();
+				if (spentTime + trigger.cost > this->budget_ and trigger.numDeferred < this->maxDeferral_){
+					++trigger.numDeferred;
+					++trigger.numSkipped;
+					continue;
+				}
+			}
+
+			ros::WallTime triggerStartTime = ros::WallTime::now();
+			bool fire = trigger.check();
+			double time = (ros::WallTime::now() - triggerStartTime).toSec();
+			trigger.cost = 0.9 * trigger.cost + 0.1 * time;
+			trigger.lastRun = currTime;
+			trigger.numDeferred = 0;
+			++trigger.numRuns;
+			trigger.totalTime += time;
+			if (trigger.urgent and (ros::WallTime::now() - startTime).toSec() > this->budget_){
+				++trigger.numOverruns;
+			}
+			if (fire){
+				++trigger.numFires;
+				this->lastFireTime_ = currTime;
+				firedIdx = i;
+				break;
+			}
+		}
+
+		this->publishStat();
+		this->reportStat();
+		return firedIdx;
+	}
+
+	const std::string& replanEngine::getTriggerName(int idx){
+		return this->triggers_[idx].name;
+	}
+
+	void replanEngine::publishStat(){
+		ros::Time currTime = ros::Time::now();
+		if ((currTime - this->lastPubTime_).toSec() < 1.0){
+			return;
+		}
+		this->lastPubTime_ = currTime;
+
+		// one row per trigger: runs, fires, skipped, time (ms), budget overruns. The trigger names are the label of the first dimension
+		this->statMsg_.layout.dim.resize(2);
+		this->statMsg_.layout.dim[0].label = "";
+		for (size_t i=0; i<this->triggers_.size(); ++i){
+			this->statMsg_.layout.dim[0].label += (i == 0 ? "" : ",") + this->triggers_[i].name;
+		}
+		this->statMsg_.layout.dim[0].size = this->triggers_.size();
+		this->statMsg_.layout.dim[0].stride = 5 * this->triggers_.size();
+		this->statMsg_.layout.dim[1].label = "runs,fires,skipped,time_ms,overruns";
+		this->statMsg_.layout.dim[1].size = 5;
+		this->statMsg_.layout.dim[1].stride = 5;
+		this->statMsg_.data.clear();
+		for (const replanTrigger& trigger : this->triggers_){
+			this->statMsg_.data.push_back(trigger.numRuns);
+			this->statMsg_.data.push_back(trigger.numFires);
+			this->statMsg_.data.push_back(trigger.numSkipped);
+			this->statMsg_.data.push_back(1000.0 * trigger.totalTime);
+			this->statMsg_.data.push_back(trigger.numOverruns);
+		}
+		this->statPub_.publish(this->statMsg_);
+	}
+
+	void replanEngine::reportStat(){
+		ros::Time currTime = ros::Time::now();
+		double statTime = (currTime - this->lastReportTime_).toSec();
+		if (statTime < 10.0){
+			return;
+		}
+		if (not this->lastReportTime_.isZero() and this->lastReport_.size() == this->triggers_.size()){
+			cout << "[ReplanEngine]: Triggers in the last " << statTime << "s (runs/fires/skipped/ms/overruns):";
+			for (size_t i=0; i<this->triggers_.size(); ++i){
+				const replanTrigger& trigger = this->triggers_[i];
+				const replanTrigger& prev = this->lastReport_[i];
+				cout << " " << trigger.name << " " << trigger.numRuns - prev.numRuns << "/" << trigger.numFires - prev.numFires
+				     << "/" << trigger.numSkipped - prev.numSkipped << "/" << 1000.0 * (trigger.totalTime - prev.totalTime) << "/" << trigger.numOverruns - prev.numOverruns;
+			}
+			cout << "." << endl;
+		}
+		this->lastReport_ = this->triggers_;
+		this->lastReportTime_ = currTime;
+	}
+}
@@ -0,0 +1,73 @@
+/*
+	FILE: replanEngine.h
+	------------------------
+	run the replan triggers by priority under a time budget per check
+*/
+
+#ifndef AUTOFLIGHT_REPLAN_ENGINE_H
+#define AUTOFLIGHT_REPLAN_ENGINE_H
+#include <ros/ros.h>
+#include <std_msgs/Float64MultiArray.h>
+#include <functional>
+#include <vector>
+#include <string>
+
+using std::cout; using std::endl;
+namespace AutoFlight{
+	/*
+		A trigger returns true when it decided the outcome of the check (it requested
+		or cancelled a replan), and the remaining triggers are skipped.
+	*/
+	struct replanTrigger{
+		std::string name;
+		std::function<bool()> check;
+		int priority; // lower runs first
+		double cost; // estimated run time (s), updated with the measured time
+		double minPeriod; // minimum time between two runs (s)
+		bool urgent; // ignores the budget and the hold time
+
+		ros::Time lastRun;
+		int numDeferred = 0;
+
+		// cumulative statistics
+		int numRuns = 0;
+		int numFires = 0;
+		int numSkipped = 0; // deferred by the budget or suppressed by the hold time
+		int numOverruns = 0; // urgent runs that ended the check over the budget
+		double totalTime = 0.0;
+	};
+
+	class replanEngine{
+	private:
+		ros::NodeHandle nh_;
+		ros::Publisher statPub_;
+
+		// parameters
+		double budget_;
+		double holdTime_;
+		int maxDeferral_;
+
+		std::vector<replanTrigger> triggers_;
+		ros::Time lastFireTime_;
+		ros::Time lastPubTime_;
+		ros::Time lastReportTime_;
+		std::vector<replanTrigger> lastReport_;
+		std_msgs::Float64MultiArray statMsg_;
+
+	public:
+		replanEngine(const ros::NodeHandle& nh);
+		void initParam();
+		void registerPub();
+		void addTrigger(const std::string& name, int priority, double cost, double minPeriod, bool urgent, const std::function<bool()>& check);
+
+		// run the due triggers until one fires. Returns the index of the fired trigger or -1
+		int run();
+		const std::string& getTriggerName(int idx);
+
+	private:
+		void publishStat();
+		void reportStat();
+	};
+}
+
+#endif
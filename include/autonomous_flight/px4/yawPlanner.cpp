@@ -0,0 +1,289 @@
+/*
+	FILE: yawPlanner.cpp
+	------------------------
+	yaw planner implementation
+*/
+#include <autonomous_flight/px4/yawPlanner.h>
+#include <autonomous_flight/px4/utils.h>
+#include <limits>
+#include <algorithm>
+
+namespace AutoFlight{
+	yawPlanner::yawPlanner(){}
+
+	void yawPlanner::setMode(YAW_MODE mode){
+		this->mode_ = mode;
+	}
+
+	void yawPlanner::setMaxAngularVel(double maxAngularVel){
+		this->maxAngularVel_ = maxAngularVel;
+	}
+
+	bool yawPlanner::getMode(const std::string& name, YAW_MODE& mode){
+		if (name == "velocity"){
+			mode = YAW_MODE::FACE_VELOCITY;
+		}
+		else if (name == "goal"){
+			mode = YAW_MODE::FACE_GOAL;
+		}
+		else if (name == "waypoint"){
+			mode = YAW_MODE::FACE_WAYPOINT;
+		}
+		else if (name == "unknown"){
+			mode = YAW_MODE::FACE_UNKNOWN;
+		}
+		else{
+			return false;
+		}
+		return true;
+	}
+
+	void yawPlanner::setMap(const std::shared_ptr<mapManager::occMap>& map){
+		this->map_ = map;
+	}
+
+	void yawPlanner::setFrustum(double hfov, double vfov, double range, int numYaw){
+		// rays of the frustum for each candidate yaw. The rays are 2 coarse steps apart at the range and sampled at the map resolution, so a wall is not skipped
+		this->hfov_ = hfov;
+		this->range_ = range;
+		this->stencilYaw_.clear();
+		this->stencil_.clear();
+		double res = this->map_->getRes();
+		double angleStep = 4 * res / range;
+		std::vector<std::vector<Eigen::Vector3d>> frustum;
+		for (double az=-hfov/2; az<=hfov/2; az+=angleStep){
+			for (double el=-vfov/2; el<=vfov/2; el+=angleStep){
+				Eigen::Vector3d direction (cos(el) * cos(az), cos(el) * sin(az), sin(el));
+				std::vector<Eigen::Vector3d> ray;
+				for (double d=res; d<=range; d+=res){
+					ray.push_back(d * direction);
+				}
+				frustum.push_back(ray);
+			}
+		}
+		for (int i=0; i<numYaw; ++i){
+			double yaw = -PI_const + 2 * PI_const * i / numYaw;
+			Eigen::Matrix3d rot = Eigen::AngleAxisd (yaw, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+			std::vector<std::vector<Eigen::Vector3d>> stencil;
+			stencil.reserve(frustum.size());
+			for (const std::vector<Eigen::Vector3d>& ray : frustum){
+				std::vector<Eigen::Vector3d> rayRot;
+				rayRot.reserve(ray.size());
+				for (const Eigen::Vector3d& p : ray){
+					rayRot.push_back(rot * p);
+				}
+				stencil.push_back(rayRot);
+			}
+			this->stencilYaw_.push_back(yaw);
+			this->stencil_.push_back(stencil);
+		}
+	}
+
+	void yawPlanner::plan(const trajPlanner::bspline& trajectory, double linearFactor, double startYaw, const nav_msgs::Path& waypoints){
+		this->plan(trajectory, [linearFactor](double realTime){return realTime * linearFactor;}, trajectory.getDuration() / linearFactor, startYaw, waypoints);
+	}
+
+	void yawPlanner::plan(const trajPlanner::bspline& trajectory, const std::function<double(double)>& trajTimeAt, double duration, double startYaw, const nav_msgs::Path& waypoints){
+		int numSamples = std::max(int(duration / this->dt_), 0) + 1;
+		double trajDuration = trajectory.getDuration();
+		this->sampleTimes_.resize(numSamples);
+		for (int i=0; i<numSamples; ++i){
+			this->sampleTimes_[i] = std::min(std::max(trajTimeAt(std::min(i * this->dt_, duration)), 0.0), trajDuration);
+		}
+		this->holdYaw_ = startYaw;
+		std::vector<double> reference;
+		this->getReference(trajectory, startYaw, waypoints, reference);
+
+		// unwrap to turn the short way between the samples
+		double prevYaw = startYaw;
+		for (double& yaw : reference){
+			yaw = prevYaw + atan2(sin(yaw - prevYaw), cos(yaw - prevYaw));
+			prevYaw = yaw;
+		}
+
+		// backward pass starts the turns early, forward pass starts from the current yaw
+		double maxTurn = this->maxAngularVel_ * this->dt_;
+		for (int i=int(reference.size())-2; i>=0; --i){
+			reference[i] = std::min(std::max(reference[i], reference[i+1] - maxTurn), reference[i+1] + maxTurn);
+		}
+		this->yaw_.resize(reference.size());
+		prevYaw = startYaw;
+		for (size_t i=0; i<reference.size(); ++i){
+			this->yaw_[i] = std::min(std::max(reference[i], prevYaw - maxTurn), prevYaw + maxTurn);
+			prevYaw = this->yaw_[i];
+		}
+		this->init_ = this->yaw_.size() != 0;
+	}
+
+	bool yawPlanner::isInit(){
+		return this->init_;
+	}
+
+	void yawPlanner::reset(){
+		this->sampleTimes_.clear();
+		this->yaw_.clear();
+		this->init_ = false;
+	}
+
+	double yawPlanner::at(double trajTime){
+		if (this->yaw_.size() == 0){
+			return atan2(sin(this->holdYaw_), cos(this->holdYaw_));
+		}
+
+		// the sample times increase along the trajectory
+		int i = int(std::upper_bound(this->sampleTimes_.begin(), this->sampleTimes_.end(), trajTime) - this->sampleTimes_.begin()) - 1;
+		double yaw;
+		if (i < 0){
+			yaw = this->yaw_.front();
+		}
+		else if (i + 1 >= int(this->yaw_.size())){
+			yaw = this->yaw_.back();
+		}
+		else{
+			double span = this->sampleTimes_[i+1] - this->sampleTimes_[i];
+			double ratio = (span > 0.0) ? (trajTime - this->sampleTimes_[i]) / span : 0.0;
+			yaw = (1.0 - ratio) * this->yaw_[i] + ratio * this->yaw_[i+1];
+		}
+		this->holdYaw_ = yaw;
+		return atan2(sin(yaw), cos(yaw));
+	}
+
+	double yawPlanner::getTimeScale(int i){
+		int numSamples = this->sampleTimes_.size();
+		if (numSamples < 2){
+			return 1.0;
+		}
+		int i0 = std::max(i - 1, 0);
+		int i1 = std::min(i + 1, numSamples - 1);
+		return (this->sampleTimes_[i1] - this->sampleTimes_[i0]) / ((i1 - i0) * this->dt_);
+	}
+
+	void yawPlanner::getReference(const trajPlanner::bspline& trajectory, double startYaw, const nav_msgs::Path& waypoints, std::vector<double>& reference){
+		double duration = trajectory.getDuration();
+		int numSamples = this->sampleTimes_.size();
+		reference.clear();
+		reference.reserve(numSamples);
+
+		YAW_MODE mode = this->mode_;
+		if (mode == YAW_MODE::FACE_UNKNOWN and this->stencil_.size() == 0){ // no frustum is set
+			mode = YAW_MODE::FACE_VELOCITY;
+		}
+
+		if (mode == YAW_MODE::FACE_VELOCITY){
+			trajPlanner::bspline velTraj = trajectory.getDerivative();
+			double yaw = startYaw;
+			for (int i=0; i<numSamples; ++i){
+				Eigen::Vector3d vel = velTraj.at(this->sampleTimes_[i]) * this->getTimeScale(i);
+				if (vel.head<2>().norm() >= this->minSpeed_){
+					yaw = atan2(vel(1), vel(0));
+				}
+				reference.push_back(yaw);
+			}
+		}
+		else if (mode == YAW_MODE::FACE_GOAL){
+			double yaw = startYaw;
+			Eigen::Vector3d pGoal = trajectory.at(duration);
+			if (waypoints.poses.size() != 0){
+				pGoal = Eigen::Vector3d (waypoints.poses.back().pose.position.x, waypoints.poses.back().pose.position.y, waypoints.poses.back().pose.position.z);
+			}
+			for (int i=0; i<numSamples; ++i){
+				Eigen::Vector3d direction = pGoal - trajectory.at(this->sampleTimes_[i]);
+				if (direction.head<2>().norm() >= this->minGoalDistance_){
+					yaw = atan2(direction(1), direction(0));
+				}
+				reference.push_back(yaw);
+			}
+		}
+		else if (mode == YAW_MODE::FACE_UNKNOWN){
+			// the yaw is chosen every info period and the rate limit turns smoothly between them
+			trajPlanner::bspline velTraj = trajectory.getDerivative();
+			int period = std::max(int(this->infoPeriod_ / this->dt_), 1);
+			double yaw = startYaw;
+			for (int i=0; i<numSamples; ++i){
+				if (i % period == 0){
+					Eigen::Vector3d vel = velTraj.at(this->sampleTimes_[i]) * this->getTimeScale(i);
+					yaw = this->getUnknownYaw(trajectory.at(this->sampleTimes_[i]), vel, yaw);
+				}
+				reference.push_back(yaw);
+			}
+		}
+		else{
+			// key yaws at the samples closest to the waypoints (in order along the trajectory)
+			std::vector<std::pair<int, double>> keys {{0, startYaw}};
+			int startIdx = 0;
+			for (size_t w=1; w<waypoints.poses.size(); ++w){ // the first pose is the start
+				Eigen::Vector3d pWp (waypoints.poses[w].pose.position.x, waypoints.poses[w].pose.position.y, waypoints.poses[w].pose.position.z);
+				int bestIdx = numSamples - 1;
+				double minDist = std::numeric_limits<double>::infinity();
+				for (int i=startIdx; i<numSamples; ++i){
+					double dist = (trajectory.at(this->sampleTimes_[i]) - pWp).norm();
+					if (dist < minDist){
+						minDist = dist;
+						bestIdx = i;
+					}
+				}
+				startIdx = bestIdx;
+				double yaw = AutoFlight::rpy_from_quaternion(waypoints.poses[w].pose.orientation);
+				double prevYaw = keys.back().second;
+				yaw = prevYaw + atan2(sin(yaw - prevYaw), cos(yaw - prevYaw));
+				if (bestIdx == keys.back().first){
+					keys.back().second = yaw;
+				}
+				else{
+					keys.push_back(std::make_pair(bestIdx, yaw));
+				}
+			}
+
+			// interpolate between the keys and hold the last one
+			size_t k = 0;
+			for (int i=0; i<numSamples; ++i){
+				while (k + 1 < keys.size() and keys[k+1].first <= i){
+					++k;
+				}
+				if (k + 1 < keys.size()){
+					double ratio = double(i - keys[k].first) / (keys[k+1].first - keys[k].first);
+					reference.push_back(keys[k].second + ratio * (keys[k+1].second - keys[k].second));
+				}
+				else{
+					reference.push_back(keys[k].second);
+				}
+			}
+		}
+	}
+
+	double yawPlanner::getUnknownYaw(const Eigen::Vector3d& pos, const Eigen::Vector3d& vel, double prevYaw){
+		prevYaw = atan2(sin(prevYaw), cos(prevYaw));
+		bool moving = vel.head<2>().norm() >= this->minSpeed_;
+		double velYaw = atan2(vel(1), vel(0));
+		double bestYaw = moving ? velYaw : prevYaw;
+		double bestScore = 0.0;
+		for (size_t i=0; i<this->stencil_.size(); ++i){
+			// the flight direction stays in the field of view
+			if (moving and AutoFlight::getAngleDiff(this->stencilYaw_[i], velYaw) > this->hfov_/2){
+				continue;
+			}
+
+			// the camera does not see behind the first occupied voxel. A ray sample covers a volume growing with the squared distance
+			double unknownVolume = 0.0;
+			for (const std::vector<Eigen::Vector3d>& ray : this->stencil_[i]){
+				for (const Eigen::Vector3d& offset : ray){
+					Eigen::Vector3d p = pos + offset;
+					if (not this->map_->isInMap(p) or this->map_->isOccupied(p)){
+						break;
+					}
+					if (this->map_->isUnknown(p)){
+						unknownVolume += offset.squaredNorm() / (this->range_ * this->range_);
+					}
+				}
+			}
+
+			// small preference for the yaws close to the previous one against flipping between similar views
+			double score = unknownVolume * (1.0 - 0.2 * AutoFlight::getAngleDiff(this->stencilYaw_[i], prevYaw) / PI_const);
+			if (score > bestScore){
+				bestScore = score;
+				bestYaw = this->stencilYaw_[i];
+			}
+		}
+		return bestYaw;
+	}
+}
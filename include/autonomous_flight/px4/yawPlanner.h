@@ -0,0 +1,80 @@
+/*
+	FILE: yawPlanner.h
+	------------------------
+	yaw trajectory planned along the position trajectory
+*/
+
+#ifndef AUTOFLIGHT_YAW_PLANNER_H
+#define AUTOFLIGHT_YAW_PLANNER_H
+#include <trajectory_planner/bsplineTraj.h>
+#include <map_manager/occupancyMap.h>
+#include <nav_msgs/Path.h>
+#include <Eigen/Dense>
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+
+namespace AutoFlight{
+	enum YAW_MODE{
+		FACE_VELOCITY = 0, // heading of the trajectory velocity
+		FACE_GOAL = 1, // toward the last waypoint
+		FACE_WAYPOINT = 2, // orientation of each waypoint, reached where the trajectory passes it
+		FACE_UNKNOWN = 3, // most unknown voxels in the camera frustum, keeping the flight direction in view
+	};
+
+	/*
+		The reference yaw of the mode is sampled along the trajectory and then limited to the
+		max angular velocity, backward first (a turn starts early enough to be done in time)
+		and then forward from the start yaw. Where the reference is undefined (low speed,
+		close to the goal) the previous reference is held, so the yaw does not jitter.
+	*/
+	class yawPlanner{
+	private:
+		YAW_MODE mode_ = YAW_MODE::FACE_VELOCITY;
+		double maxAngularVel_ = 0.5;
+		double minSpeed_ = 0.3; // m/s, below this the velocity heading is held
+		double minGoalDistance_ = 0.5; // m, below this the goal heading is held
+		double dt_ = 0.05; // s, sample time
+
+		// unknown voxels are counted along the rays of a frustum stencil per candidate yaw. A ray stops at the first occupied voxel
+		std::shared_ptr<mapManager::occMap> map_;
+		double hfov_ = 1.57;
+		double range_ = 5.0;
+		double infoPeriod_ = 0.5; // s, time between two frustum evaluations
+		std::vector<double> stencilYaw_;
+		std::vector<std::vector<std::vector<Eigen::Vector3d>>> stencil_; // yaw -> ray -> offsets from near to far
+
+		std::vector<double> sampleTimes_; // trajectory time at each sample (samples are dt apart in real time)
+		std::vector<double> yaw_; // unwrapped yaw at each sample
+		double holdYaw_ = 0.0; // returned when there is no plan
+		bool init_ = false;
+
+	public:
+		yawPlanner();
+		void setMode(YAW_MODE mode);
+		void setMaxAngularVel(double maxAngularVel);
+		static bool getMode(const std::string& name, YAW_MODE& mode);
+
+		// camera frustum for the unknown mode. The stencil is built with the map resolution
+		void setMap(const std::shared_ptr<mapManager::occMap>& map);
+		void setFrustum(double hfov, double vfov, double range, int numYaw=12);
+
+		// linearFactor converts the trajectory time to real time (real = traj / factor). Waypoints are the path the trajectory follows
+		void plan(const trajPlanner::bspline& trajectory, double linearFactor, double startYaw, const nav_msgs::Path& waypoints);
+		// trajTimeAt maps the real time in [0, duration] to the trajectory time (e.g. from the time optimizer)
+		void plan(const trajPlanner::bspline& trajectory, const std::function<double(double)>& trajTimeAt, double duration, double startYaw, const nav_msgs::Path& waypoints);
+		bool isInit();
+		void reset();
+
+		// yaw in [-pi, pi] at the trajectory time. Without a plan the last yaw (or the start yaw) is held
+		double at(double trajTime);
+
+	private:
+		void getReference(const trajPlanner::bspline& trajectory, double startYaw, const nav_msgs::Path& waypoints, std::vector<double>& reference);
+		double getTimeScale(int i); // trajectory time over real time at the sample
+		double getUnknownYaw(const Eigen::Vector3d& pos, const Eigen::Vector3d& vel, double prevYaw);
+	};
+}
+
+#endif
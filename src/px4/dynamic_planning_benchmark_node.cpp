@@ -0,0 +1,145 @@
+/*
+	FILE: dynamic_planning_benchmark_node.cpp
+	-----------------------------
+	planning latency and success rate of the B-spline planner against scripted dynamic obstacles
+*/
+
+#include <ros/ros.h>
+#include <autonomous_flight/px4/obstacleScenario.h>
+#include <autonomous_flight/px4/obstaclePredictor.h>
+#include <trajectory_planner/piecewiseLinearTraj.h>
+#include <trajectory_planner/bsplineTraj.h>
+#include <random>
+
+// the trajectory is checked against the true obstacle motion of the scenario
+bool isTrajectoryValid(const trajPlanner::bspline& trajectory, double linearReparamFactor, double startTime,
+                       AutoFlight::obstacleScenario& scenario, const std::shared_ptr<mapManager::occMap>& map){
+	Eigen::Vector3d robotSize = map->getRobotSize();
+	for (double t=0.0; t<=trajectory.getDuration(); t+=0.05){
+		Eigen::Vector3d p = trajectory.at(t);
+		if (map->isInflatedOccupied(p)){
+			return false;
+		}
+		std::vector<onboardDetector::box3D> obstacles;
+		scenario.getObstacles(startTime + t/linearReparamFactor, obstacles);
+		for (const onboardDetector::box3D& ob : obstacles){
+			if (std::abs(ob.x - p(0)) <= (ob.x_width + robotSize(0))/2.0 and
+				std::abs(ob.y - p(1)) <= (ob.y_width + robotSize(1))/2.0 and
+				std::abs(ob.z - p(2)) <= (ob.z_width + robotSize(2))/2.0){
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv){
+	ros::init(argc, argv, "dynamic_planning_benchmark_node");
+	ros::NodeHandle nh;
+
+	int numQueries, seed;
+	double mapWaitTime, minQueryDist, queryInterval, height, desiredVel, desiredAcc;
+	std::vector<double> sampleRange;
+	std::vector<int> obstacleCounts;
+	if (not nh.getParam("dynamic_planning_benchmark/num_queries", numQueries)) numQueries = 50;
+	if (not nh.getParam("dynamic_planning_benchmark/seed", seed)) seed = 0;
+	if (not nh.getParam("dynamic_planning_benchmark/map_wait_time", mapWaitTime)) mapWaitTime = 3.0;
+	if (not nh.getParam("dynamic_planning_benchmark/min_query_distance", minQueryDist)) minQueryDist = 5.0;
+	if (not nh.getParam("dynamic_planning_benchmark/query_interval", queryInterval)) queryInterval = 1.0;
+	if (not nh.getParam("dynamic_planning_benchmark/sample_range", sampleRange) or sampleRange.size() < 4) sampleRange = {-10, 10, -10, 10};
+	if (not nh.getParam("dynamic_planning_benchmark/obstacle_counts", obstacleCounts)) obstacleCounts = {1, 10, 50, 100, 200};
+	if (not nh.getParam("dynamic_planning_benchmark/height", height)) height = 1.0;
+	if (not nh.getParam("dynamic_planning_benchmark/desired_velocity", desiredVel)) desiredVel = 1.5;
+	if (not nh.getParam("dynamic_planning_benchmark/desired_acceleration", desiredAcc)) desiredAcc = 1.5;
+
+	ros::AsyncSpinner spinner (1);
+	spinner.start();
+
+	std::shared_ptr<mapManager::occMap> map;
+	map.reset(new mapManager::occMap (nh));
+	ros::Duration(mapWaitTime).sleep(); // wait for the prebuilt map
+
+	trajPlanner::pwlTraj pwlTraj (nh);
+	trajPlanner::bsplineTraj bsplineTraj (nh);
+	bsplineTraj.setMap(map);
+	bsplineTraj.updateMaxVel(desiredVel);
+	bsplineTraj.updateMaxAcc(desiredAcc);
+	AutoFlight::obstaclePredictor predictor (nh);
+	predictor.setRobotSize(map->getRobotSize());
+
+	// the same queries are used for all obstacle counts
+	std::mt19937 gen (seed);
+	std::uniform_real_distribution<double> distX (sampleRange[0], sampleRange[1]);
+	std::uniform_real_distribution<double> distY (sampleRange[2], sampleRange[3]);
+	std::vector<std::pair<Eigen::Vector3d, Eigen::Vector3d>> queries;
+	int numSampleTrial = 0;
+	while (int(queries.size()) < numQueries and numSampleTrial < numQueries * 1000){
+		++numSampleTrial;
+		Eigen::Vector3d pStart (distX(gen), distY(gen), height);
+		Eigen::Vector3d pGoal (distX(gen), distY(gen), height);
+		if ((pGoal - pStart).norm() < minQueryDist) continue;
+		if (not map->isInMap(pStart) or map->isInflatedOccupied(pStart)) continue;
+		if (not map->isInMap(pGoal) or map->isInflatedOccupied(pGoal)) continue;
+		queries.push_back({pStart, pGoal});
+	}
+	cout << "[Benchmark]: " << queries.size() << " queries sampled." << endl;
+
+	for (int numObstacles : obstacleCounts){
+		nh.setParam("obstacle_scenario/num_random_obstacles", numObstacles);
+		AutoFlight::obstacleScenario scenario (nh);
+
+		int numSuccess = 0, numPlanFail = 0, numCollision = 0;
+		double totalTime = 0.0, maxTime = 0.0;
+		for (size_t q=0; q<queries.size(); ++q){
+			// the obstacles are taken at a fixed scenario time for each query
+			double queryTime = q * queryInterval;
+			std::vector<onboardDetector::box3D> boxes;
+			scenario.getObstacles(queryTime, boxes);
+			std::shared_ptr<AutoFlight::obstacleSnapshot> obstacles (new AutoFlight::obstacleSnapshot);
+			for (const onboardDetector::box3D& ob : boxes){
+				obstacles->pos.push_back(Eigen::Vector3d (ob.x, ob.y, ob.z));
+				obstacles->vel.push_back(Eigen::Vector3d (ob.Vx, ob.Vy, 0.0));
+				obstacles->size.push_back(Eigen::Vector3d (ob.x_width, ob.y_width, ob.z_width));
+			}
+			obstacles->seq = q;
+
+			nav_msgs::Path simplePath, inputTraj, bsplineTrajMsg;
+			geometry_msgs::PoseStamped pStart, pGoal;
+			pStart.pose.position.x = queries[q].first(0); pStart.pose.position.y = queries[q].first(1); pStart.pose.position.z = queries[q].first(2);
+			pGoal.pose.position.x = queries[q].second(0); pGoal.pose.position.y = queries[q].second(1); pGoal.pose.position.z = queries[q].second(2);
+			simplePath.poses = std::vector<geometry_msgs::PoseStamped> {pStart, pGoal};
+			std::vector<Eigen::Vector3d> startEndConditions (4, Eigen::Vector3d (0.0, 0.0, 0.0));
+
+			// obstacle preparation and trajectory optimization as in the planner callback
+			ros::Time startTime = ros::Time::now();
+			obstacles->stamp = startTime;
+			predictor.update(obstacles);
+			pwlTraj.updatePath(simplePath, 1.0, false);
+			pwlTraj.makePlan(inputTraj, bsplineTraj.getControlPointDist());
+			bool planSuccess = bsplineTraj.updatePath(inputTraj, startEndConditions);
+			if (planSuccess){
+				std::vector<Eigen::Vector3d> nearObstaclesPos, nearObstaclesVel, nearObstaclesSize;
+				predictor.getObstaclesNearPath(inputTraj, nearObstaclesPos, nearObstaclesVel, nearObstaclesSize);
+				bsplineTraj.updateDynamicObstacles(nearObstaclesPos, nearObstaclesVel, nearObstaclesSize);
+				planSuccess = bsplineTraj.makePlan(bsplineTrajMsg);
+			}
+			double time = (ros::Time::now() - startTime).toSec();
+			totalTime += time;
+			maxTime = std::max(maxTime, time);
+
+			if (not planSuccess){
+				++numPlanFail;
+			}
+			else if (not isTrajectoryValid(bsplineTraj.getTrajectory(), bsplineTraj.getLinearFactor(), queryTime, scenario, map)){
+				++numCollision;
+			}
+			else{
+				++numSuccess;
+			}
+		}
+		cout << "[Benchmark]: " << numObstacles << " obstacles, success: " << numSuccess << "/" << queries.size()
+		     << " (plan fails: " << numPlanFail << ", collisions: " << numCollision << "), avg time: "
+		     << totalTime/std::max(int(queries.size()), 1) << "s, max time: " << maxTime << "s." << endl;
+	}
+	return 0;
+}
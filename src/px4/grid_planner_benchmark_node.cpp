@@ -0,0 +1,155 @@
+/*
+	FILE: grid_planner_benchmark_node.cpp
+	-----------------------------
+	compare the grid planner with the RRT planner on a prebuilt map
+*/
+
+#include <ros/ros.h>
+#include <autonomous_flight/px4/gridPlanner.h>
+#include <global_planner/rrtOccMap.h>
+#include <random>
+#include <fstream>
+
+double pathLength(const nav_msgs::Path& path){
+	double length = 0.0;
+	for (size_t i=1; i<path.poses.size(); ++i){
+		Eigen::Vector3d p1 (path.poses[i-1].pose.position.x, path.poses[i-1].pose.position.y, path.poses[i-1].pose.position.z);
+		Eigen::Vector3d p2 (path.poses[i].pose.position.x, path.poses[i].pose.position.y, path.poses[i].pose.position.z);
+		length += (p2 - p1).norm();
+	}
+	return length;
+}
+
+struct plannerStat{
+	int numSuccess = 0;
+	int numTrial = 0;
+	double totalTime = 0.0;
+	double maxTime = 0.0;
+	double totalLength = 0.0;
+
+	void add(bool success, double time, double length){
+		++this->numTrial;
+		this->totalTime += time;
+		this->maxTime = std::max(this->maxTime, time);
+		if (success){
+			++this->numSuccess;
+			this->totalLength += length;
+		}
+	}
+
+	void print(const std::string& name){
+		cout << "[Benchmark]: " << name << " success: " << this->numSuccess << "/" << this->numTrial
+		     << ", avg time: " << this->totalTime/std::max(this->numTrial, 1) << "s, max time: " << this->maxTime
+		     << "s, avg length: " << this->totalLength/std::max(this->numSuccess, 1) << "m." << endl;
+	}
+};
+
+int main(int argc, char** argv){
+	ros::init(argc, argv, "grid_planner_benchmark_node");
+	ros::NodeHandle nh;
+
+	int numQueries, rrtRepeat, seed;
+	double mapWaitTime, minQueryDist, height;
+	std::vector<double> sampleRange;
+	std::string savePath;
+	if (not nh.getParam("grid_planner_benchmark/num_queries", numQueries)) numQueries = 50;
+	if (not nh.getParam("grid_planner_benchmark/rrt_repeat", rrtRepeat)) rrtRepeat = 5;
+	if (not nh.getParam("grid_planner_benchmark/seed", seed)) seed = 0;
+	if (not nh.getParam("grid_planner_benchmark/map_wait_time", mapWaitTime)) mapWaitTime = 3.0;
+	if (not nh.getParam("grid_planner_benchmark/min_query_distance", minQueryDist)) minQueryDist = 5.0;
+	if (not nh.getParam("grid_planner_benchmark/sample_range", sampleRange) or sampleRange.size() < 4) sampleRange = {-10, 10, -10, 10};
+	if (not nh.getParam("grid_planner_benchmark/save_path", savePath)) savePath = "No";
+	if (not nh.getParam("grid_planner/height", height)) height = 1.0;
+
+	ros::AsyncSpinner spinner (1);
+	spinner.start();
+
+	std::shared_ptr<mapManager::occMap> map;
+	map.reset(new mapManager::occMap (nh));
+	ros::Duration(mapWaitTime).sleep(); // wait for the prebuilt map
+
+	globalPlanner::rrtOccMap<3> rrtPlanner (nh);
+	rrtPlanner.setMap(map);
+	AutoFlight::gridPlanner gridPlanner (nh);
+	gridPlanner.setMap(map);
+
+	// sample queries in free space on the planning slice
+	std::mt19937 gen (seed);
+	std::uniform_real_distribution<double> distX (sampleRange[0], sampleRange[1]);
+	std::uniform_real_distribution<double> distY (sampleRange[2], sampleRange[3]);
+	std::vector<std::pair<geometry_msgs::Pose, geometry_msgs::Pose>> queries;
+	int numSampleTrial = 0;
+	while (int(queries.size()) < numQueries and numSampleTrial < numQueries * 1000){
+		++numSampleTrial;
+		Eigen::Vector3d pStart (distX(gen), distY(gen), height);
+		Eigen::Vector3d pGoal (distX(gen), distY(gen), height);
+		if ((pGoal - pStart).norm() < minQueryDist) continue;
+		if (not map->isInMap(pStart) or map->isInflatedOccupied(pStart)) continue;
+		if (not map->isInMap(pGoal) or map->isInflatedOccupied(pGoal)) continue;
+		geometry_msgs::Pose start, goal;
+		start.position.x = pStart(0); start.position.y = pStart(1); start.position.z = pStart(2); start.orientation.w = 1.0;
+		goal.position.x = pGoal(0); goal.position.y = pGoal(1); goal.position.z = pGoal(2); goal.orientation.w = 1.0;
+		queries.push_back({start, goal});
+	}
+	cout << "[Benchmark]: " << queries.size() << " queries sampled." << endl;
+
+	std::ofstream file;
+	if (savePath != "No"){
+		file.open(savePath);
+		file << "query,planner,trial,success,time,length" << endl;
+	}
+
+	plannerStat rrtStat, gridStat;
+	double rrtLengthStdSum = 0.0; // run-to-run variation of the RRT path length
+	int numDeterministic = 0;
+	for (size_t q=0; q<queries.size(); ++q){
+		std::vector<double> rrtLengths;
+		for (int r=0; r<rrtRepeat; ++r){
+			nav_msgs::Path path;
+			rrtPlanner.updateStart(queries[q].first);
+			rrtPlanner.updateGoal(queries[q].second);
+			ros::Time startTime = ros::Time::now();
+			rrtPlanner.makePlan(path);
+			double time = (ros::Time::now() - startTime).toSec();
+			bool success = path.poses.size() >= 2;
+			double length = pathLength(path);
+			rrtStat.add(success, time, length);
+			if (success) rrtLengths.push_back(length);
+			if (file.is_open()) file << q << ",rrt," << r << "," << success << "," << time << "," << length << endl;
+		}
+		if (rrtLengths.size() > 1){
+			double mean = 0.0, var = 0.0;
+			for (double l : rrtLengths) mean += l;
+			mean /= rrtLengths.size();
+			for (double l : rrtLengths) var += (l - mean) * (l - mean);
+			rrtLengthStdSum += std::sqrt(var/rrtLengths.size());
+		}
+
+		// the grid planner is run twice to confirm it returns the same path
+		nav_msgs::Path gridPaths[2];
+		for (int r=0; r<2; ++r){
+			gridPlanner.updateStart(queries[q].first);
+			gridPlanner.updateGoal(queries[q].second);
+			ros::Time startTime = ros::Time::now();
+			gridPlanner.makePlan(gridPaths[r]);
+			double time = (ros::Time::now() - startTime).toSec();
+			bool success = gridPaths[r].poses.size() >= 2;
+			double length = pathLength(gridPaths[r]);
+			gridStat.add(success, time, length);
+			if (file.is_open()) file << q << ",grid," << r << "," << success << "," << time << "," << length << endl;
+		}
+		if (gridPaths[0].poses.size() == gridPaths[1].poses.size() and pathLength(gridPaths[0]) == pathLength(gridPaths[1])){
+			++numDeterministic;
+		}
+	}
+
+	rrtStat.print("RRT");
+	gridStat.print("Grid");
+	cout << "[Benchmark]: RRT avg path length std over repeats: " << rrtLengthStdSum/std::max(int(queries.size()), 1) << "m." << endl;
+	cout << "[Benchmark]: Grid identical repeated paths: " << numDeterministic << "/" << queries.size() << "." << endl;
+	if (file.is_open()){
+		file.close();
+		cout << "[Benchmark]: Results saved to: " << savePath << "." << endl;
+	}
+	return 0;
+}
@@ -0,0 +1,39 @@
+/*
+	FILE: motion_primitive_generator_node.cpp
+	-----------------------------
+	generate the motion primitive library offline and save it as a binary file
+*/
+
+#include <ros/ros.h>
+#include <autonomous_flight/px4/motionPrimitiveLibrary.h>
+
+using std::cout; using std::endl;
+int main(int argc, char** argv){
+	ros::init(argc, argv, "motion_primitive_generator_node");
+	ros::NodeHandle nh;
+
+	double maxVel, maxAcc, speedRes, duration, sampleDt;
+	int numAccSamples;
+	std::string filename;
+	if (not nh.getParam("motion_primitive/max_vel", maxVel)) maxVel = 2.0;
+	if (not nh.getParam("motion_primitive/max_acc", maxAcc)) maxAcc = 2.0;
+	if (not nh.getParam("motion_primitive/speed_resolution", speedRes)) speedRes = 0.25;
+	if (not nh.getParam("motion_primitive/num_acc_samples", numAccSamples)) numAccSamples = 7;
+	if (not nh.getParam("motion_primitive/duration", duration)) duration = 1.0;
+	if (not nh.getParam("motion_primitive/sample_dt", sampleDt)) sampleDt = 0.05;
+	if (not nh.getParam("motion_primitive/file", filename)){
+		cout << "[MotionPrimitive]: No output file param found. Abort." << endl;
+		return 1;
+	}
+
+	AutoFlight::motionPrimitiveLibrary library;
+	ros::Time startTime = ros::Time::now();
+	library.generate(maxVel, maxAcc, speedRes, numAccSamples, duration, sampleDt);
+	cout << "[MotionPrimitive]: Generated " << library.getNumPrimitives() << " primitives in " << (ros::Time::now() - startTime).toSec() << "s." << endl;
+	if (not library.save(filename)){
+		cout << "[MotionPrimitive]: Fail to save the library to: " << filename << "." << endl;
+		return 1;
+	}
+	cout << "[MotionPrimitive]: Library saved to: " << filename << "." << endl;
+	return 0;
+}
@@ -0,0 +1,107 @@
+/*
+	FILE: obstacle_collision_benchmark_node.cpp
+	-----------------------------
+	compare the indexed batch swept AABB check of the obstacle predictor with a scalar loop
+*/
+
+#include <ros/ros.h>
+#include <autonomous_flight/px4/obstaclePredictor.h>
+#include <random>
+
+// the same swept AABB test with one obstacle at a time (constant velocity)
+bool scalarConflict(const AutoFlight::obstacleSnapshot& obstacles, const Eigen::Vector3d& robotSize,
+                    const std::vector<Eigen::Vector3d>& points, const std::vector<double>& times,
+                    double horizon, double uncertaintyRate, double maxUncertainty, double& conflictTime){
+	for (size_t i=0; i+1<points.size(); ++i){
+		double t0 = std::min(std::max(times[i], 0.0), horizon);
+		double t1 = std::min(std::max(times[i+1], 0.0), horizon);
+		double uncertainty = std::min(uncertaintyRate * t1, maxUncertainty);
+		Eigen::Vector3d segMin = points[i].cwiseMin(points[i+1]);
+		Eigen::Vector3d segMax = points[i].cwiseMax(points[i+1]);
+		for (int j=0; j<obstacles.getNumObstacles(); ++j){
+			Eigen::Vector3d c0 = obstacles.pos[j] + obstacles.vel[j] * t0;
+			Eigen::Vector3d c1 = obstacles.pos[j] + obstacles.vel[j] * t1;
+			Eigen::Vector3d halfSize = (obstacles.size[j] + robotSize)/2.0 + Eigen::Vector3d (uncertainty, uncertainty, uncertainty);
+			Eigen::Vector3d obMin = c0.cwiseMin(c1) - halfSize;
+			Eigen::Vector3d obMax = c0.cwiseMax(c1) + halfSize;
+			if (obMin(0) <= segMax(0) and obMax(0) >= segMin(0) and
+				obMin(1) <= segMax(1) and obMax(1) >= segMin(1) and
+				obMin(2) <= segMax(2) and obMax(2) >= segMin(2)){
+				conflictTime = times[i];
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+int main(int argc, char** argv){
+	ros::init(argc, argv, "obstacle_collision_benchmark_node");
+	ros::NodeHandle nh;
+
+	int numRepeat, numSamples, seed;
+	std::vector<int> obstacleCounts;
+	double horizon, uncertaintyRate, maxUncertainty;
+	if (not nh.getParam("obstacle_collision_benchmark/num_repeat", numRepeat)) numRepeat = 1000;
+	if (not nh.getParam("obstacle_collision_benchmark/num_samples", numSamples)) numSamples = 50;
+	if (not nh.getParam("obstacle_collision_benchmark/seed", seed)) seed = 0;
+	if (not nh.getParam("obstacle_collision_benchmark/obstacle_counts", obstacleCounts)) obstacleCounts = {1, 2, 5, 10, 20, 50, 100, 200, 500};
+	if (not nh.getParam("obstacle_predictor/horizon", horizon)) horizon = 3.0;
+	if (not nh.getParam("obstacle_predictor/uncertainty_rate", uncertaintyRate)) uncertaintyRate = 0.2;
+	if (not nh.getParam("obstacle_predictor/max_uncertainty", maxUncertainty)) maxUncertainty = 0.5;
+	nh.setParam("obstacle_predictor/mode", 0); // the scalar reference is constant velocity
+
+	AutoFlight::obstaclePredictor predictor (nh);
+	Eigen::Vector3d robotSize (0.4, 0.4, 0.2);
+	predictor.setRobotSize(robotSize);
+
+	// straight trajectory along x at 1 m/s sampled every 0.1 s
+	std::vector<Eigen::Vector3d> points;
+	std::vector<double> times;
+	for (int i=0; i<numSamples; ++i){
+		points.push_back(Eigen::Vector3d (-0.1 * numSamples/2 + 0.1 * i, 0.0, 1.0));
+		times.push_back(0.1 * i);
+	}
+
+	// obstacles are kept away from the trajectory so the scalar check scans all of them (its worst case)
+	std::mt19937 gen (seed);
+	std::uniform_real_distribution<double> distX (-10.0, 10.0);
+	std::uniform_real_distribution<double> distY (3.0, 10.0);
+	std::uniform_real_distribution<double> distV (-1.0, 1.0);
+	std::bernoulli_distribution distSide (0.5);
+	for (int numObstacles : obstacleCounts){
+		std::shared_ptr<AutoFlight::obstacleSnapshot> obstacles (new AutoFlight::obstacleSnapshot);
+		for (int i=0; i<numObstacles; ++i){
+			obstacles->pos.push_back(Eigen::Vector3d (distX(gen), distSide(gen) ? distY(gen) : -distY(gen), 1.0));
+			obstacles->vel.push_back(Eigen::Vector3d (distV(gen), 0.0, 0.0));
+			obstacles->size.push_back(Eigen::Vector3d (0.5, 0.5, 1.8));
+		}
+		obstacles->stamp = ros::Time::now();
+
+		// rebuild of the predictor data and the spatial index for a new snapshot
+		ros::Time startTime = ros::Time::now();
+		for (int r=0; r<numRepeat; ++r){
+			std::shared_ptr<AutoFlight::obstacleSnapshot> obstaclesCopy (new AutoFlight::obstacleSnapshot (*obstacles));
+			predictor.update(obstaclesCopy);
+		}
+		double updateTime = (ros::Time::now() - startTime).toSec()/numRepeat;
+
+		double conflictTimeScalar, conflictTimeBatch;
+		bool conflictScalar = false, conflictBatch = false;
+		startTime = ros::Time::now();
+		for (int r=0; r<numRepeat; ++r){
+			conflictScalar = scalarConflict(*obstacles, robotSize, points, times, horizon, uncertaintyRate, maxUncertainty, conflictTimeScalar);
+		}
+		double scalarTime = (ros::Time::now() - startTime).toSec()/numRepeat;
+
+		startTime = ros::Time::now();
+		for (int r=0; r<numRepeat; ++r){
+			conflictBatch = predictor.getEarliestConflict(points, times, conflictTimeBatch);
+		}
+		double batchTime = (ros::Time::now() - startTime).toSec()/numRepeat;
+
+		cout << "[Benchmark]: " << numObstacles << " obstacles, scalar: " << scalarTime * 1e6 << "us, batch: " << batchTime * 1e6
+		     << "us, speedup: " << scalarTime/std::max(batchTime, 1e-12) << "x, snapshot update: " << updateTime * 1e6 << "us, same result: " << (conflictScalar == conflictBatch) << "." << endl;
+	}
+	return 0;
+}